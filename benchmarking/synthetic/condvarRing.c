@@ -0,0 +1,47 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// THREADS threads pass a token around a ring ROUNDS times, waiting for their
+// turn on a shared condition variable.
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t turnChanged = PTHREAD_COND_INITIALIZER;
+static long turn = 0;
+static long threads;
+static long rounds;
+
+static void* player(void* param) {
+  long me = (long)param;
+  pthread_mutex_lock(&mutex);
+  for (long i = 0; i < rounds; i++) {
+    while (turn % threads != me) {
+      pthread_cond_wait(&turnChanged, &mutex);
+    }
+    turn++;
+    pthread_cond_broadcast(&turnChanged);
+  }
+  pthread_mutex_unlock(&mutex);
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s THREADS ROUNDS\n", argv[0]);
+    return 1;
+  }
+  threads = atol(argv[1]);
+  rounds = atol(argv[2]);
+  pthread_t* ids = malloc(threads * sizeof(pthread_t));
+  for (long i = 0; i < threads; i++) {
+    if (pthread_create(&ids[i], NULL, player, (void*)i) != 0) {
+      fprintf(stderr, "pthread_create failed\n");
+      return 1;
+    }
+  }
+  for (long i = 0; i < threads; i++) {
+    pthread_join(ids[i], NULL);
+  }
+  printf("Passed the token %ld times.\n", turn);
+  return 0;
+}
@@ -0,0 +1,42 @@
+#define _XOPEN_SOURCE 500
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Directory walk: stats everything under DIR, and opens, fstats and closes
+// every regular file, REPEAT times.
+
+static long files = 0;
+
+static int visit(
+    const char* path, const struct stat* sb, int type, struct FTW* ftw) {
+  if (type == FTW_F) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      perror(path);
+      return 1;
+    }
+    close(fd);
+    files++;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s DIR REPEAT\n", argv[0]);
+    return 1;
+  }
+  int repeat = atoi(argv[2]);
+  for (int i = 0; i < repeat; i++) {
+    if (nftw(argv[1], visit, 16, FTW_PHYS) != 0) {
+      return 1;
+    }
+  }
+  printf("Visited %ld files.\n", files);
+  return 0;
+}
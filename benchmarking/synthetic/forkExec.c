@@ -0,0 +1,43 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Fork/exec storm: CHILDREN children in batches of WIDTH concurrent ones, each
+// re-executing this binary with no arguments, which exits immediately.
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    return 0;
+  }
+  int children = atoi(argv[1]);
+  int width = atoi(argv[2]);
+
+  for (int started = 0; started < children; started += width) {
+    int batch = children - started < width ? children - started : width;
+    for (int i = 0; i < batch; i++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        fprintf(stderr, "fork failed: %s\n", strerror(errno));
+        exit(1);
+      } else if (pid == 0) {
+        char* const args[] = {argv[0], NULL};
+        char* const env[] = {"PATH=/bin:/usr/bin", NULL};
+        execve(argv[0], args, env);
+        fprintf(stderr, "execve failed: %s\n", strerror(errno));
+        exit(1);
+      }
+    }
+    for (int i = 0; i < batch; i++) {
+      int status;
+      if (wait(&status) == -1 || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "child failed\n");
+        exit(1);
+      }
+    }
+  }
+  return 0;
+}
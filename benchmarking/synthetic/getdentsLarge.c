@@ -0,0 +1,28 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lists the (large) directory DIR, REPEAT times.
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s DIR REPEAT\n", argv[0]);
+    return 1;
+  }
+  int repeat = atoi(argv[2]);
+  long entries = 0;
+  for (int i = 0; i < repeat; i++) {
+    DIR* dir = opendir(argv[1]);
+    if (dir == NULL) {
+      fprintf(stderr, "opendir failed: %s\n", strerror(errno));
+      return 1;
+    }
+    while (readdir(dir) != NULL) {
+      entries++;
+    }
+    closedir(dir);
+  }
+  printf("Read %ld entries.\n", entries);
+  return 0;
+}
@@ -0,0 +1,29 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Reads SIZE random bytes with getrandom, ITERATIONS times.
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s ITERATIONS SIZE\n", argv[0]);
+    return 1;
+  }
+  long iterations = atol(argv[1]);
+  size_t size = atol(argv[2]);
+  char* buf = malloc(size);
+  for (long i = 0; i < iterations; i++) {
+    size_t done = 0;
+    while (done < size) {
+      long n = syscall(SYS_getrandom, buf + done, size - done, 0);
+      if (n < 0) {
+        fprintf(stderr, "getrandom failed: %s\n", strerror(errno));
+        return 1;
+      }
+      done += n;
+    }
+  }
+  return 0;
+}
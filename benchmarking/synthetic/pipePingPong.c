@@ -0,0 +1,71 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Pipe ping-pong: parent and child bounce a CHUNK byte message through two
+// pipes ROUNDS times.
+
+static void readAll(int fd, char* buf, size_t count) {
+  while (count > 0) {
+    ssize_t n = read(fd, buf, count);
+    if (n <= 0) {
+      fprintf(stderr, "read failed: %s\n", n == 0 ? "EOF" : strerror(errno));
+      exit(1);
+    }
+    buf += n;
+    count -= n;
+  }
+}
+
+static void writeAll(int fd, const char* buf, size_t count) {
+  while (count > 0) {
+    ssize_t n = write(fd, buf, count);
+    if (n < 0) {
+      fprintf(stderr, "write failed: %s\n", strerror(errno));
+      exit(1);
+    }
+    buf += n;
+    count -= n;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s ROUNDS CHUNK\n", argv[0]);
+    return 1;
+  }
+  int rounds = atoi(argv[1]);
+  size_t chunk = atol(argv[2]);
+  char* buf = calloc(chunk, 1);
+
+  int ping[2], pong[2];
+  if (pipe(ping) != 0 || pipe(pong) != 0) {
+    fprintf(stderr, "pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "fork failed: %s\n", strerror(errno));
+    return 1;
+  }
+  if (pid == 0) {
+    for (int i = 0; i < rounds; i++) {
+      readAll(ping[0], buf, chunk);
+      writeAll(pong[1], buf, chunk);
+    }
+    return 0;
+  }
+
+  for (int i = 0; i < rounds; i++) {
+    writeAll(ping[1], buf, chunk);
+    readAll(pong[0], buf, chunk);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
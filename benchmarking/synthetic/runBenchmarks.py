@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+
+"""
+Usage: ./runBenchmarks.py [--dettrace PATH] [--runs N] [--scale S]
+                          [--output FILE] [WORKLOAD...]
+
+Self-contained benchmark suite: small C workloads, each stressing one class of
+event dettrace intercepts, run natively and under dettrace. Needs nothing but a
+C compiler and a dettrace binary, no network or chroot.
+
+Writes one CSV row per workload and mode:
+  workload,class,args,mode,runs,median_seconds,min_seconds,max_seconds,overhead
+where overhead is the dettrace median over the native median. Wall clock is
+measured out here, time is virtualized inside dettrace.
+
+WORKLOAD names select a subset of the suite, by workload or class name.
+"""
+
+import argparse
+import csv
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import time
+
+# Inputs for the filesystem workloads. Not under /tmp: dettrace mounts a fresh
+# tmpfs there.
+dataDir = "data/"
+treeDir = dataDir + "tree"
+largeDir = dataDir + "large"
+
+treeFanout = 6
+treeDepth = 3
+treeFilesPerDir = 8
+largeDirFiles = 20000
+
+
+def workloads(scale):
+    """(name, class, binary, arguments) of every workload at this scale."""
+    def n(count):
+        return str(max(1, int(count * scale)))
+
+    return [
+        ("forkExecSequential", "process", "forkExec.bin", [n(500), "1"]),
+        ("forkExecStorm", "process", "forkExec.bin", [n(500), "16"]),
+        ("pipePingPong1", "pipe", "pipePingPong.bin", [n(20000), "1"]),
+        ("pipePingPong4k", "pipe", "pipePingPong.bin", [n(20000), "4096"]),
+        ("pipePingPong64k", "pipe", "pipePingPong.bin", [n(2000), "65536"]),
+        ("pipePingPong1m", "pipe", "pipePingPong.bin", [n(200), "1048576"]),
+        ("dirWalk", "filesystem", "dirWalk.bin", [treeDir, n(10)]),
+        ("getdentsLarge", "filesystem", "getdentsLarge.bin",
+         [largeDir, n(20)]),
+        ("clockGettime", "time", "timeLoop.bin", ["clock_gettime",
+                                                  n(200000)]),
+        ("rdtsc", "time", "timeLoop.bin", ["rdtsc", n(200000)]),
+        ("getrandomSmall", "random", "getrandomBulk.bin", [n(20000), "16"]),
+        ("getrandomBulk", "random", "getrandomBulk.bin", [n(2000), "65536"]),
+        ("condvarRing2", "threads", "condvarRing.bin", ["2", n(5000)]),
+        ("condvarRing8", "threads", "condvarRing.bin", ["8", n(1000)]),
+    ]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare native and dettrace runs of synthetic workloads.")
+    parser.add_argument("--dettrace", default="../../bin/dettrace",
+                        help="dettrace binary to benchmark")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs per workload and mode, the median is kept")
+    parser.add_argument("--scale", type=float, default=1.0,
+                        help="multiply every workload's iteration count")
+    parser.add_argument("--output", default="-",
+                        help="CSV file to write, - for stdout")
+    parser.add_argument("selected", nargs="*", metavar="WORKLOAD")
+    args = parser.parse_args()
+
+    # Make everything relative to our location.
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    createData()
+
+    selected = [w for w in workloads(args.scale)
+                if not args.selected or w[0] in args.selected or
+                w[1] in args.selected]
+    if not selected:
+        sys.exit("No workload matches {}".format(" ".join(args.selected)))
+
+    out = sys.stdout if args.output == "-" else open(args.output, "w")
+    writer = csv.writer(out)
+    writer.writerow(["workload", "class", "args", "mode", "runs",
+                     "median_seconds", "min_seconds", "max_seconds",
+                     "overhead"])
+    for name, workloadClass, binary, arguments in selected:
+        command = ["./" + binary] + arguments
+        native = timeRuns(command, args.runs)
+        traced = timeRuns([args.dettrace, "--"] + command, args.runs)
+        for mode, times in (("native", native), ("dettrace", traced)):
+            overhead = statistics.median(times) / statistics.median(native)
+            writer.writerow([name, workloadClass, " ".join(arguments), mode,
+                             args.runs,
+                             "{:.4f}".format(statistics.median(times)),
+                             "{:.4f}".format(min(times)),
+                             "{:.4f}".format(max(times)),
+                             "{:.2f}".format(overhead)])
+        out.flush()
+        print("   {}: {:.1f}x".format(
+            name, statistics.median(traced) / statistics.median(native)),
+            file=sys.stderr)
+
+
+def timeRuns(command, runs):
+    """Wall clock seconds of each of runs runs of command."""
+    times = []
+    for i in range(runs):
+        start = time.monotonic()
+        result = subprocess.run(command, stdout=subprocess.DEVNULL,
+                                stderr=subprocess.PIPE)
+        times.append(time.monotonic() - start)
+        if result.returncode != 0:
+            sys.exit("{} failed:\n{}".format(
+                " ".join(command), result.stderr.decode(errors="replace")))
+    return times
+
+
+def createData():
+    """Create the directories the filesystem workloads read, once."""
+    if os.path.isdir(treeDir) and os.path.isdir(largeDir):
+        return
+    shutil.rmtree(dataDir, ignore_errors=True)
+
+    def createTree(path, depth):
+        os.makedirs(path)
+        for i in range(treeFilesPerDir):
+            with open(os.path.join(path, "file{}".format(i)), "w") as f:
+                f.write("x" * i)
+        if depth > 0:
+            for i in range(treeFanout):
+                createTree(os.path.join(path, "dir{}".format(i)), depth - 1)
+
+    createTree(treeDir, treeDepth)
+    os.makedirs(largeDir)
+    for i in range(largeDirFiles):
+        open(os.path.join(largeDir, "entry{:06d}".format(i)), "w").close()
+
+
+if __name__ == "__main__":
+    main()
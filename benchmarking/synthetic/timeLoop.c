@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+// Reads the time ITERATIONS times, with clock_gettime or rdtsc.
+int main(int argc, char* argv[]) {
+  if (argc < 3 || (strcmp(argv[1], "clock_gettime") != 0 &&
+                   strcmp(argv[1], "rdtsc") != 0)) {
+    fprintf(stderr, "Usage: %s clock_gettime|rdtsc ITERATIONS\n", argv[0]);
+    return 1;
+  }
+  long iterations = atol(argv[2]);
+  unsigned long long sum = 0;
+  if (strcmp(argv[1], "rdtsc") == 0) {
+    for (long i = 0; i < iterations; i++) {
+      sum += __rdtsc();
+    }
+  } else {
+    struct timespec ts;
+    for (long i = 0; i < iterations; i++) {
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      sum += ts.tv_nsec;
+    }
+  }
+  // Keep the loop from being optimized out.
+  printf("%llu\n", sum & 1);
+  return 0;
+}
@@ -0,0 +1,269 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Binary logging backend.
+ *
+ * Instead of formatting every message with fprintf, the logger can write
+ * fixed-size event records into a ring of records in an mmapped file. A
+ * record holds the message's format string as a template id plus its raw
+ * arguments, and the system call context it was logged in. Formatting only
+ * happens offline, in `dettrace-logdecode`, which renders the usual text log.
+ *
+ * File layout:
+ *   binaryLogHeader, padded to BINARY_LOG_HEADER_BYTES
+ *   template area: NUL terminated format strings, template id is the order
+ *   ring: header.capacity binaryLogRecord
+ *
+ * The ring keeps the most recent records; header.written counts every record
+ * ever written, so record i lives in slot i % capacity. Since the file is
+ * MAP_SHARED, everything written so far survives the tracer crashing.
+ */
+
+static const char BINARY_LOG_MAGIC[8] = {'D', 'T', 'B', 'L', 'O', 'G', 0, 1};
+static const uint32_t BINARY_LOG_VERSION = 1;
+static const size_t BINARY_LOG_HEADER_BYTES = 4096;
+static const size_t BINARY_LOG_TEMPLATE_BYTES = 1 << 20;
+
+/** Template id of records holding already formatted text. */
+static const uint32_t TEXT_TEMPLATE = 0;
+
+/** Most format arguments a record can hold, others are logged as text. */
+static const int MAX_FORMAT_ARGS = 6;
+
+/** Bytes of text (string arguments or formatted text) per record. */
+static const int RECORD_TEXT_BYTES = 120;
+
+struct binaryLogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  /** Number of records in the ring. */
+  uint64_t capacity;
+  /** Size of the template area in bytes. */
+  uint64_t templateBytes;
+  /** Bytes of the template area in use. */
+  uint64_t templateUsed;
+  uint32_t templateCount;
+  uint32_t reserved;
+  /** Records written so far, including overwritten ones. */
+  uint64_t written;
+};
+
+enum recordFlags : uint8_t {
+  /** Message was logged with padding on. */
+  RECORD_PADDED = 1 << 0,
+  /** retval holds the return value of the system call. */
+  RECORD_HAS_RETVAL = 1 << 1,
+  /** Text continues in the next record. */
+  RECORD_CONTINUES = 1 << 2,
+  /** Record only holds the rest of the previous record's text. */
+  RECORD_CONTINUATION = 1 << 3,
+};
+
+/**
+ * One fixed-layout log event. Records of a message whose text does not fit
+ * are followed by RECORD_CONTINUATION records with the same entryId.
+ */
+struct binaryLogRecord {
+  uint64_t entryId;
+  /** Logical time of the traced process, in microseconds. */
+  uint64_t logicalTime;
+  int64_t retval;
+  uint64_t syscallArgs[6];
+  /** Integer and pointer arguments, doubles by bit pattern, and strings as
+   * offsets into text. */
+  uint64_t formatArgs[MAX_FORMAT_ARGS];
+  int32_t pid;
+  /** System call being handled, -1 if none. */
+  int32_t syscall;
+  uint32_t templateId;
+  /** Importance as a debug level: 2, 4 or 5. */
+  uint8_t importance;
+  uint8_t flags;
+  uint8_t formatArgCount;
+  /** Bytes of text in use. */
+  uint8_t textLength;
+  char text[RECORD_TEXT_BYTES];
+};
+
+static_assert(
+    sizeof(binaryLogRecord) == 256, "binary log records are 256 bytes");
+
+/**
+ * System call context stamped on every record.
+ */
+struct logContext {
+  pid_t pid = -1;
+  int syscall = -1;
+  uint64_t syscallArgs[6] = {0};
+  uint64_t logicalTime = 0;
+  bool hasRetval = false;
+  int64_t retval = 0;
+};
+
+/**
+ * Kind of argument a printf conversion consumes.
+ */
+enum class formatArg : uint8_t {
+  integer,
+  longInteger,
+  floating,
+  string,
+  pointer,
+};
+
+/**
+ * Piece of a format string: literal text followed by at most one conversion,
+ * e.g. "[Pid %d". Can be passed to printf along with its argument, if any.
+ */
+struct formatPiece {
+  string text;
+  bool hasArg;
+  formatArg kind;
+};
+
+/**
+ * Split a printf format string into pieces with one conversion each.
+ *
+ * @return false if the format uses something we do not record (`*` widths,
+ * %n, long doubles, wide strings, more than MAX_FORMAT_ARGS conversions).
+ */
+bool parseFormat(const char* format, vector<formatPiece>& pieces);
+
+/**
+ * Writer side of the binary log, owned by the logger.
+ */
+class binaryLog {
+public:
+  /**
+   * Create the log file at path with room for capacity records.
+   */
+  binaryLog(const string& path, uint64_t capacity);
+  ~binaryLog();
+
+  binaryLog(const binaryLog&) = delete;
+  binaryLog& operator=(const binaryLog&) = delete;
+
+  /**
+   * Record a printf style message. Templates are remembered by the address of
+   * format, so only string literals get one; other formats, and literals
+   * whose contents change between calls, are logged as text.
+   */
+  void write(
+      uint64_t entryId,
+      uint8_t importance,
+      uint8_t flags,
+      const logContext& context,
+      const char* format,
+      va_list args);
+
+  /**
+   * Record an already formatted message.
+   */
+  void writeText(
+      uint64_t entryId,
+      uint8_t importance,
+      uint8_t flags,
+      const logContext& context,
+      const char* text,
+      size_t length);
+
+  /**
+   * Size of the mapped log file.
+   */
+  size_t mappedSize() const { return mappedBytes; }
+
+private:
+  struct templateInfo {
+    uint32_t id;
+    /** Format can't be recorded, always log it as text. */
+    bool textOnly;
+    /** Contents of the format when first seen. */
+    string format;
+    vector<formatArg> args;
+  };
+
+  const templateInfo& lookupTemplate(const char* format);
+  /** Whether format lies in a read only segment, as string literals do. */
+  bool isLiteral(const char* format) const;
+  binaryLogRecord& nextRecord(
+      uint64_t entryId,
+      uint8_t importance,
+      uint8_t flags,
+      const logContext& context);
+
+  binaryLogHeader* header;
+  char* templates;
+  binaryLogRecord* ring;
+  size_t mappedBytes;
+
+  unordered_map<const char*, templateInfo> templateIds;
+  /** Read only segments of the loaded objects, see isLiteral. */
+  vector<pair<uintptr_t, uintptr_t>> literalSegments;
+  /** Template of formats that are not literals, always text. */
+  const templateInfo nonLiteral{TEXT_TEMPLATE, true, "", {}};
+};
+
+/**
+ * Reader side of the binary log, for the decoder.
+ */
+class binaryLogReader {
+public:
+  explicit binaryLogReader(const string& path);
+  ~binaryLogReader();
+
+  binaryLogReader(const binaryLogReader&) = delete;
+  binaryLogReader& operator=(const binaryLogReader&) = delete;
+
+  /**
+   * Call f(record, message) for every message still in the ring, oldest
+   * first. message is rendered like the text logger would.
+   */
+  template <typename F>
+  void forEach(F f) const {
+    uint64_t first =
+        header->written > header->capacity ? header->written - header->capacity
+                                           : 0;
+    for (uint64_t i = first; i < header->written;) {
+      const binaryLogRecord& r = ring[i % header->capacity];
+      i++;
+      // Oldest record may be the tail of an overwritten message.
+      if ((r.flags & RECORD_CONTINUATION) != 0) {
+        continue;
+      }
+      string message = render(r);
+      const binaryLogRecord* last = &r;
+      while ((last->flags & RECORD_CONTINUES) != 0 && i < header->written) {
+        last = &ring[i % header->capacity];
+        message.append(last->text, last->textLength);
+        i++;
+      }
+      f(r, message);
+    }
+  }
+
+  uint64_t written() const { return header->written; }
+  uint64_t capacity() const { return header->capacity; }
+
+private:
+  string render(const binaryLogRecord& r) const;
+
+  const binaryLogHeader* header;
+  const binaryLogRecord* ring;
+  size_t mappedBytes;
+  /** Parsed templates, indexed by template id. */
+  vector<vector<formatPiece>> templates;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef COW_PTR_H
+#define COW_PTR_H
+
+#include <memory>
+
+using namespace std;
+
+/**
+ * Copy-on-write handle to per-process tables (fd status, signal handlers,
+ * etc.) so fork does not deep copy them.
+ *
+ * Copying a cowPtr shares the table: every copy sees every mutation, which is
+ * what threads of one thread group need. snapshot() instead makes a handle
+ * that shares the current contents read-only, as fork needs; the contents are
+ * copied the first time either side calls write(). Since fork is usually
+ * followed by exec, which throws the tables away, most snapshots never get
+ * copied at all.
+ *
+ * Reads go through operator-> and operator*, which are const. Mutations must
+ * go through write(), so a read never pays for a copy.
+ */
+template <typename T>
+class cowPtr {
+public:
+  /**
+   * Handle to a new, empty table. Contents are only allocated on first write.
+   */
+  cowPtr() : cell(make_shared<shared_ptr<T>>()) {}
+
+  /**
+   * Handle to a copy-on-write snapshot of our current contents.
+   */
+  cowPtr snapshot() const {
+    cowPtr copy(*this);
+    copy.cell = make_shared<shared_ptr<T>>(*cell);
+    return copy;
+  }
+
+  const T& operator*() const { return *cell ? **cell : empty(); }
+  const T* operator->() const { return &**this; }
+
+  /**
+   * Mutable access. Copies the contents first if a snapshot still refers to
+   * them.
+   */
+  T& write() {
+    if (!*cell) {
+      *cell = make_shared<T>();
+    } else if (cell->use_count() > 1) {
+      *cell = make_shared<T>(**cell);
+    }
+    return **cell;
+  }
+
+private:
+  static const T& empty() {
+    static const T none;
+    return none;
+  }
+
+  /**
+   * Shared by handles of one thread group. Points to the contents, which are
+   * shared by all snapshots until one of them writes.
+   */
+  shared_ptr<shared_ptr<T>> cell;
+};
+
+#endif
@@ -45,6 +45,18 @@ typedef struct {
   const void* data;
 } Mount;
 
+/// Policy the deterministic scheduler uses to pick the next tracee to run.
+typedef enum {
+  // Highest pid first (default).
+  SCHEDULE_PID_PRIORITY = 0,
+  // Preempted processes go to the back of the line.
+  SCHEDULE_ROUND_ROBIN,
+  // Process with the smallest logical clock first.
+  SCHEDULE_LOGICAL_TIME,
+  // Oldest process first, by spawn order.
+  SCHEDULE_SPAWN_ORDER,
+} SchedulingPolicy;
+
 /**
  * Options for Dettrace.
  */
@@ -113,11 +125,37 @@ typedef struct {
   // Mount our own deterministic /dev/[u]random fifo pipes.
   bool with_devrand_overrides;
 
+  // Order in which runnable and blocked tracees are scheduled.
+  SchedulingPolicy scheduling_policy;
+
   // Logging options
   int debug_level;
   bool use_color;
   bool print_statistics;
+  // Also write the statistics report as JSON to this file, NULL for none.
+  const char* statistics_json;
+  // Keep live statistics in this file for dettrace-top, NULL for none.
+  const char* live_stats;
+  // Write a Chrome trace format timeline of the run to this file, NULL for
+  // none.
+  const char* timeline_file;
+  // Write checkpoints of the event fingerprint to this file every
+  // fingerprint_interval system call stops, NULL for none.
+  const char* fingerprint_file;
+  unsigned long fingerprint_interval;
   const char* log_file;
+  // Write a binary ring buffer log of this many MiB to log_file, see
+  // binaryLog.hpp.
+  bool binary_log;
+  unsigned long log_ring_mib;
+  // Only log matching events, see logFilter.hpp. Comma separated lists and
+  // FROM:TO windows; NULL or "" disables the filter.
+  const char* log_pids;
+  const char* log_executables;
+  const char* log_syscalls;
+  const char* log_syscall_window;
+  const char* log_time_window;
+  const char* log_importances;
 } TraceOptions;
 
 /**
@@ -79,7 +79,7 @@ public:
  *
  * This is deterministic and jailed thanks to our jail. We keep it here to print
  it's
- * path for debugging!
+ * path for debugging, and to drop the process's cached cwd, see state::dirs.
  *
  */
 class chdirSystemCall {
@@ -256,6 +256,23 @@ public:
   const string syscallName = "faccessat";
 };
 // =======================================================================================
+/**
+ * int fchdir(int fd);
+ *
+ * Deterministic like chdir. Intercepted to drop the process's cached cwd, see
+ * state::dirs.
+ */
+class fchdirSystemCall {
+public:
+  static bool handleDetPre(
+      globalState& gs, state& s, ptracer& t, scheduler& sched);
+  static void handleDetPost(
+      globalState& gs, state& s, ptracer& t, scheduler& sched);
+
+  const int syscallNumber = SYS_fchdir;
+  const string syscallName = "fchdir";
+};
+// =======================================================================================
 
 /**
  * ssize_t fgetxattr(int fd, const char *name, static void *value, size_t size);
@@ -458,7 +475,9 @@ public:
  * open file descriptor fd into the buffer pointed to by  dirp. Reads files in
  * directory.
  *
- * TODO: Contains linux_dirent struct with inode that we could virtualize.
+ * The order of entries is up to the filesystem. On the first call we read the
+ * whole directory ourselves and serve this and later calls from its sorted
+ * listing, with virtualized inodes; see handleDents.
  */
 class getdentsSystemCall {
 public:
@@ -481,7 +500,9 @@ public:
  * open file descriptor fd into the buffer pointed to by  dirp. Reads files in
  * directory.
  *
- * TODO: Contains linux_dirent struct with inode that we could virtualize.
+ * The order of entries is up to the filesystem. On the first call we read the
+ * whole directory ourselves and serve this and later calls from its sorted
+ * listing, with virtualized inodes; see handleDents.
  */
 class getdents64SystemCall {
 public:
@@ -1763,7 +1784,8 @@ public:
  * the  space  it  was using is made available for reuse.
  *
  * Similarly to other system calls, under deterministic threads and processes,
- * this should be deterministic. We keep it here to print it's path.
+ * this should be deterministic. We keep it here to print it's path, and to
+ * erase the inode of the last link from our inode table.
  */
 class unlinkSystemCall {
 public:
@@ -2113,10 +2135,9 @@ public:
 // =======================================================================================
 // Iterate through our vector of entries, which represent the binary memory for
 // linux_dirents or linux_dirent64. We virtualize the inodes and add entries to
-// our inodeMap.
+// our inode table.
 template <typename DirEntry>
-void virtualizeEntries(
-    vector<uint8_t>& entries, ValueMapper<ino_t, ino_t>& inodeMap) {
+void virtualizeEntries(vector<uint8_t>& entries, inodeTable& inodes) {
   // Variable size data, we cannot "iterate" over the entries in the array.
   uint8_t* position = entries.data();
 
@@ -2131,9 +2152,7 @@ void virtualizeEntries(
 
     // Virtualize our inode.
     ino64_t inode = currentEntry->d_ino;
-    currentEntry->d_ino = !inodeMap.realValueExists(inode)
-                              ? inodeMap.addRealValue(inode)
-                              : inodeMap.getVirtualValue(inode);
+    currentEntry->d_ino = inodes.findOrInsert(inode).virtualInode;
 
     // Next entry...
     position += entrySize;
@@ -2142,76 +2161,58 @@ void virtualizeEntries(
 // =======================================================================================
 template <typename T>
 void handleDents(globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // Error, return system call to tracee.
-  if (t.getReturnValue() < 0) {
-    return;
-  }
-
   // Use file descriptor to fetch correct entry in table.
   int fd = (int)t.arg1();
   traceePtr<uint8_t> traceeBuffer((uint8_t*)t.arg2());
+  bool serving = s.fdInfo(fd).dir != nullptr;
+  if (serving) {
+    // Restore the count handleDentsPre zeroed.
+    t.writeArg3(s.originalArg3);
+  }
   size_t traceeBufferSize = t.arg3();
 
-  // We have never seen this entry before! This is a new getdents call, not a
-  // replay by us.
-  if (s.dirEntries.count(fd) == 0) {
-    auto msg = "Tracee requested getdents for the first time for fd: %d.\n";
-    gs.log.writeToLog(Importance::info, msg, fd);
-
-    s.dirEntries.emplace(
-        fd, directoryEntries<linux_dirent>{s.dirEntriesBytes, gs.log});
+  // Error, return system call to tracee. The zero count of calls we serve
+  // fails with EINVAL, unless the descriptor is no directory anymore.
+  if (t.getReturnValue() < 0 && !(serving && t.getReturnValue() == -EINVAL)) {
+    return;
   }
 
-  // We have read zero bytes. We're done!
-  if (t.getReturnValue() == 0) {
-    gs.log.writeToLog(Importance::info, "All bytes have been read.\n");
-    gs.log.writeToLog(
-        Importance::info, "Returning sorted entries to tracee.\n");
-
-    // We want to fill up to traceeBufferSize which is the size the tracee
-    // originally asked for.
+  // We have never seen this entry before! The kernel vouched for the
+  // descriptor and buffer, read the whole directory ourselves, or take its
+  // listing from the directory cache.
+  if (!serving) {
+    auto msg = "Tracee requested getdents for the first time for fd: %d.\n";
+    LOG(gs.log, Importance::info, msg, fd);
 
-    vector<uint8_t> filledVector =
-        s.dirEntries.at(fd).getSortedEntries(traceeBufferSize);
-    virtualizeEntries<T>(filledVector, gs.inodeMap);
+    FdInfo& info = s.editFdInfo(fd);
+    info.kind = fdKind::directory;
+    info.dir = readTraceeDirectory(gs, s, fd);
+  }
+  directoryEntries<linux_dirent64>& entries = *s.fdInfo(fd).dir;
+
+  LOG(gs.log, Importance::info, "Returning sorted entries to tracee.\n");
+  // We want to fill up to traceeBufferSize which is the size the tracee
+  // asked for, the listing bounds what we could write.
+  vector<uint8_t> filledVector(min(traceeBufferSize, entries.listingBytes()));
+  filledVector.resize(entries.template getSortedEntries<T>(
+      filledVector.data(), filledVector.size()));
+  if (filledVector.empty() && entries.size() != 0) {
+    LOG(gs.log, Importance::info, "Buffer too small for the next entry.\n");
+    t.setReturnRegister(-EINVAL);
+    return;
+  }
+  virtualizeEntries<T>(filledVector, gs.inodes);
 
-    gs.log.writeToLog(
-        Importance::info, "Returning %d bytes!\n", filledVector.size());
+  LOG(gs.log, Importance::info, "Returning %d bytes!\n", filledVector.size());
 
-    // Write entry back to tracee!
-    writeVmTraceeRaw(
-        filledVector.data(), traceeBuffer, filledVector.size(), t.getPid());
-    // Explicitly increase counter.
-    t.readVmCalls++;
+  // Write entry back to tracee!
+  writeVmTraceeRaw(
+      filledVector.data(), traceeBuffer, filledVector.size(), t.getPid());
+  // Explicitly increase counter.
+  t.readVmCalls++;
 
-    // Set return register!
-    t.setReturnRegister(filledVector.size());
-  }
-  // We read some bytes but there might be more to read.
-  else {
-    gs.log.writeToLog(Importance::info, "Reading directory entries...\n");
-
-    // Read entries from tracee's buffer.
-    // We only copy over the return value, which is how many bytes were actually
-    // filled by the kernel into the tracee's buffer.
-    size_t bytesToCopy = t.getReturnValue();
-    uint8_t localBuffer[bytesToCopy];
-    doWithCheck(
-        readVmTraceeRaw(traceeBuffer, localBuffer, bytesToCopy, t.getPid()),
-        "readVmTraceeRaw: Unable to read bytes for dirent into buffer.");
-    // Explicitly increase counter.
-    t.readVmCalls++;
-
-    vector<uint8_t> newChunk{localBuffer, localBuffer + bytesToCopy};
-
-    // Copy chunks over to our directory entry for this file descriptor.
-    s.dirEntries.at(fd).addChunk(newChunk);
-
-    gs.log.writeToLog(
-        Importance::info, "Replaying system call to read more bytes...\n");
-    replaySystemCall(gs, t, t.getSystemCallNumber());
-  }
-  return;
+  // Set return register!
+  t.setReturnRegister(filledVector.size());
 }
 // =======================================================================================
 #endif
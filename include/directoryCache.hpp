@@ -0,0 +1,108 @@
+#ifndef DIRECTORY_CACHE_H
+#define DIRECTORY_CACHE_H
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "directoryEntries.hpp"
+
+using namespace std;
+
+/**
+ * Sorted directory listings, shared by every process of the job. A build lists
+ * the same directories over and over, include paths, library directories, the
+ * source tree; each is read from the kernel and sorted once, then handed to
+ * any process opening the directory with newReader.
+ *
+ * Listings are keyed by the directory's device and inode, and only valid for
+ * the modification and status change times they were read at. Creating,
+ * deleting or renaming an entry updates both, so a changed directory misses
+ * and is read again, whether the tracee or anyone else changed it.
+ *
+ * Least recently used listings are evicted beyond maxBytes.
+ */
+class directoryCache {
+public:
+  using listing = directoryEntries<linux_dirent64>;
+
+  /**
+   * @param maxBytes bound on the bufferedBytes of the listings held.
+   */
+  explicit directoryCache(size_t maxBytes);
+
+  /**
+   * Listing of the directory stat describes, if it did not change since we
+   * read it, else nullptr. Take a reader from it with newReader.
+   */
+  shared_ptr<listing> find(const struct stat& dir);
+
+  /**
+   * Keep entries, the directory's listing, unless it might be out of date
+   * already: the directory must not have changed since readStart, the
+   * CLOCK_REALTIME_COARSE time before we read it, and filesystemType must
+   * keep directory times up to date.
+   * @param dir the directory's stat, taken before readStart.
+   * @param filesystemType f_type of statfs.
+   */
+  void insert(
+      const struct stat& dir,
+      long filesystemType,
+      const struct timespec& readStart,
+      shared_ptr<listing> entries);
+
+  /** Listings held. */
+  size_t size() const { return lru.size(); }
+
+  /** bufferedBytes of the listings held. */
+  size_t bytes() const { return heldBytes; }
+
+  /**
+   * Call f on every listing held, most recently used first.
+   */
+  template <typename F>
+  void forEach(F f) const {
+    for (const cached& c : lru) {
+      f(*c.entries);
+    }
+  }
+
+private:
+  struct key {
+    dev_t dev;
+    ino_t ino;
+    bool operator==(const key& other) const {
+      return dev == other.dev && ino == other.ino;
+    }
+  };
+
+  struct keyHash {
+    size_t operator()(const key& k) const {
+      return hash<uint64_t>()(k.ino) ^ hash<uint64_t>()(k.dev) * 31;
+    }
+  };
+
+  struct cached {
+    key k;
+    struct timespec mtime;
+    struct timespec ctime;
+    shared_ptr<listing> entries;
+    size_t bytes;
+  };
+
+  /**
+   * Drop a listing.
+   */
+  void erase(list<cached>::iterator it);
+
+  /** Most recently used first. */
+  list<cached> lru;
+  unordered_map<key, list<cached>::iterator, keyHash> index;
+  size_t heldBytes = 0;
+  const size_t maxBytes;
+};
+
+#endif
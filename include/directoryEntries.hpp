@@ -1,15 +1,19 @@
 #ifndef DIRECTORY_ENTRIES_H
 #define DIRECTORY_ENTRIES_H
 
+#include <endian.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <cstdint>
 
 #include <algorithm>
-#include <deque>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "logger.hpp"
@@ -35,10 +39,59 @@ struct linux_dirent64 {
   char d_name[]; /**< Filename (null-terminated) */
 };
 
+// Accessors for both formats, linux_dirent keeps its type in its last byte.
+inline unsigned char direntType(const linux_dirent* entry) {
+  return ((const uint8_t*)entry)[entry->d_reclen - 1];
+}
+
+inline unsigned char direntType(const linux_dirent64* entry) {
+  return entry->d_type;
+}
+
+/**
+ * Bytes of a linux_dirent for a name of nameLength: the name, its null, and
+ * the type byte, 8 byte aligned.
+ */
+inline size_t direntSize(const linux_dirent*, size_t nameLength) {
+  return (offsetof(linux_dirent, d_name) + nameLength + 2 + 7) & ~(size_t)7;
+}
+
+inline size_t direntSize(const linux_dirent64*, size_t nameLength) {
+  return (offsetof(linux_dirent64, d_name) + nameLength + 1 + 7) & ~(size_t)7;
+}
+
+/**
+ * Fill in a zeroed entry of direntSize bytes.
+ */
+inline void writeDirent(
+    linux_dirent* entry,
+    ino64_t inode,
+    unsigned char type,
+    const char* name,
+    size_t nameLength) {
+  entry->d_ino = inode;
+  entry->d_reclen = direntSize(entry, nameLength);
+  memcpy(entry->d_name, name, nameLength);
+  ((uint8_t*)entry)[entry->d_reclen - 1] = type;
+}
+
+inline void writeDirent(
+    linux_dirent64* entry,
+    ino64_t inode,
+    unsigned char type,
+    const char* name,
+    size_t nameLength) {
+  entry->d_ino = inode;
+  entry->d_reclen = direntSize(entry, nameLength);
+  entry->d_type = type;
+  memcpy(entry->d_name, name, nameLength);
+}
+
 /**
  * This class wraps raw memory which itself represents either struct
  * linux_dirent or struct linux_dirent64. That is, directory entries for the
- * system calls getdents and getdents64.
+ * system calls getdents and getdents64. Entries are handed back sorted, in
+ * either format.
  *
  * WARNING: This class can only be be instantiated with linux_dirent or
  * linux_dirent64.
@@ -55,79 +108,213 @@ public:
    * @param bytes total bytes
    * @param log log file handler
    */
-  directoryEntries(size_t bytes, logger& log) : log(log) {
-    rawEntries.reserve(bytes);
+  directoryEntries(size_t bytes, logger& log)
+      : log(log), data(make_shared<listing>()) {
+    data->rawEntries.reserve(bytes);
   }
 
   /**
    * Add a chunk of count size to our internal buffer.
    * Resize if needed.
-   * @param newChunk chunk to be added as a array of bytes
+   * @param chunk entries to be added, as an array of bytes
+   * @param count bytes of chunk
    */
-  void addChunk(vector<uint8_t> newChunk) {
-    rawEntries.insert(rawEntries.end(), newChunk.begin(), newChunk.end());
-    return;
+  void addChunk(const uint8_t* chunk, size_t count) {
+    data->rawEntries.insert(data->rawEntries.end(), chunk, chunk + count);
   }
 
   /**
-   * Return an array of size < bytesNeeded, in order to fill it with as many
-   * entries as possible. This operation consumes the previous entries so
-   * subsequent calls with same argument will return new entries.
-   * @param bytesNeeded maximum array size to return.
-   * @return sorted array of entries
+   * Read all the entries left in the directory open at fd, with getdents64
+   * straight into our buffer. For linux_dirent64 entries only.
+   * @param fd directory file descriptor of the tracer.
+   * @return false, with errno set, if getdents64 failed.
    */
-  vector<uint8_t> getSortedEntries(size_t bytesNeeded) {
-    vector<uint8_t> toFill{};
+  bool readAll(int fd) {
+    static_assert(
+        is_same<T, linux_dirent64>::value, "getdents64 fills linux_dirent64");
+    vector<uint8_t>& rawEntries = data->rawEntries;
+    // Enough for any entry, a name is at most 255 bytes.
+    const size_t minimumRead = 4096;
+    while (true) {
+      size_t used = rawEntries.size();
+      if (rawEntries.capacity() - used < minimumRead) {
+        rawEntries.reserve(max(2 * rawEntries.capacity(), used + minimumRead));
+      }
+      rawEntries.resize(rawEntries.capacity());
+
+      long bytes = syscall(
+          SYS_getdents64, fd, rawEntries.data() + used,
+          rawEntries.size() - used);
+      rawEntries.resize(used + max(bytes, 0L));
+      if (bytes <= 0) {
+        return bytes == 0;
+      }
+    }
+  }
 
-    if (!sorted) {
-      sorted = true;
+  /**
+   * Sort the entries read so far. Done by the first getSortedEntries, or
+   * before sharing the listing with newReader: it is read only afterwards.
+   */
+  void sort() {
+    if (!data->sorted) {
+      data->sorted = true;
       sortOurEntries();
     }
+  }
+
+  /**
+   * Give back the room reserved for entries beyond the ones read, and for the
+   * index. For listings kept around, such as in the directory cache.
+   */
+  void shrinkToFit() {
+    data->rawEntries.shrink_to_fit();
+    data->order.shrink_to_fit();
+  }
+
+  /**
+   * A reader of the same sorted listing, from its first entry, without
+   * copying it. For the directory cache, which hands a listing read once to
+   * every process opening the directory.
+   */
+  shared_ptr<directoryEntries> newReader() {
+    sort();
+    // Private constructor, make_shared cannot call it.
+    shared_ptr<directoryEntries> reader(new directoryEntries(log));
+    reader->data = data;
+    return reader;
+  }
+
+  /**
+   * Identifies the listing, readers from newReader share it.
+   */
+  const void* listingId() const { return data.get(); }
 
+  /**
+   * Fill buffer with as many entries as fit in bytesNeeded. This operation
+   * consumes the previous entries so subsequent calls with same argument will
+   * return new entries.
+   * @param buffer where to write the entries, as Out structs with d_off
+   * zeroed.
+   * @param bytesNeeded bytes of buffer.
+   * @return bytes written.
+   */
+  template <typename Out = T>
+  size_t getSortedEntries(uint8_t* buffer, size_t bytesNeeded) {
+    sort();
+
+    const vector<uint8_t>& rawEntries = data->rawEntries;
+    const vector<sortKey>& order = data->order;
+    size_t filled = 0;
     while (true) {
       /** We read all entries before filling this buffer. */
-      if (entries.empty()) {
+      if (next == order.size()) {
         break;
       }
 
-      /** Get current head entry from our queue. */
-      auto tupleEntry = entries.front();
-      size_t entrySize = get<2>(tupleEntry);
+      /** Get current head entry from our listing. */
+      const T* entry = (const T*)&rawEntries[order[next].offset];
+      size_t nameLength = strlen(entry->d_name);
+      size_t entrySize = direntSize((Out*)nullptr, nameLength);
 
       /** Ensure we have enough room for this entry. Otherwise we're done! */
-      if (entrySize + toFill.size() > bytesNeeded) {
+      if (entrySize + filled > bytesNeeded) {
         break;
       }
 
-      log.writeToLog(
-          Importance::extra, "Returning entry: " + get<0>(tupleEntry) + "\n");
+      LOG(log, Importance::extra, "Returning entry: %s\n", entry->d_name);
+
+      /** Write out the entry in the format asked for, zeroed first. */
+      Out* out = (Out*)(buffer + filled);
+      memset(out, 0, entrySize);
+      writeDirent(
+          out, entry->d_ino, direntType(entry), entry->d_name, nameLength);
+      filled += entrySize;
 
-      /** We know we have enough room, it is now okay to get rid of this entry.
+      /** We know we have enough room, it is now okay to move past this entry.
        */
-      entries.pop_front();
+      next++;
+    }
+
+    return filled;
+  }
+
+  /**
+   * Bytes of the whole listing as read. As many bytes always hold its
+   * entries in either format, so they bound what getSortedEntries can write.
+   */
+  size_t listingBytes() const { return data->rawEntries.size(); }
 
-      /** Copy over entry based on address and size of struct. */
-      toFill.insert(
-          toFill.end(), get<1>(tupleEntry), get<1>(tupleEntry) + entrySize);
+  /**
+   * Entries buffered and not handed back yet.
+   */
+  size_t size() const {
+    if (data->sorted) {
+      return data->order.size() - next;
     }
+    const vector<uint8_t>& rawEntries = data->rawEntries;
+    size_t count = 0;
+    for (size_t offset = 0; offset < rawEntries.size();
+         offset += ((T*)&rawEntries[offset])->d_reclen) {
+      count++;
+    }
+    return count;
+  }
 
-    return toFill;
+  /**
+   * Bytes held by the listing: the raw entries and their sorted index.
+   * Readers sharing it hold the same bytes.
+   */
+  size_t bufferedBytes() const {
+    return sizeof(listing) + data->rawEntries.capacity() +
+           data->order.capacity() * sizeof(sortKey);
   }
 
 private:
   /**
-   * This vector represents contigious linux_dirent entries as a raw array of
-   * bytes.
+   * Constructor of newReader, which shares its listing instead.
    */
-  vector<uint8_t> rawEntries;
+  explicit directoryEntries(logger& log) : log(log) {}
 
-  bool sorted = false; /**<  If the entries have been sorted*/
+  /**
+   * An entry of the sorted index: the first 16 bytes of its name, zero padded
+   * and big endian, so most names compare without touching the entries.
+   */
+  struct sortKey {
+    uint64_t prefix[2];
+    size_t offset; /**< Of the entry in rawEntries. */
+  };
+
+  /**
+   * A directory listing, shared by the readers of newReader.
+   */
+  struct listing {
+    /**
+     * This vector represents contigious linux_dirent entries as a raw array
+     * of bytes.
+     */
+    vector<uint8_t> rawEntries;
+
+    bool sorted = false; /**<  If the entries have been sorted*/
+
+    /**
+     * The entries of rawEntries, in the order we hand them back. Sorting their
+     * offsets "sorts" the variable sized structs by their filename, without
+     * moving or copying them.
+     */
+    vector<sortKey> order;
+  };
+
+  shared_ptr<listing> data;
+
+  size_t next = 0; /**< Index of the next sorted entry to hand back. */
 
   /**
    * Sorts directory entries from raw entries.
    */
   void sortOurEntries() {
-    if (!entries.empty()) {
+    vector<sortKey>& order = data->order;
+    if (!order.empty()) {
       throw runtime_error(
           "dettrace runtime exception: sortOurEntries was called with "
           "non-empty entries.");
@@ -135,28 +322,40 @@ private:
 
     /** Variable size data, we cannot "iterate" over the entries in the array.
      */
-    uint8_t* position = rawEntries.data();
-    while (position < rawEntries.data() + rawEntries.size()) {
-      T* currentEntry = (T*)position;
-      size_t entrySize = currentEntry->d_reclen;
-
-      entries.push_back(make_tuple(
-          string{currentEntry->d_name}, (uint8_t*)currentEntry, entrySize));
-      position += entrySize;
+    const vector<uint8_t>& rawEntries = data->rawEntries;
+    for (size_t offset = 0; offset < rawEntries.size();
+         offset += ((const T*)&rawEntries[offset])->d_reclen) {
+      const char* entryName = ((const T*)&rawEntries[offset])->d_name;
+      char name[16] = {};
+      memcpy(name, entryName, strnlen(entryName, sizeof(name)));
+      sortKey key;
+      memcpy(key.prefix, name, sizeof(name));
+      key.prefix[0] = be64toh(key.prefix[0]);
+      key.prefix[1] = be64toh(key.prefix[1]);
+      key.offset = offset;
+      order.push_back(key);
     }
 
-    // Sort!
-    sort(entries.begin(), entries.end(), [](auto& p1, auto& p2) {
-      return get<0>(p1) > get<0>(p2);
-    });
+    // Sort by name, descending, bytes compared as unsigned char as
+    // std::string does. Names with the same prefix are compared in place from
+    // their 17th byte, unless they are shorter: then they are the same.
+    const uint8_t* raw = rawEntries.data();
+    auto descending = [raw](const sortKey& a, const sortKey& b) {
+      if (a.prefix[0] != b.prefix[0]) {
+        return a.prefix[0] > b.prefix[0];
+      }
+      if (a.prefix[1] != b.prefix[1]) {
+        return a.prefix[1] > b.prefix[1];
+      }
+      if ((a.prefix[1] & 0xff) == 0) {
+        return false;
+      }
+      return strcmp(
+                 ((const T*)(raw + a.offset))->d_name + 16,
+                 ((const T*)(raw + b.offset))->d_name + 16) > 0;
+    };
+    std::sort(order.begin(), order.end(), descending);
   }
-
-  /**
-   * Turn our entries into a vector of (name, address, byteSize) for easy
-   * sorting. Each address is it's location on our array this way, we can "sort"
-   * the variable sized structs by their filename.
-   */
-  deque<tuple<string, uint8_t*, size_t>> entries;
 };
 
 #endif
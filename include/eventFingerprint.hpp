@@ -0,0 +1,99 @@
+#ifndef EVENT_FINGERPRINT_H
+#define EVENT_FINGERPRINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+using namespace std;
+
+/**
+ * Rolling 64-bit hash of everything the tracer observes and decides: every
+ * event and the process it is for, system call numbers and arguments, final
+ * return values, and the bytes we write into tracee memory. Two runs of the
+ * same program are identical, as far as dettrace can tell, iff their
+ * fingerprints match, which is much cheaper to check than diffing debug logs.
+ *
+ * Checkpoints of the fingerprint are written to a file every interval system
+ * call stops, pre and post hooks counting separately. When two runs diverge,
+ * the first checkpoint that differs between their files gives a window of
+ * stops to rerun with logging, e.g. --debug 5 --log-syscall-window FROM:TO.
+ *
+ * Mixing uses the xxHash64 lane and avalanche functions, so it costs a few
+ * multiplies per event. There is one fingerprint, traceFingerprint, updated
+ * by the tracer thread, which does nothing until started.
+ */
+class eventFingerprint {
+public:
+  ~eventFingerprint();
+
+  /**
+   * Start fingerprinting, writing checkpoints to path every interval system
+   * call stops.
+   */
+  void start(const string& path, uint64_t interval);
+
+  bool running() const { return enabled; }
+
+  /**
+   * Mix value into the fingerprint.
+   */
+  void add(uint64_t value) {
+    if (enabled) {
+      mix(value);
+    }
+  }
+
+  /**
+   * Mix length bytes at data into the fingerprint.
+   */
+  void addBytes(const void* data, size_t length);
+
+  /**
+   * Write a checkpoint if another interval system call stops went by.
+   */
+  void checkpointIfDue(uint64_t systemCalls) {
+    if (enabled && systemCalls >= nextCheckpoint) {
+      checkpoint(systemCalls);
+    }
+  }
+
+  /**
+   * Write the final fingerprint, and stop.
+   */
+  void finish(uint64_t systemCalls);
+
+  /**
+   * The fingerprint so far.
+   */
+  uint64_t digest() const;
+
+private:
+  static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+  static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+  static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+  static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+  static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+  static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+  void mix(uint64_t value) {
+    value *= PRIME2;
+    value = rotl(value, 31) * PRIME1;
+    hash = rotl(hash ^ value, 27) * PRIME1 + PRIME4;
+  }
+
+  void checkpoint(uint64_t systemCalls);
+
+  bool enabled = false;
+  uint64_t hash = PRIME5;
+  FILE* out = nullptr;
+  uint64_t interval = 0;
+  uint64_t nextCheckpoint = 0;
+  uint64_t checkpoints = 0;
+};
+
+extern eventFingerprint traceFingerprint;
+
+#endif
@@ -1,16 +1,19 @@
 #ifndef EXECUTION_H
 #define EXECUTION_H
 
-#include "ValueMapper.hpp"
 #include "dettrace.hpp"
 #include "dettraceSystemCall.hpp"
 #include "globalState.hpp"
+#include "liveStats.hpp"
 #include "logger.hpp"
 #include "logicalclock.hpp"
+#include "memoryAccounting.hpp"
+#include "processTable.hpp"
 #include "ptracer.hpp"
 #include "scheduler.hpp"
 #include "state.hpp"
 #include "systemCallList.hpp"
+#include "traceTimeline.hpp"
 #include "util.hpp"
 #include "vdso.hpp"
 
@@ -70,6 +73,27 @@ private:
    */
   bool printStatistics;
 
+  /**
+   * Path to write the statistics report to as JSON, "" for none.
+   */
+  string statisticsJson;
+
+  /**
+   * Peak memory footprint per tracer data structure, only sampled when
+   * statistics are requested.
+   */
+  memoryAccounting memory;
+
+  /**
+   * Live statistics page, null unless requested.
+   */
+  unique_ptr<liveStats> live;
+
+  /**
+   * Timeline of the run in Chrome trace format, null unless requested.
+   */
+  unique_ptr<traceTimeline> timeline;
+
   /**
    * ptrace wrapper.
    * Class wrapping ptrace system call in a higher level API.
@@ -77,14 +101,13 @@ private:
   ptracer tracer;
 
   /**
-   * System call state map.
+   * Every live process and thread: its state, its parent and its thread group.
    * State represents all state we wish to maintain between subsequent system
-   * calls, e.g. logical time, etc. Since we may have multiple processes and
-   * threads, we hold a state per pid.
-   * TODO: do different threads have the same pid but different tid? I think so,
-   * tid might be a better choice for keys.
+   * calls, e.g. logical time, etc. A process can only ever exit once all its
+   * children have exited, threads are counted as children of their thread
+   * group leader.
    */
-  map<pid_t, state> states;
+  processTable processes;
 
   /**
    * Global inode mapper.
@@ -92,15 +115,6 @@ private:
    */
   globalState myGlobalState;
 
-  /**
-   * Map of parent processes to children.
-   * Keep track of our children. We can only ever exit once all our children
-   * have exited. We map the parent's process id to children: 1 -> 2 1 -> 3 2 ->
-   * 4 (Process 1 has two children: 2 and 3. Process 2 has one child: 4).
-   * Threads are also counted as children of their thread group leader.
-   */
-  multimap<pid_t, pid_t> processTree;
-
   /**
    * Process scheduler.
    * Tells us which process to run next, keeps track of current processes.
@@ -129,22 +143,22 @@ private:
    * Counter for keeping track of total number of system calls events
    * intercepted. this includes pre-hooks and post-hooks.
    */
-  uint32_t systemCallsEvents = 0;
+  uint64_t systemCallsEvents = 0;
 
   /**
    * Counter for keeping track of total number of rdtsc instructions.
    */
-  uint32_t rdtscEvents = 0;
+  uint64_t rdtscEvents = 0;
 
   /**
    * Counter for keeping track of total number of rdtscp instructions.
    */
-  uint32_t rdtscpEvents = 0;
+  uint64_t rdtscpEvents = 0;
 
   /**
    * Counter for keeping track process spawns: fork, vfork, clone.
    */
-  uint32_t processSpawnEvents = 0;
+  uint64_t processSpawnEvents = 0;
 
   std::vector<VDSOSymbol> vdsoFuncs;
 
@@ -172,6 +186,15 @@ public:
    * @param useColor Toggles color in logging process
    * @param Using kernel version < 4.8.
    * @param logFile file to write log messages to, if "" use stderr
+   * @param statisticsJson file to write the statistics report to as JSON
+   * @param liveStatsPath file to keep live statistics in, see liveStats.hpp
+   * @param timelinePath file to write a timeline of the run to, see
+   * traceTimeline.hpp
+   * @param fingerprintPath file to write event fingerprint checkpoints to,
+   * see eventFingerprint.hpp
+   * @param fingerprintInterval system calls between fingerprint checkpoints
+   * @param schedulingPolicy order in which the scheduler runs processes
+   * @param filter restricts which events are logged
    */
 
   execution(
@@ -180,6 +203,11 @@ public:
       bool useColor,
       string logFile,
       bool printStatistics,
+      string statisticsJson,
+      string liveStatsPath,
+      string timelinePath,
+      string fingerprintPath,
+      uint64_t fingerprintInterval,
       VDSOSymbol* vdsoFuncs,
       int nbVdsoFuncs,
       unsigned prngSeed,
@@ -188,7 +216,10 @@ public:
       logical_clock::duration clock_step,
       SysEnter sys_enter_hook,
       SysExit sys_exit_hook,
-      void* user_data);
+      void* user_data,
+      SchedulingPolicy schedulingPolicy,
+      uint64_t logRingRecords,
+      const logFilter& filter);
 
   /**
    * Handles exit from current process.
@@ -220,6 +251,12 @@ public:
    */
   void handlePostSystemCall(state& currState);
 
+  /**
+   * Tell the logger which system call we are handling, for binary log
+   * records and filters.
+   */
+  void setLogContext(const state& currState, int syscallNum);
+
   /**
    * REVIEW this function does not seem to be implemented
    * This function call both handlePostSystemCall and handlePostSystemCall.
@@ -232,6 +269,14 @@ public:
    */
   int runProgram();
 
+  /**
+   * Whether the child of the fork/clone event we are stopped at shares its
+   * parent's file descriptor table (CLONE_FILES).
+   * @param isThread whether this is a clone event, used when flags are not
+   * available.
+   */
+  bool sharesFileTable(bool isThread);
+
   /**
    * Handle the fork event part of @handleFork. Pushes parent to our process
    * hierarchy and creates state for child.
@@ -0,0 +1,105 @@
+#ifndef INODE_TABLE_H
+#define INODE_TABLE_H
+
+#include <sys/types.h>
+
+#include <vector>
+
+#include "logger.hpp"
+#include "logicalclock.hpp"
+
+using namespace std;
+
+/**
+ * What we know about a real inode.
+ */
+struct inodeRecord {
+  /** Virtual inode the tracee sees, never 0. */
+  ino_t virtualInode;
+  /**
+   * Logical time the tracee created it at, or the epoch if it existed before
+   * we did.
+   */
+  logical_clock::time_point mtime;
+};
+
+/**
+ * Real inodes to their virtual inode and logical modification time, in one
+ * open-addressing table, so virtualizing a stat is a single probe.
+ *
+ * Linear probing over a power of two number of slots, kept between an eighth
+ * and a half full. A slot is free while its virtual inode is 0. Inodes are
+ * erased once the tracee deletes their last link, so the table stays as big
+ * as the live files the job has seen, however many temporary files it churns
+ * through.
+ */
+class inodeTable {
+public:
+  /**
+   * @param log logger to write new mappings to.
+   * @param firstVirtualInode first virtual inode handed out, not 0.
+   * @param epoch modification time of inodes the tracee did not create.
+   */
+  inodeTable(
+      logger& log,
+      ino_t firstVirtualInode,
+      logical_clock::time_point epoch);
+
+  /**
+   * Record of realInode. If we had not seen it yet, it gets a fresh virtual
+   * inode and the epoch as modification time.
+   */
+  const inodeRecord& findOrInsert(ino_t realInode);
+
+  /**
+   * The tracee created realInode at mtime. It gets a fresh virtual inode even
+   * if we had seen it: the filesystem reused the inode for a new file.
+   */
+  void created(ino_t realInode, logical_clock::time_point mtime);
+
+  /**
+   * The inode is gone, forget it: a file later given the same real inode must
+   * not inherit its virtual inode or mtime.
+   */
+  void erase(ino_t realInode);
+
+  /** Inodes in the table. */
+  size_t size() const { return count; }
+
+  /** Bytes of the slot array. */
+  size_t bytes() const { return slots.capacity() * sizeof(slot); }
+
+private:
+  struct slot {
+    ino_t realInode;
+    inodeRecord record;
+  };
+
+  /**
+   * Slot holding realInode, or the free slot it belongs in.
+   */
+  slot& probe(ino_t realInode);
+
+  /**
+   * Make room for one more inode, doubling the slots when half full.
+   */
+  void reserveOne();
+
+  /**
+   * Move every inode into a table of newSize slots.
+   */
+  void rehash(size_t newSize);
+
+  /**
+   * Home slot of realInode, where its probe starts.
+   */
+  size_t home(ino_t realInode) const;
+
+  vector<slot> slots;
+  size_t count = 0;
+  ino_t freshInode;
+  logical_clock::time_point epoch;
+  logger& log;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "systemCallList.hpp"
+
+using namespace std;
+
+/**
+ * Live statistics page.
+ *
+ * With --live-stats, the tracer keeps its main counters in a small file it
+ * mmaps MAP_SHARED (put it on /dev/shm to keep it in memory), updating them
+ * in place on every event. `dettrace-top` maps the same file read-only and
+ * shows what a running job is doing, e.g. that it has been waiting on the
+ * same process for minutes, without stopping or slowing down the tracer.
+ *
+ * The scalar fields are updated under a sequence lock so readers get a
+ * consistent snapshot of them; the per system call counts are only ever
+ * incremented and are read without it.
+ */
+
+static const char LIVE_STATS_MAGIC[8] = {'D', 'T', 'S', 'T', 'A', 'T', 0, 1};
+static const uint32_t LIVE_STATS_VERSION = 1;
+
+struct liveStatsPage {
+  char magic[8];
+  uint32_t version;
+  /** Entries in systemCalls. */
+  uint32_t systemCallCount;
+  /**
+   * Odd while the tracer is updating the fields below. Only accessed with
+   * __atomic builtins, the page is shared with other processes.
+   */
+  uint64_t sequence;
+
+  pid_t tracerPid;
+  /** Process we last resumed and are waiting for an event from. */
+  pid_t currentPid;
+  /** CLOCK_REALTIME nanoseconds. */
+  uint64_t startTime;
+  uint64_t lastUpdate;
+  /** Set once the traced program has finished. */
+  uint64_t finished;
+
+  uint64_t events;
+  uint64_t systemCallEvents;
+  uint64_t replays;
+  uint64_t rdtscEvents;
+  uint64_t rdtscpEvents;
+  uint64_t processSpawnEvents;
+  uint64_t runnable;
+  uint64_t blocked;
+
+  /** Seccomp stops per system call number, the last entry is unknown ones. */
+  uint64_t systemCalls[SYSTEM_CALL_COUNT + 1];
+};
+
+/**
+ * Tracer side: creates and updates the page at path.
+ */
+class liveStats {
+public:
+  liveStats(const string& path);
+  ~liveStats();
+
+  liveStats(const liveStats&) = delete;
+  liveStats& operator=(const liveStats&) = delete;
+
+  /**
+   * Counters as of now. Called once per event, before resuming currentPid.
+   */
+  void update(
+      pid_t currentPid,
+      uint64_t systemCallEvents,
+      uint64_t replays,
+      uint64_t rdtscEvents,
+      uint64_t rdtscpEvents,
+      uint64_t processSpawnEvents,
+      uint64_t runnable,
+      uint64_t blocked);
+
+  void countSystemCall(long syscall) {
+    bool known = 0 <= syscall && syscall < SYSTEM_CALL_COUNT;
+    uint64_t& count = page->systemCalls[known ? syscall : SYSTEM_CALL_COUNT];
+    __atomic_store_n(&count, count + 1, __ATOMIC_RELAXED);
+  }
+
+  /**
+   * The traced program is done.
+   */
+  void finish();
+
+private:
+  void beginWrite() {
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+  }
+  void endWrite() {
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELEASE);
+  }
+
+  liveStatsPage* page;
+};
+
+/**
+ * Reader side: read a consistent snapshot of the page at path into out.
+ * Throws if path is not a live statistics page.
+ */
+void readLiveStats(const string& path, liveStatsPage& out);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef LOG_FILTER_H
+#define LOG_FILTER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Restricts debug logging to the part of a run we care about, e.g. one
+ * misbehaving compiler invocation in a large build.
+ *
+ * Each filter is optional; a message is logged only if it passes all filters
+ * that are set:
+ *   - pids / executables: the traced process has one of these pids, or last
+ *     exec'd a binary with one of these names. Either list matching is enough.
+ *   - systemCalls: we are handling one of these system calls.
+ *   - systemCallWindow: the number of system call stops so far is within
+ *     [from, to]. The pre and post hook of a system call are a stop each.
+ *   - timeWindow: the traced process's logical time is within [from, to].
+ *   - importances: the message has one of these importances.
+ *
+ * The logger evaluates filters once per event, not per message, and LOG()
+ * checks the result before evaluating any message arguments.
+ */
+class logFilter {
+public:
+  /**
+   * Setters take the comma separated lists and FROM:TO windows used on the
+   * command line (either side of a window may be left empty), and throw on
+   * malformed input. Empty strings leave the filter unset.
+   */
+  void setPids(const string& list);
+  void setExecutables(const string& list);
+  void setSystemCalls(const string& list);
+  void setSystemCallWindow(const string& window);
+  /**
+   * @param epochMicros logical time at the start of the run, the window is
+   * relative to it.
+   */
+  void setTimeWindow(const string& window, uint64_t epochMicros);
+  void setImportances(const string& list);
+
+  /**
+   * Whether any filter other than importances is set, i.e. whether matches()
+   * needs to be evaluated at all.
+   */
+  bool filtersEvents() const { return eventFilters; }
+
+  /**
+   * Whether matches() looks at the executable, so callers know to track it.
+   */
+  bool usesExecutables() const { return !executables.empty(); }
+
+  /**
+   * Does an event in this context pass the filters?
+   * @param syscall system call being handled, or -1.
+   */
+  bool matches(
+      pid_t pid,
+      const string& executable,
+      int syscall,
+      uint64_t systemCallCount,
+      uint64_t logicalTime) const;
+
+  /**
+   * Bit (1 << (int)imp) is set for every Importance we log.
+   */
+  uint8_t importanceMask() const { return importances; }
+
+private:
+  static pair<uint64_t, uint64_t> parseWindow(const string& window);
+
+  bool eventFilters = false;
+
+  unordered_set<pid_t> pids;
+  unordered_set<string> executables;
+  /** Indexed by system call number, empty if not filtering on them. */
+  vector<bool> systemCalls;
+  uint64_t fromSystemCall = 0;
+  uint64_t toSystemCall = UINT64_MAX;
+  uint64_t fromTime = 0;
+  uint64_t toTime = UINT64_MAX;
+  uint8_t importances = 0x7;
+};
+
+#endif
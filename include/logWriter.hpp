@@ -0,0 +1,91 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Background writer for the text log.
+ *
+ * The tracer thread formats each message and hands the bytes over through a
+ * lock-free single-producer single-consumer byte ring; a dedicated thread
+ * writes whatever has accumulated with one writev(2) per batch. The tracee no
+ * longer waits on log I/O while it is stopped. Messages reach the file within
+ * a few milliseconds, or right away on flush().
+ *
+ * Memory is bounded by the ring size: when the ring is full the producer
+ * waits for the writer to catch up rather than dropping anything, so the log
+ * holds exactly the same bytes, in the same order, as a synchronous write
+ * would.
+ */
+class logWriter {
+public:
+  /**
+   * Start a writer thread for fd, with a ring of capacity bytes (rounded up
+   * to a power of two).
+   */
+  logWriter(int fd, size_t capacity = 1 << 22);
+
+  /**
+   * Write out everything queued so far and stop the writer thread.
+   */
+  ~logWriter();
+
+  logWriter(const logWriter&) = delete;
+  logWriter& operator=(const logWriter&) = delete;
+
+  /**
+   * Queue length bytes for writing. Only called from the tracer thread.
+   */
+  void write(const char* data, size_t length);
+
+  /**
+   * Wait until everything queued so far has been written.
+   */
+  void flush();
+
+  /**
+   * Size of the ring in bytes.
+   */
+  size_t capacity() const { return ring.size(); }
+
+  /**
+   * Times write() had to wait for room in the ring.
+   */
+  uint64_t stalls = 0;
+
+private:
+  void run();
+  void wakeWriter();
+  template <typename Pred>
+  void waitForWriter(Pred done);
+
+  const int fd;
+  vector<char> ring;
+  const uint64_t mask;
+
+  /** Bytes queued so far, only advanced by the producer. */
+  atomic<uint64_t> head{0};
+  /** Bytes written so far, only advanced by the writer thread. */
+  atomic<uint64_t> tail{0};
+
+  atomic<bool> writerSleeping{false};
+  atomic<bool> producerWaiting{false};
+  atomic<bool> stopping{false};
+
+  /** Only taken to sleep and to wake the other side up. */
+  mutex m;
+  condition_variable dataAvailable;
+  condition_variable spaceAvailable;
+
+  thread writer;
+};
+
+#endif
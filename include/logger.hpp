@@ -5,9 +5,14 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <unistd.h>
+#include "binaryLog.hpp"
+#include "logFilter.hpp"
+#include "logWriter.hpp"
 #include "util.hpp"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -21,6 +26,35 @@ enum class Importance {
   extra, /*< Extra information not useful most of the time. */
 };
 
+/**
+ * Lowest debug level at which messages of the given importance are printed.
+ */
+constexpr int importanceLevel(Importance imp) {
+  return imp == Importance::inter ? 2 : imp == Importance::info ? 4 : 5;
+}
+
+/**
+ * Most verbose debug level compiled into this binary. Messages above it are
+ * removed at compile time, e.g. `make MAX_LOG_LEVEL=0` builds a tracer with no
+ * logging on the system call path at all.
+ */
+#ifndef DETTRACE_MAX_LOG_LEVEL
+#define DETTRACE_MAX_LOG_LEVEL 5
+#endif
+
+/**
+ * Log through logr if imp is enabled. Prefer this over calling writeToLog()
+ * directly: the format arguments (string concatenation, makeTextColored(),
+ * to_string(), etc.) are only evaluated if the message will be printed.
+ */
+#define LOG(logr, imp, ...)                               \
+  do {                                                    \
+    if (importanceLevel(imp) <= DETTRACE_MAX_LOG_LEVEL && \
+        (logr).enabled(imp)) {                            \
+      (logr).writeToLog(imp, __VA_ARGS__);                \
+    }                                                     \
+  } while (0)
+
 /**
  * Enum of log color.
  */
@@ -44,8 +78,19 @@ public:
    * appended.
    * @param debugLevel debugging level
    * @param useColor whether to use color in logging (default true)
+   * @param binaryRecords if non-zero, write a binary log (see binaryLog.hpp)
+   * with room for this many records to logFile instead of text.
+   */
+  logger(
+      string logFile,
+      int debugLevel,
+      bool useColor = true,
+      uint64_t binaryRecords = 0);
+
+  /**
+   * Writes out any queued messages and closes the log file.
    */
-  logger(string logFile, int debugLevel, bool useColor = true);
+  ~logger();
 
   /**
    * Logging wrapper for printf.
@@ -64,9 +109,34 @@ public:
    */
   void writeToLog(Importance imp, std::string format, ...);
 
+  /**
+   * Same as above. Taken by string literals, which the binary log records as
+   * a template id and arguments instead of formatting them.
+   */
+  void writeToLog(Importance imp, const char* format, ...);
+
   /** Just like writeToLog() but don't interpret % codes in the string */
   void writeToLogNoFormat(Importance imp, std::string s);
 
+  /**
+   * Wait until every message logged so far has been written out. Text
+   * messages are written by a background thread, see logWriter.
+   */
+  void flush();
+
+  /**
+   * Times logging had to wait for the writer thread to make room.
+   */
+  uint64_t writerStalls() const {
+    return writer == nullptr ? 0 : writer->stalls;
+  }
+
+  /**
+   * Bytes of the buffers behind the log: the writer's ring or the binary
+   * log mapping, and the line buffer.
+   */
+  uint64_t bufferBytes() const;
+
   /**
    * Set padding.
    */
@@ -83,6 +153,52 @@ public:
    */
   int getDebugLevel();
 
+  /**
+   * Whether messages of this importance are printed at our debug level, and
+   * pass the filters in the current context.
+   */
+  bool enabled(Importance imp) const {
+    return debugLevel >= importanceLevel(imp) &&
+           (enabledImportances & (1 << (int)imp)) != 0;
+  }
+
+  /**
+   * Only log what passes these filters from now on.
+   */
+  void setFilter(const logFilter& f);
+
+  /**
+   * Whether we write a binary log or filter on events, and so want the
+   * context below set.
+   */
+  bool wantsContext() const {
+    return binary != nullptr || filter.filtersEvents();
+  }
+
+  /** Whether the filter matches executables, see setContextProcess. */
+  bool wantsExecutables() const { return filter.usesExecutables(); }
+
+  /**
+   * Context stamped on binary log records and checked by filters: the
+   * process we are handling an event for, and which system call, if any.
+   */
+  void setContextPid(pid_t pid) {
+    context = logContext();
+    context.pid = pid;
+    contextExecutable.clear();
+    refilter();
+  }
+  void setContextProcess(const string& executable, uint64_t logicalTime);
+  void setContextSystemCall(
+      int syscall,
+      const uint64_t (&args)[6],
+      uint64_t logicalTime,
+      uint64_t systemCallCount);
+  void setContextReturnValue(int64_t retval) {
+    context.hasRetval = true;
+    context.retval = retval;
+  }
+
   /**
    * Return new string meant to be printed in color to terminal.
    * @param color color to be displayed
@@ -92,6 +208,11 @@ public:
   string makeTextColored(Color color, string text);
 
 private:
+  /**
+   * Format and print (or record) a message of the given importance.
+   */
+  void write(Importance imp, const char* format, va_list args);
+
   /**
    * Level of debugging (1-5).
    * C++ makes it a pain to initialize this if it's const.
@@ -104,6 +225,10 @@ private:
 
   FILE* fin; /**< File pointer to write to.   */
 
+  unique_ptr<logWriter> writer; /**< Writes text messages out to fin. */
+
+  vector<char> line; /**< Reused buffer to format text messages into. */
+
   bool padding; /**< Add a 2 space padding to the string to print. Useful for
                    nested messages. */
 
@@ -112,5 +237,20 @@ private:
   bool logPrintfFormattingEnabled; /**< Whether to enable interpretation of
                                       printf format specifiers within log
                                       messages */
+
+  unique_ptr<binaryLog> binary; /**< Binary backend, null for text logs. */
+
+  logContext context;
+
+  /**
+   * Recompute enabledImportances after the context changed.
+   */
+  void refilter();
+
+  logFilter filter;
+  string contextExecutable; /**< Only tracked if the filter needs it. */
+  uint64_t contextSystemCallCount = 0;
+  /** Bit (1 << (int)imp) set if imp passes the filters in this context. */
+  uint8_t enabledImportances = 0x7;
 };
 #endif
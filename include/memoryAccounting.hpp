@@ -0,0 +1,83 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "systemCallStats.hpp"
+
+using namespace std;
+
+class globalState;
+class logger;
+class processTable;
+
+/**
+ * Tracer data structures whose size grows with the traced job.
+ */
+enum class Structure {
+  inodes,         /**< Real to virtual inodes and modification times. */
+  directoryCache, /**< Sorted directory listings kept for every process. */
+  dirEntries,     /**< Directory entries buffered for getdents. */
+  states,         /**< Per process state, beyond its process table slot. */
+  processTable,   /**< Slabs and index, zombie entries included. */
+  logBuffers,     /**< Text log ring, binary log mapping, format buffer. */
+};
+
+const int STRUCTURE_COUNT = (int)Structure::logBuffers + 1;
+
+/**
+ * Entries in a structure, and an estimate of the bytes it holds.
+ */
+struct memoryUsage {
+  uint64_t entries = 0;
+  uint64_t bytes = 0;
+};
+
+/**
+ * Heap bytes of an unordered_map or unordered_set, assuming the usual node
+ * based implementation: a node per entry with the value, a next pointer and
+ * the cached hash, plus a pointer per bucket.
+ */
+template <typename HashTable>
+uint64_t hashTableBytes(const HashTable& table) {
+  return table.size() *
+             (sizeof(typename HashTable::value_type) + 2 * sizeof(void*)) +
+         table.bucket_count() * sizeof(void*);
+}
+
+/**
+ * Memory footprint of the tracer, per structure, so growing RSS on a long job
+ * can be attributed and containers sized.
+ *
+ * Sampling walks every process state, so execution only samples every
+ * SAMPLE_EVENTS events, and once at the end; we keep the peak of each
+ * structure over all samples. Bytes are estimates from sizes and capacities,
+ * not allocator measurements, and tables processes share copy-on-write are
+ * counted once.
+ */
+class memoryAccounting {
+public:
+  static const uint64_t SAMPLE_EVENTS = 4096;
+
+  /**
+   * Measure every structure now, and update the peaks.
+   */
+  void sample(globalState& gs, processTable& processes, logger& log);
+
+  const memoryUsage& peak(Structure s) const { return peaks[(int)s]; }
+
+  static const char* name(Structure s);
+
+  /**
+   * Append the peaks and the tracer's peak RSS to a statistics report.
+   */
+  void addStatistics(vector<statistic>& stats) const;
+
+private:
+  memoryUsage peaks[STRUCTURE_COUNT];
+  uint64_t samples = 0;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef PHASE_PROFILER_H
+#define PHASE_PROFILER_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <ostream>
+
+using namespace std;
+
+/**
+ * Phases of handling one tracee stop that we account time to.
+ */
+enum class Phase {
+  other,     /**< Event loop work not in any phase below. */
+  wait,      /**< Blocked in waitpid for the next tracee stop. */
+  registers, /**< PTRACE_GETREGS/SETREGS. */
+  handler,   /**< Our system call handlers, minus the phases they use. */
+  memory,    /**< Copying tracee memory: process_vm_*, PTRACE_PEEK/POKE. */
+  proc,      /**< readlink/stat through /proc/pid/. */
+  scheduler, /**< Picking the next process to run. */
+  logging,   /**< Formatting and queueing log messages. */
+};
+
+const int PHASE_COUNT = (int)Phase::logging + 1;
+
+/**
+ * Accounts the tracer's wall-clock time to the phase it is in, so a slow run
+ * can be pinned on kernel stop latency, handler work or our own /proc I/O.
+ *
+ * Phases nest: entering one pauses the enclosing phase, so e.g. handler time
+ * excludes the memory copies and logging the handler does. There is one
+ * profiler for the tracer thread, tracerProfile, which does nothing (beyond a
+ * branch per phase change) until started.
+ */
+class phaseProfiler {
+public:
+  /**
+   * Start accounting time to phases, to Phase::other until a phase is
+   * entered.
+   */
+  void start();
+
+  /**
+   * Stop accounting, phases entered afterwards are not timed.
+   */
+  void stop();
+
+  bool running() const { return enabled; }
+
+  /**
+   * Switch to phase p, return the phase we were in.
+   */
+  Phase enter(Phase p) {
+    Phase previous = current;
+    if (enabled) {
+      account();
+    }
+    current = p;
+    return previous;
+  }
+
+  /**
+   * Return to the phase we were in before enter().
+   */
+  void leave(Phase previous) {
+    if (enabled) {
+      account();
+    }
+    current = previous;
+  }
+
+  uint64_t nanos(Phase p) const { return totals[(int)p]; }
+
+  /**
+   * Time between start() and stop().
+   */
+  uint64_t totalNanos() const;
+
+  static const char* name(Phase p);
+
+  /**
+   * Print the time spent in each phase, and its share of the total.
+   */
+  void printText(ostream& out) const;
+
+private:
+  static uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+
+  void account() {
+    uint64_t now = nowNanos();
+    totals[(int)current] += now - lastSwitch;
+    lastSwitch = now;
+  }
+
+  bool enabled = false;
+  Phase current = Phase::other;
+  uint64_t startTime = 0;
+  uint64_t stopTime = 0;
+  uint64_t lastSwitch = 0;
+  uint64_t totals[PHASE_COUNT] = {};
+};
+
+extern phaseProfiler tracerProfile;
+
+/**
+ * Accounts the lifetime of this object to a phase of tracerProfile.
+ */
+class phaseTimer {
+public:
+  phaseTimer(Phase p) : previous(tracerProfile.enter(p)) {}
+  ~phaseTimer() { tracerProfile.leave(previous); }
+
+  phaseTimer(const phaseTimer&) = delete;
+  phaseTimer& operator=(const phaseTimer&) = delete;
+
+private:
+  const Phase previous;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "state.hpp"
+
+using namespace std;
+
+/**
+ * All per-process bookkeeping of the tracer in one place: the state of every
+ * process and thread, who is whose parent, and which threads belong to which
+ * thread group.
+ *
+ * Entries live in fixed-size slabs, so a state& stays valid while other
+ * processes are added or removed, and freed slots are recycled. A pid to slot
+ * index gives O(1) lookups. Children and thread group members are kept in
+ * intrusive doubly linked lists threaded through the entries, so exits unlink
+ * in O(1) without scanning or copying anything.
+ *
+ * Following the kernel, a thread's parent is its thread group leader, not the
+ * thread that spawned it. Threads are both children of their leader and
+ * members of its thread group. A process is the leader of its own group.
+ *
+ * An entry whose process exited while it still had children or threads is
+ * kept (without its state) until the last of them is removed, so their parent
+ * and thread group can still be queried.
+ */
+class processTable {
+public:
+  processTable() = default;
+  processTable(const processTable&) = delete;
+  processTable& operator=(const processTable&) = delete;
+  ~processTable();
+
+  /**
+   * State of a live process. Throws if there is no such process.
+   * @param pid process or thread id
+   */
+  state& at(pid_t pid);
+
+  /**
+   * State of a live process, nullptr if there is no such process.
+   * @param pid process or thread id
+   */
+  state* find(pid_t pid);
+
+  /**
+   * Add a new process, leader of its own thread group.
+   * @param pid new process
+   * @param parent parent process, -1 for the root of the process tree
+   * @param s state of the new process
+   * @return the state as stored in the table
+   */
+  state& addProcess(pid_t pid, pid_t parent, state&& s);
+
+  /**
+   * Add a new thread to the thread group of `creator`. The thread becomes a
+   * child of the thread group leader.
+   * @param tid new thread
+   * @param creator thread or process that spawned it
+   * @param s state of the new thread
+   * @return the state as stored in the table
+   */
+  state& addThread(pid_t tid, pid_t creator, state&& s);
+
+  /**
+   * Remove process or thread after it has exited.
+   * @param pid process or thread to remove
+   * @return pid of its parent, or -1 if it was the root
+   */
+  pid_t remove(pid_t pid);
+
+  /**
+   * Thread group (leader pid) that pid belongs to.
+   */
+  pid_t threadGroupOf(pid_t pid) const;
+
+  /**
+   * Number of members, leader included, of the thread group of pid.
+   */
+  uint32_t threadGroupSize(pid_t pid) const;
+
+  /**
+   * Number of children, threads included, that have not been removed yet.
+   */
+  uint32_t childCount(pid_t pid) const;
+
+  /**
+   * Some thread, other than the leader, of the thread group of pid.
+   * @return thread id or -1 if there are no threads left
+   */
+  pid_t anyThreadOf(pid_t pid) const;
+
+  /**
+   * Number of live threads (thread group leaders excluded).
+   */
+  size_t threadCount() const { return liveThreads; }
+
+  /**
+   * Whether every process and thread has been removed.
+   */
+  bool empty() const { return index.empty(); }
+
+  /**
+   * Number of entries, including those of exited processes kept for their
+   * children.
+   */
+  size_t entryCount() const { return index.size(); }
+
+  /**
+   * Call f(state) for every live process and thread.
+   */
+  template <typename F>
+  void forEachState(F f) {
+    for (auto& p : index) {
+      entry& e = slot(p.second);
+      if (e.live) {
+        f(e.st());
+      }
+    }
+  }
+
+  /**
+   * Approximate bytes of the table itself: slabs, which include the fixed
+   * size part of every state, the pid index and the free list.
+   */
+  uint64_t tableBytes() const;
+
+private:
+  static const uint32_t NONE = UINT32_MAX;
+  static const uint32_t SLAB_ENTRIES = 256;
+
+  struct entry {
+    pid_t pid = -1;
+    /** State is constructed, i.e. process has not been removed. */
+    bool live = false;
+    bool isThread = false;
+
+    /** Parent slot, and our links in its list of children. */
+    uint32_t parent = NONE;
+    uint32_t prevSibling = NONE;
+    uint32_t nextSibling = NONE;
+    /** Head of our list of children. */
+    uint32_t firstChild = NONE;
+    uint32_t childCount = 0;
+
+    /** Thread group leader slot, ourselves for processes. */
+    uint32_t leader = NONE;
+    /** For threads, links in the leader's list of threads. */
+    uint32_t prevThread = NONE;
+    uint32_t nextThread = NONE;
+    /** For leaders, head of the list of threads. */
+    uint32_t firstThread = NONE;
+    uint32_t threadCount = 0;
+
+    typename aligned_storage<sizeof(state), alignof(state)>::type storage;
+    state& st() { return *reinterpret_cast<state*>(&storage); }
+  };
+
+  vector<unique_ptr<entry[]>> slabs;
+  vector<uint32_t> freeSlots;
+  unordered_map<pid_t, uint32_t> index;
+  size_t liveThreads = 0;
+
+  entry& slot(uint32_t i) { return slabs[i / SLAB_ENTRIES][i % SLAB_ENTRIES]; }
+  const entry& slot(uint32_t i) const {
+    return slabs[i / SLAB_ENTRIES][i % SLAB_ENTRIES];
+  }
+
+  /** Slot for pid, throws if there is none. */
+  uint32_t lookup(pid_t pid) const;
+
+  /** Allocate and index a slot for pid, constructing its state. */
+  uint32_t allocate(pid_t pid, state&& s);
+
+  /** Free slot if its process is gone and nothing refers to it anymore. */
+  void releaseIfUnused(uint32_t i);
+
+  void linkChild(uint32_t parent, uint32_t child);
+  void unlinkChild(uint32_t child);
+  void linkThread(uint32_t leader, uint32_t thread);
+  void unlinkThread(uint32_t thread);
+};
+
+#endif
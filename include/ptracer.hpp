@@ -66,17 +66,17 @@ public:
   /**
    * counter to keep track read vm events;
    */
-  uint32_t readVmCalls = 0;
+  uint64_t readVmCalls = 0;
 
   /**
    * counter to keep track write vm events;
    */
-  uint32_t writeVmCalls = 0;
+  uint64_t writeVmCalls = 0;
 
   /**
    * counter for peeks, peeks only called through: readTraceeCString.
    */
-  uint32_t ptracePeeks = 0;
+  uint64_t ptracePeeks = 0;
 
   /**
    * Map of real inodes to virtual inodes.
@@ -338,6 +338,19 @@ public:
    */
   string readTraceeCString(traceePtr<char> readAddress, pid_t traceePid);
 
+  /**
+   * readTraceeCString for pointers the tracee passed us unchecked, such as
+   * paths we look at before the kernel does.
+   * @param readAddress address of CString to be read from (in tracee address
+   * space)
+   * @param traceePid the pid of the tracee
+   * @param str set to the string read.
+   * @return false if the string is not readable memory, or longer than
+   * PATH_MAX: the system call will fail on its own.
+   */
+  bool tryReadTraceeCString(
+      traceePtr<char> readAddress, pid_t traceePid, string& str);
+
   /**
    * Write a value to tracee.
    * @param writeAddress memory address in trace memory to write to.
@@ -2,11 +2,13 @@
 #define SCHEDULER_H
 
 #include "logger.hpp"
+#include "schedulingPolicy.hpp"
 #include "state.hpp"
 
 #include <map>
-#include <queue>
+#include <memory>
 #include <set>
+#include <unordered_map>
 
 using namespace std;
 
@@ -19,14 +21,56 @@ using namespace std;
 
  * Detects deadlocks in program and throws error, if this ever happens.
 
- * Current Scheduling policy: 2 Priority Queues: runnableHeap and blockedHeap.
- * Runs all runnable processes in order of highest PID first.
- * Then tries the blocked processes (and swaps the heaps).
+ * Scheduling: 2 ordered queues: runnableQueue and blockedQueue.
+ * Runs all runnable processes in the order given by the scheduling policy.
+ * Then tries the blocked processes (and swaps the queues).
+ * Default policy is highest PID first, see schedulingPolicy.hpp.
  */
 
+/**
+ * Set of processes ordered by the key handed out by the scheduling policy.
+ * Ties are broken by lowest pid.
+ */
+class runQueue {
+public:
+  /** Add process with the given ordering key. */
+  void push(pid_t pid, int64_t key);
+
+  /** Remove process, return false if it was not in this queue. */
+  bool erase(pid_t pid);
+
+  /** Process to run next. Undefined if empty. */
+  pid_t top() const { return order.begin()->second; }
+
+  bool contains(pid_t pid) const { return keys.count(pid) != 0; }
+  bool empty() const { return order.empty(); }
+  size_t size() const { return order.size(); }
+
+  set<pair<int64_t, pid_t>>::const_iterator begin() const {
+    return order.begin();
+  }
+  set<pair<int64_t, pid_t>>::const_iterator end() const { return order.end(); }
+
+  void swap(runQueue& other) {
+    order.swap(other.order);
+    keys.swap(other.keys);
+  }
+
+private:
+  set<pair<int64_t, pid_t>> order;
+  unordered_map<pid_t, int64_t> keys;
+};
+
 class scheduler {
 public:
-  scheduler(pid_t startingPid, logger& log);
+  /**
+   * Constructor.
+   * @param startingPid first process, runnable
+   * @param log logger
+   * @param policy order in which processes run
+   */
+  scheduler(
+      pid_t startingPid, logger& log, unique_ptr<schedulingPolicy> policy);
 
   /**
    * Check if this process has been marked as finished.
@@ -57,6 +101,14 @@ public:
    */
   void preemptAndScheduleNext();
 
+  /**
+   * Like preemptAndScheduleNext, but the current process is also passed over
+   * the next `rounds` times the blocked queue becomes runnable. Used to back
+   * off processes stuck in replay storms without relying on wall-clock time.
+   * @param rounds number of queue swaps to sit out
+   */
+  void backoffAndScheduleNext(uint32_t rounds);
+
   /**
    * Adds new process to scheduler.
    * This new process will be scheduled to run next.
@@ -81,19 +133,44 @@ public:
    */
   void removeAndScheduleParent(pid_t child, pid_t parent);
 
+  /**
+   * Name of the scheduling policy in use.
+   */
+  const char* policyName() const { return policy->name(); }
+
+  /**
+   * Number of processes in the runnable and blocked queues.
+   */
+  size_t runnableCount() const { return runnableQueue.size(); }
+  size_t blockedCount() const { return blockedQueue.size(); }
+
+  /**
+   * Was this process preempted, and not yet retried?
+   */
+  bool isBlocked(pid_t pid) const { return blockedQueue.contains(pid); }
+
   // Keep track of how many times scheduleNextProcess was called:
-  uint32_t callsToScheduleNextProcess = 0;
+  uint64_t callsToScheduleNextProcess = 0;
+
+  // Times a process was preempted and moved to the blocked queue, that is, a
+  // retry was scheduled for it.
+  uint64_t preemptions = 0;
+
+  // Times the runnable queue drained and the blocked queue took its place.
+  uint64_t queueSwaps = 0;
+
+  // Times the next process to run differed from the previous one.
+  uint64_t contextSwitches = 0;
+
+  // Times a backed off process was passed over on a queue swap.
+  uint64_t backoffSkips = 0;
 
   void killAllProcesses() {
-    while (!runnableHeap.empty()) {
-      pid_t pid = runnableHeap.top();
-      kill(pid, SIGKILL);
-      runnableHeap.pop();
+    for (auto& entry : runnableQueue) {
+      kill(entry.second, SIGKILL);
     }
-    while (!blockedHeap.empty()) {
-      pid_t pid = blockedHeap.top();
-      kill(pid, SIGKILL);
-      blockedHeap.pop();
+    for (auto& entry : blockedQueue) {
+      kill(entry.second, SIGKILL);
     }
   }
 
@@ -106,19 +183,35 @@ private:
   pid_t nextPid = -1;
 
   /**
-   * Two max heaps: runnableHeap and blockedHeap.
-   * Processes with higher PIDs go first.
+   * Decides the order of processes within the queues.
+   */
+  unique_ptr<schedulingPolicy> policy;
+
+  /**
+   * Two ordered queues: runnableQueue and blockedQueue.
    * Run all runnable processes. When we run out of these, switch the names of
-   * the heaps, and continue.
+   * the queues, and continue.
    */
-  priority_queue<pid_t> runnableHeap;
-  priority_queue<pid_t> blockedHeap;
+  runQueue runnableQueue;
+  runQueue blockedQueue;
 
   /**
    * Set of finished processes.
    */
   set<pid_t> finishedProcesses;
 
+  /**
+   * Backed off processes to the number of queue swaps they still sit out.
+   * Ordered, so the outcome of a swap never depends on hashing.
+   */
+  map<pid_t, uint32_t> backoff;
+
+  /**
+   * After a queue swap, move backed off processes back to the blocked queue,
+   * unless that would leave nothing to run.
+   */
+  void applyBackoff();
+
   /** Remove process from scheduler.
    * Calls deleteProcess, used to share code between
    * removeAndScheduleNext and removeAndScheduleParent.
@@ -130,12 +223,17 @@ private:
   void remove(pid_t process);
 
   /**
-   * Get next process based on whether the runnableHeap is empty.
-   * If the runnableHeap is empty, swap the heaps, and continue.
+   * Get next process based on whether the runnableQueue is empty.
+   * If the runnableQueue is empty, swap the queues, and continue.
    * @return next process to schedule.
    */
   pid_t scheduleNextProcess();
 
+  /**
+   * Set nextPid, keeping count of context switches.
+   */
+  void setNext(pid_t pid);
+
   /**< Debug function to print all data about processes. */
   void printProcesses();
 };
@@ -0,0 +1,129 @@
+#ifndef SCHEDULING_POLICY_H
+#define SCHEDULING_POLICY_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "dettrace.hpp"
+#include "logicalclock.hpp"
+
+using namespace std;
+
+/**
+ * Ordering strategy used by the scheduler.
+ *
+ * The scheduler keeps two ordered sets: runnable and blocked processes. A
+ * policy only decides the order of processes within those sets, by handing out
+ * a key every time a process enters one of them. Lower keys run first, ties are
+ * broken by lower pid. Keys must be a pure function of the (deterministic)
+ * sequence of scheduler events, never of wall-clock time or host state.
+ */
+class schedulingPolicy {
+public:
+  virtual ~schedulingPolicy() {}
+
+  /**
+   * Human readable name, as accepted by the --scheduling-policy flag.
+   */
+  virtual const char* name() const = 0;
+
+  /**
+   * Ordering key for a process entering the runnable or blocked set.
+   * @param pid process being (re)queued
+   * @return key, lower keys are scheduled first
+   */
+  virtual int64_t key(pid_t pid) = 0;
+
+  /**
+   * Notify policy a new process was added to the scheduler.
+   * @param pid new process
+   */
+  virtual void spawned(pid_t pid) {}
+
+  /**
+   * Notify policy a process was removed from the scheduler for good.
+   * @param pid removed process
+   */
+  virtual void removed(pid_t pid) {}
+};
+
+/**
+ * Highest pid first. The original dettrace policy.
+ */
+class pidPriorityPolicy : public schedulingPolicy {
+public:
+  const char* name() const override { return "pid-priority"; }
+  int64_t key(pid_t pid) override { return -(int64_t)pid; }
+};
+
+/**
+ * Processes run in the order they were queued, so a preempted process goes to
+ * the back of the line.
+ */
+class roundRobinPolicy : public schedulingPolicy {
+public:
+  const char* name() const override { return "round-robin"; }
+  int64_t key(pid_t pid) override { return ticket++; }
+
+private:
+  int64_t ticket = 0;
+};
+
+/**
+ * Process with the smallest logical clock runs first.
+ */
+class logicalTimePolicy : public schedulingPolicy {
+public:
+  /**
+   * @param logicalTimeOf returns the current logical time of a process.
+   */
+  explicit logicalTimePolicy(
+      function<logical_clock::time_point(pid_t)> logicalTimeOf)
+      : logicalTimeOf(logicalTimeOf) {}
+
+  const char* name() const override { return "logical-time"; }
+  int64_t key(pid_t pid) override {
+    return logicalTimeOf(pid).time_since_epoch().count();
+  }
+
+private:
+  function<logical_clock::time_point(pid_t)> logicalTimeOf;
+};
+
+/**
+ * Oldest process first, by order of spawning. Avoids starving parents in
+ * fork-heavy process trees.
+ */
+class spawnOrderPolicy : public schedulingPolicy {
+public:
+  const char* name() const override { return "spawn-order"; }
+  int64_t key(pid_t pid) override;
+  void spawned(pid_t pid) override;
+  void removed(pid_t pid) override;
+
+private:
+  int64_t nextSpawn = 0;
+  unordered_map<pid_t, int64_t> spawnNumber;
+};
+
+/**
+ * Create the policy for the given type.
+ * @param type which policy to create
+ * @param logicalTimeOf logical time lookup, only used by logical-time policy
+ */
+unique_ptr<schedulingPolicy> makeSchedulingPolicy(
+    SchedulingPolicy type,
+    function<logical_clock::time_point(pid_t)> logicalTimeOf);
+
+/**
+ * Parse policy name as given on the command line. Throws runtimeError on
+ * unknown names.
+ */
+SchedulingPolicy parseSchedulingPolicy(const string& name);
+
+#endif
@@ -8,11 +8,13 @@
 #include <sys/types.h>
 #include <sys/user.h>
 #include <sys/vfs.h>
+#include <unistd.h>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
-#include "ValueMapper.hpp"
+#include "cowPtr.hpp"
 #include "directoryEntries.hpp"
 #include "logicalclock.hpp"
 #include "mappedMemory.hpp"
@@ -50,6 +52,62 @@ enum class descriptorType {
                 */
 };
 
+/**
+ * What kind of file a descriptor refers to, as far as we care.
+ */
+enum class fdKind : uint8_t {
+  none, /*< Not open, or nothing known about it. */
+  regular, /*< Only its blocking mode is tracked. */
+  pipe,
+  socket, /*< Local (unix domain) socket, or shut down remote socket. */
+  remoteSocket, /*< AF_INET or AF_INET6 socket. */
+  timerfd,
+  directory, /*< Directory being read through getdents. */
+};
+
+/**
+ * Everything we track about one file descriptor. Data that the kernel shares
+ * between duplicated descriptors (timer setting, directory position) is shared
+ * between their records too.
+ */
+struct FdInfo {
+  fdKind kind = fdKind::none;
+  /** Blocking mode as set by the user program, regardless of what we set. */
+  descriptorType mode = descriptorType::blocking;
+  /** Last value set through timerfd_settime, timerfds only. */
+  shared_ptr<struct itimerspec> timer;
+  /**
+   * The directory's sorted listing, read by us on its first getdents, which
+   * serves its later getdents. Directories only.
+   */
+  shared_ptr<directoryEntries<linux_dirent64>> dir;
+};
+
+/**
+ * A file descriptor of the tracer, closed with its last reference.
+ */
+class hostFd {
+public:
+  explicit hostFd(int fd) : fd(fd) {}
+  ~hostFd() { close(fd); }
+
+  hostFd(const hostFd&) = delete;
+  hostFd& operator=(const hostFd&) = delete;
+
+  const int fd;
+};
+
+/**
+ * O_PATH descriptors of a process's working directory and root, opened from
+ * /proc/pid/cwd and /proc/pid/root, so path resolution only walks the path the
+ * tracee gave. Null when not opened yet. They follow the directories, so they
+ * stay valid when those are renamed.
+ */
+struct traceeDirs {
+  shared_ptr<hostFd> cwd;
+  shared_ptr<hostFd> root;
+};
+
 // Needed to avoid recursive dependencies between classes.
 class mappedMemory;
 
@@ -99,30 +157,47 @@ public:
   state cloned(pid_t childPid) const;
 
   /**
-   * Keep track of file descriptor status for blocking descriptors, as set by
-   the
-   * user program. Irregardless of what we set it to. These are
-   * set in either pipe (non blocking) or pipe2 (either), or duplicated through,
-   * dup, dup2, or can be set through fnctl. Deleted through close(). We only
-   support
-   * pipes, should be extended with fifo's at some point.
+   * File descriptor table, indexed by fd. Records are created by pipe, pipe2,
+   * socket, accept4, timerfd_create, getdents and fcntl/ioctl setting the
+   * blocking mode, copied by dup, dup2 and fcntl(F_DUPFD), and cleared by
+   * close, or by execve for close-on-exec descriptors.
+   *
+   * When reading/writing we check the blocking mode to know whether to block
+   * this process, and replay, or simply preempt as Runnable by the scheduler.
+   *
+   * Like the other per-process tables below, this is copy-on-write: it is
+   * shared by clones with CLONE_FILES (threads), other children get a snapshot
+   * copied on their first write.
+   */
+  cowPtr<vector<FdInfo>> fds;
 
-   * When reading/writing we check this status to know whether to block this
-   process,
-   * and replay, or simply preempt as Runnable by the scheduler.
+  /**
+   * Record for fd, an fdKind::none record if we know nothing about it.
+   * Invalidated by any change to the table.
    */
-  shared_ptr<unordered_map<int, descriptorType>> fdStatus;
+  const FdInfo& fdInfo(int fd) const;
 
-  void setFdStatus(int fd, descriptorType dt);
+  /**
+   * Mutable record for fd, grows the table as needed.
+   */
+  FdInfo& editFdInfo(int fd);
 
-  descriptorType getFdStatus(int fd);
+  /**
+   * Forget fd, after it was closed.
+   */
+  void closeFd(int fd);
 
-  int countFdStatus(int fd);
+  /**
+   * newfd refers to the same file as fd, after dup, dup2, fcntl(F_DUPFD).
+   */
+  void dupFd(int fd, int newfd);
 
   /**
-   * Map from file descriptors to directory entries.
+   * Whether the user program set fd to non blocking.
    */
-  unordered_map<int, directoryEntries<linux_dirent>> dirEntries;
+  bool fd_is_nonblocking(int fd) const {
+    return fdInfo(fd).mode == descriptorType::nonBlocking;
+  }
 
   /**
    * The pid of the process represented by this state.
@@ -165,20 +240,10 @@ public:
    * of the program. So we delete inodes when they're done and delete them from
    * our maps.
    *
-   * We would like to do:
-   * 1) See a call to unlink, unlinkat, or rmdir.
-   * 2) On the post hook we inject a call to newfstatat to find what the inode
-   * belonging to this file is. We use this inode as a key to delete that entry
-   * from our inode map and mtime map.
-   *
-   * This doesn't work though, as the call to newfstatat fails since the file
-   * has already been deleted at this point! So instead we do: 1) See a call to
-   * unlink, unlinkat, or rmdir. If this is the first time we have seen this
-   * syscall we cut if off early at the pre hook and do a call to newfstatat to
-   *    find the correct inode, we populate inodeToDelete in the state class.
-   * From newfstatat we replay the call to unlink, unlinkat, or rmdir
-   * respectively. In the post hook of the original call we use inodeToDelete to
-   * remove the correct entries.
+   * The pre hook lstats the name with stat_tracee_path, from the tracer, while
+   * the file still exists, and marks its inode here if this is its last link.
+   * The post hook erases it from gs.inodes if the system call succeeded.
+   * -1 when nothing is marked.
    */
   ino_t inodeToDelete = -1;
 
@@ -224,14 +289,28 @@ public:
 
   /** Track, for each signal, what kind of handler this tracee currently has
    * registered. */
-  shared_ptr<unordered_map<int, enum sighandler_type>> currentSignalHandlers;
+  cowPtr<unordered_map<int, enum sighandler_type>> currentSignalHandlers;
 
   /** track timers created via timer_create */
-  shared_ptr<unordered_map<timerID_t, timerInfo>> timerCreateTimers;
+  cowPtr<unordered_map<timerID_t, timerInfo>> timerCreateTimers;
+
+  /**
+   * Cached cwd and root. Like the kernel's fs_struct, threads share it and
+   * fork copies it. chdir and fchdir clear the cwd.
+   */
+  cowPtr<traceeDirs> dirs;
+
+  /**
+   * pidfd of this process's thread group, to pidfd_getfd the directories *at
+   * system calls are relative to. Shared by threads, not inherited by fork.
+   */
+  shared_ptr<hostFd> pidFd;
 
   bool rdfsNotNull = false; /**< Indicates whether rdfs is NULL. */
   bool wrfsNotNull = false; /**< Indicates whether wrfs is NULL. */
   bool exfsNotNull = false; /**< Indicates whether exfs is NULL. */
+  // The original sets only live between a select pre and post hook, so they
+  // are never inherited by fork or clone.
   fd_set origRdfs; /**< Original file descriptors set to watch for read
                       availability. */
   fd_set origWrfs; /**< Original file descriptors set to watch for write
@@ -246,6 +325,12 @@ public:
   /** Flag to tell us to setup cpuid interception via an injected prctl(). */
   bool CPUIDTrapSet = false;
 
+  /**
+   * Name of the binary this process last exec'd, empty if unknown. Only set
+   * when a timeline or log filter uses it.
+   */
+  string executable;
+
   /** A register saver used to store the previous register state and retrieve at
    * a later stage */
   registerSaver regSaver;
@@ -323,39 +408,46 @@ public:
   long poll_retry_maximum;
 
   /**
-   * remote socket file descriptors, unix domain sockets excluded.
+   * Total number of times this process replayed a system call because it would
+   * have blocked.
    */
-  std::shared_ptr<std::unordered_set<int>> remote_sockfds;
+  uint64_t blockedReplays = 0;
 
   /**
-   * check whether a file descriptor is a remote socket fd
+   * Replays due to blocking since any process last made progress (entered a
+   * fresh system call). Used to detect replay storms.
    */
-  bool fd_is_remote(int fd) const {
-    return remote_sockfds->find(fd) != remote_sockfds->end();
-  }
+  uint32_t replaysWithoutProgress = 0;
 
   /**
-   * timerfds
+   * Value of globalState::progressEvents at our last blocked replay.
    */
-  std::shared_ptr<std::unordered_map<int, struct itimerspec>> timerfds;
+  uint64_t progressAtLastReplay = 0;
 
   /**
-   * check whether a file descriptor is a timerfd
+   * Times in a row we were caught in a replay storm. The scheduler skips us for
+   * 2^stormLevel rounds of blocked processes.
    */
-  bool fd_is_timerfd(int fd) const {
-    return timerfds->find(fd) != timerfds->end();
-  }
+  uint32_t stormLevel = 0;
+
+  /**
+   * Set when we replayed a blocked system call, so the seccomp stop of the
+   * replay is not counted as progress.
+   */
+  bool replayingBlockedSyscall = false;
 
   /**
-   * signalfds
+   * check whether a file descriptor is a remote socket fd
    */
-  std::shared_ptr<std::unordered_set<int>> signalfds;
+  bool fd_is_remote(int fd) const {
+    return fdInfo(fd).kind == fdKind::remoteSocket;
+  }
 
   /**
-   * check whether a file descriptor is a signalfd
+   * check whether a file descriptor is a timerfd
    */
-  bool fd_is_signalfd(int fd) const {
-    return signalfds->find(fd) != signalfds->end();
+  bool fd_is_timerfd(int fd) const {
+    return fdInfo(fd).kind == fdKind::timerfd;
   }
 };
 
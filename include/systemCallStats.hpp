@@ -0,0 +1,169 @@
+#ifndef SYSTEM_CALL_STATS_H
+#define SYSTEM_CALL_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "systemCallList.hpp"
+
+using namespace std;
+
+/**
+ * Log-scale histogram of latencies: bucket i counts latencies in
+ * [2^i, 2^(i+1)) nanoseconds, bucket 0 also counts 0ns and the last bucket
+ * everything longer.
+ */
+struct latencyHistogram {
+  static const int BUCKETS = 36;
+
+  uint64_t buckets[BUCKETS] = {};
+  uint64_t count = 0;
+  uint64_t totalNanos = 0;
+
+  void add(uint64_t nanos) {
+    int bucket = nanos == 0 ? 0 : 63 - __builtin_clzll(nanos);
+    buckets[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+    count++;
+    totalNanos += nanos;
+  }
+
+  /**
+   * Upper bound of the bucket the p-th quantile (0 < p <= 1) falls in.
+   */
+  uint64_t quantile(double p) const;
+};
+
+/**
+ * What the tracer did for one system call number.
+ */
+struct systemCallCounters {
+  /** ptrace stops before (seccomp) and after the system call. */
+  uint64_t preStops = 0;
+  uint64_t postStops = 0;
+  /** Times we made the tracee execute the system call again. */
+  uint64_t replays = 0;
+  /** Times we cancelled or nooped the system call and made up its result. */
+  uint64_t emulations = 0;
+  /** System calls we injected while handling this one, e.g. arch_prctl. */
+  uint64_t injected = 0;
+
+  /** Tracer-side handling time of each stop, only kept if timing. */
+  latencyHistogram preLatency;
+  latencyHistogram postLatency;
+};
+
+/**
+ * A global counter in the statistics report.
+ */
+struct statistic {
+  string label; /**< Shown in the text report. */
+  string key;   /**< Key in the JSON report. */
+  uint64_t value;
+};
+
+/**
+ * Per system call statistics, so we can tell which system calls cost us the
+ * most tracer time and are worth optimising.
+ *
+ * execution tells us which system call it is handling on every stop; the
+ * replay/emulation/injection counters are attributed to that system call by
+ * the helpers in utilSystemCalls.cpp. Latencies are measured with the
+ * monotonic clock from the moment we get the ptrace stop until we are done
+ * handling it, and only when timing is enabled.
+ */
+class systemCallStats {
+public:
+  systemCallStats();
+
+  /**
+   * Measure handling latencies from now on.
+   */
+  void enableTiming() { timing = true; }
+
+  /**
+   * A pre/post stop for this system call, which becomes the current one.
+   */
+  void preStop(long syscall) {
+    current = slot(syscall);
+    counters[current].preStops++;
+  }
+  void postStop(long syscall) {
+    current = slot(syscall);
+    counters[current].postStops++;
+  }
+
+  /**
+   * Count a replay, emulation or injected system call for the current system
+   * call.
+   */
+  void replay() { counters[current].replays++; }
+  void emulation() { counters[current].emulations++; }
+  void injection() { counters[current].injected++; }
+
+  /**
+   * Start timing the handling of a stop; 0 if not timing.
+   */
+  uint64_t startTimer() const { return timing ? nowNanos() : 0; }
+
+  /**
+   * Done handling the pre/post stop of the current system call started at
+   * start.
+   */
+  void endPreStop(uint64_t start) {
+    if (timing) {
+      counters[current].preLatency.add(nowNanos() - start);
+    }
+  }
+  void endPostStop(uint64_t start) {
+    if (timing) {
+      counters[current].postLatency.add(nowNanos() - start);
+    }
+  }
+
+  const systemCallCounters& get(long syscall) const {
+    return counters[slot(syscall)];
+  }
+
+  /**
+   * Print a table of every system call we stopped for, most expensive first
+   * (most stops first if not timing).
+   */
+  void printText(ostream& out) const;
+
+  /**
+   * Write the whole statistics report: global counters, the scheduling policy
+   * and every system call we stopped for, with histograms.
+   */
+  void writeJson(
+      ostream& out,
+      const vector<statistic>& globals,
+      const string& schedulingPolicy) const;
+
+private:
+  /** Index into counters, unknown system calls share the last slot. */
+  static int slot(long syscall) {
+    return 0 <= syscall && syscall < SYSTEM_CALL_COUNT ? syscall
+                                                       : SYSTEM_CALL_COUNT;
+  }
+
+  static const string& name(int slot);
+
+  static uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+
+  /** Slots we stopped for at least once, most expensive first. */
+  vector<int> usedSlots() const;
+
+  bool timing = false;
+  int current = SYSTEM_CALL_COUNT;
+  vector<systemCallCounters> counters;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef TRACE_TIMELINE_H
+#define TRACE_TIMELINE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * Timeline of a run in Chrome trace event format, for chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * Every tracee gets a track (threads grouped under their thread group) that
+ * shows, back to back:
+ *   - running: the tracee ran until its next stop;
+ *   - the stop: the system call or event we handled, e.g. "openat" or
+ *     "openat (post)";
+ *   - parked: stopped, waiting for the scheduler to let it run again, which is
+ *     the serialization dettrace imposes;
+ *   - blocked: parked after we preempted it for a system call that would have
+ *     blocked, until its retry.
+ * Forks, execs and exits are instant events.
+ *
+ * Built from the events execution::runProgram sees; only the tracer thread
+ * calls it.
+ */
+class traceTimeline {
+public:
+  traceTimeline(const string& path);
+
+  /**
+   * Terminate the JSON and close the file.
+   */
+  ~traceTimeline();
+
+  traceTimeline(const traceTimeline&) = delete;
+  traceTimeline& operator=(const traceTimeline&) = delete;
+
+  /**
+   * We are letting pid run.
+   */
+  void resumed(pid_t pid);
+
+  /**
+   * We got a ptrace stop for pid, of the given kind.
+   */
+  void stopped(pid_t pid, const char* event);
+
+  /**
+   * The current stop is for this system call.
+   */
+  void systemCall(int syscall, bool post);
+
+  /**
+   * Done handling the current stop, its process is now parked, or blocked
+   * if blocked is set.
+   */
+  void handled(bool blocked);
+
+  /**
+   * Process we are handling a stop for, -1 if none.
+   */
+  pid_t stoppedProcess() const { return stopPid; }
+
+  void spawned(pid_t parent, pid_t child, bool isThread);
+  void exec(pid_t pid, const string& executable);
+  void exited(pid_t pid);
+
+private:
+  struct tracee {
+    pid_t threadGroup;
+    uint64_t resumedAt = 0;
+    /** When it was parked, 0 if running or never parked. */
+    uint64_t parkedAt = 0;
+    bool blocked = false;
+  };
+
+  tracee& get(pid_t pid);
+  uint64_t now() const;
+
+  /** A complete ("X") event from start to end, in nanoseconds. */
+  void complete(
+      pid_t pid,
+      const char* category,
+      const string& name,
+      uint64_t start,
+      uint64_t end);
+  void instant(pid_t pid, const char* name, const string& args);
+  void separator();
+
+  FILE* out;
+  uint64_t startTime;
+  bool firstEvent = true;
+
+  unordered_map<pid_t, tracee> tracees;
+
+  pid_t stopPid = -1;
+  uint64_t stopAt = 0;
+  string stopName;
+};
+
+#endif
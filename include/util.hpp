@@ -15,6 +15,8 @@
 
 #include <linux/futex.h>
 
+#include "eventFingerprint.hpp"
+#include "phaseProfiler.hpp"
 #include "traceePtr.hpp"
 
 using namespace std;
@@ -43,6 +45,13 @@ V get_with_default(
  */
 void runtimeError(string error);
 
+/**
+ * Have runtimeError call hook before throwing. The error usually ends the
+ * tracer through std::terminate, without unwinding: hook is the last chance to
+ * write out what it holds, such as queued log messages.
+ */
+void setRuntimeErrorHook(void (*hook)());
+
 extern unordered_map<int, string> futexCommands;
 extern unordered_map<int, string> futexAdditionalFlags;
 
@@ -87,6 +96,7 @@ ssize_t readVmTraceeRaw(
     T* localMemory,
     size_t numberOfBytes,
     pid_t traceePid) {
+  phaseTimer timer(Phase::memory);
   iovec remoteIoVec = {traceeMemory.ptr, numberOfBytes};
   iovec localIoVec = {localMemory, numberOfBytes};
   const unsigned long flags = 0;
@@ -110,6 +120,7 @@ void writeVmTraceeRaw(
     traceePtr<T> traceeMemory,
     size_t numberOfBytes,
     pid_t traceePid) {
+  phaseTimer timer(Phase::memory);
   iovec remoteIoVec = {traceeMemory.ptr, numberOfBytes};
   iovec localIoVec = {localMemory, numberOfBytes};
   const unsigned long flags = 0;
@@ -117,6 +128,7 @@ void writeVmTraceeRaw(
   doWithCheck(
       process_vm_writev(traceePid, &localIoVec, 1, &remoteIoVec, 1, flags),
       "writeVmTraceeRaw: Error calling process_vm_writev");
+  traceFingerprint.addBytes(localMemory, numberOfBytes);
 
   return;
 }
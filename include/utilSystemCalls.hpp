@@ -1,6 +1,7 @@
 #ifndef UTIL_SYSTEM_CALLS
 #define UTIL_SYSTEM_CALLS
 
+#include <fcntl.h>
 #include <optional>
 #include "globalState.hpp"
 #include "logger.hpp"
@@ -92,7 +93,7 @@ ino_t readInodeFor(logger& log, pid_t traceePid, int fd);
  * currently open for traceePid.
  */
 ino_t inode_from_tracee(
-    const string& traceePath, pid_t traceePid, logger& log, int traceeDirFd);
+    const string& traceePath, globalState& gs, state& s, int traceeDirFd);
 
 /**
  *
@@ -149,20 +150,26 @@ bool sendTraceeSignalNow(
     int signum, globalState& gs, state& s, ptracer& t, scheduler& sched);
 
 /**
- * Given a path used by the tracee, either relative or absolute, resolve the
- * exact file the tracee refered to. Uses combination of /proc/traceePid/cwd,
- * /proc/traceePid/root, to resolve path. Takes optional dirfd argument, for
- * tracee calls using *at.
+ * stat, or lstat unless follow is set, the exact file the tracee refered to
+ * with a path, either relative or absolute. Takes optional dirfd argument, for
+ * tracee calls using *at. Resolves relative to our descriptors of the tracee's
+ * cwd and root in s.dirs, or of its dirfd, so the kernel only walks the given
+ * path. Returns 0, or the errno on failure.
  */
-string resolve_tracee_path(
-    const string& traceePath, pid_t traceePid, logger& log, int traceeDirFd);
+int stat_tracee_path(
+    const string& traceePath,
+    globalState& gs,
+    state& s,
+    int traceeDirFd,
+    bool follow,
+    struct stat& statbuf);
 
 /**
- * Check if a file relative to a tracee exists. Calls resolve_tracee_path,
+ * Check if a file relative to a tracee exists. Calls stat_tracee_path,
  * uses stat on file to emulate behavior of open() and openat().
  */
 bool tracee_file_exists(
-    const string& traceePath, pid_t traceePid, logger& log, int traceeDirFd);
+    const string& traceePath, globalState& gs, state& s, int traceeDirFd);
 /**
  * Handler for open and openat. Checks if the file exists and sets
  * s.fileExisted, if O_CREAT was set. This way we know whether a new file was
@@ -182,4 +189,36 @@ void handlePreOpens(
  * to get the anonymous inode.
  */
 void handlePostOpens(globalState& gs, state& s, ptracer& t, int flags);
+/**
+ * Pre hook of getdents and getdents64. Once we have the directory's listing,
+ * zero the count so the kernel reads nothing; handleDents serves the call.
+ */
+void handleDentsPre(globalState& gs, state& s, ptracer& t);
+/**
+ * Sorted listing of the whole directory the tracee's fd refers to, positioned
+ * at its first entry. From gs.directories if the directory did not change
+ * since we last read it, otherwise read through a new descriptor of ours, so
+ * the tracee's position is left alone, and cached.
+ */
+shared_ptr<directoryEntries<linux_dirent64>> readTraceeDirectory(
+    globalState& gs, state& s, int fd);
+/**
+ * Pre hook of system calls that remove a name: unlink, unlinkat, rmdir, and
+ * rename over an existing file. If the name at pathAddr is the last link to
+ * its inode, remember the inode in s.inodeToDelete. For renames, renamedAddr
+ * is the old path: renaming a file over itself deletes nothing.
+ */
+void markLastLink(
+    globalState& gs,
+    state& s,
+    ptracer& t,
+    uint64_t pathAddr,
+    int traceeDirFd,
+    uint64_t renamedAddr = 0,
+    int renamedDirFd = AT_FDCWD);
+/**
+ * Post hook of the same: the name is gone if the system call succeeded, erase
+ * the inode we marked from gs.inodes.
+ */
+void eraseMarkedInode(globalState& gs, state& s, ptracer& t);
 #endif
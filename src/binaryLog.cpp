@@ -0,0 +1,439 @@
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binaryLog.hpp"
+#include "util.hpp"
+
+// =======================================================================================
+bool parseFormat(const char* format, vector<formatPiece>& pieces) {
+  pieces.clear();
+  formatPiece current{"", false, formatArg::integer};
+  int conversions = 0;
+
+  for (const char* p = format; *p != '\0';) {
+    if (*p != '%') {
+      current.text += *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      current.text += "%%";
+      p += 2;
+      continue;
+    }
+
+    const char* spec = p++;
+    while (*p != '\0' && strchr("-+ #0'", *p) != nullptr) {
+      p++;
+    }
+    while (isdigit(*p)) {
+      p++;
+    }
+    if (*p == '.') {
+      p++;
+      while (isdigit(*p)) {
+        p++;
+      }
+    }
+    if (*p == '*') {
+      return false;
+    }
+
+    bool isLong = false;
+    while (*p != '\0' && strchr("hlzjtqL", *p) != nullptr) {
+      if (*p == 'L') {
+        return false;
+      }
+      isLong = isLong || *p != 'h';
+      p++;
+    }
+
+    switch (*p) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'c':
+      current.kind = isLong ? formatArg::longInteger : formatArg::integer;
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      current.kind = formatArg::floating;
+      break;
+    case 's':
+      if (isLong) {
+        return false;
+      }
+      current.kind = formatArg::string;
+      break;
+    case 'p':
+      current.kind = formatArg::pointer;
+      break;
+    default:
+      // %n, %m, and anything glibc would print verbatim.
+      return false;
+    }
+    p++;
+
+    if (++conversions > MAX_FORMAT_ARGS) {
+      return false;
+    }
+    current.text.append(spec, p - spec);
+    current.hasArg = true;
+    pieces.push_back(current);
+    current = formatPiece{"", false, formatArg::integer};
+  }
+
+  pieces.push_back(current);
+  return true;
+}
+/**
+ * Address ranges of the read only segments of every loaded object, where
+ * string literals live.
+ */
+static vector<pair<uintptr_t, uintptr_t>> readOnlySegments() {
+  vector<pair<uintptr_t, uintptr_t>> segments;
+  dl_iterate_phdr(
+      [](struct dl_phdr_info* info, size_t, void* data) {
+        auto& segments = *(vector<pair<uintptr_t, uintptr_t>>*)data;
+        for (int i = 0; i < info->dlpi_phnum; i++) {
+          const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+          if (phdr.p_type == PT_LOAD && (phdr.p_flags & PF_W) == 0) {
+            uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+            segments.emplace_back(start, start + phdr.p_memsz);
+          }
+        }
+        return 0;
+      },
+      &segments);
+  return segments;
+}
+// =======================================================================================
+binaryLog::binaryLog(const string& path, uint64_t capacity)
+    : literalSegments(readOnlySegments()) {
+  if (capacity == 0) {
+    runtimeError("Binary log needs room for at least one record");
+  }
+
+  int fd = doWithCheck(
+      open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644),
+      "binaryLog: open");
+  mappedBytes = BINARY_LOG_HEADER_BYTES + BINARY_LOG_TEMPLATE_BYTES +
+                capacity * sizeof(binaryLogRecord);
+  doWithCheck(ftruncate(fd, mappedBytes), "binaryLog: ftruncate");
+
+  void* base =
+      mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    runtimeError("binaryLog: unable to mmap " + path);
+  }
+  close(fd);
+
+  header = (binaryLogHeader*)base;
+  templates = (char*)base + BINARY_LOG_HEADER_BYTES;
+  ring = (binaryLogRecord*)(templates + BINARY_LOG_TEMPLATE_BYTES);
+
+  memcpy(header->magic, BINARY_LOG_MAGIC, sizeof(header->magic));
+  header->version = BINARY_LOG_VERSION;
+  header->recordSize = sizeof(binaryLogRecord);
+  header->capacity = capacity;
+  header->templateBytes = BINARY_LOG_TEMPLATE_BYTES;
+  // Template 0 (TEXT_TEMPLATE) is the empty string.
+  header->templateUsed = 1;
+  header->templateCount = 1;
+  header->written = 0;
+}
+
+binaryLog::~binaryLog() { munmap(header, mappedBytes); }
+// =======================================================================================
+const binaryLog::templateInfo& binaryLog::lookupTemplate(const char* format) {
+  auto it = templateIds.find(format);
+  if (it == templateIds.end() && !isLiteral(format)) {
+    // A buffer formatted at runtime, e.g. by asprintf: its address means
+    // nothing, don't give it a template.
+    return nonLiteral;
+  }
+  if (it != templateIds.end()) {
+    // Not a string literal after all, but a buffer reused for different
+    // messages. Log whatever comes from this address as text from now on.
+    if (!it->second.textOnly && it->second.format != format) {
+      it->second.textOnly = true;
+    }
+    return it->second;
+  }
+
+  templateInfo info{TEXT_TEMPLATE, true, format, {}};
+  vector<formatPiece> pieces;
+  size_t length = strlen(format) + 1;
+  if (parseFormat(format, pieces) &&
+      header->templateUsed + length <= header->templateBytes) {
+    memcpy(templates + header->templateUsed, format, length);
+    header->templateUsed += length;
+    info.id = header->templateCount++;
+    info.textOnly = false;
+    for (auto& piece : pieces) {
+      if (piece.hasArg) {
+        info.args.push_back(piece.kind);
+      }
+    }
+  }
+
+  return templateIds.emplace(format, move(info)).first->second;
+}
+
+bool binaryLog::isLiteral(const char* format) const {
+  uintptr_t address = (uintptr_t)format;
+  for (auto& segment : literalSegments) {
+    if (segment.first <= address && address < segment.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+binaryLogRecord& binaryLog::nextRecord(
+    uint64_t entryId,
+    uint8_t importance,
+    uint8_t flags,
+    const logContext& context) {
+  binaryLogRecord& r = ring[header->written % header->capacity];
+  r.entryId = entryId;
+  r.logicalTime = context.logicalTime;
+  r.retval = context.retval;
+  memcpy(r.syscallArgs, context.syscallArgs, sizeof(r.syscallArgs));
+  r.pid = context.pid;
+  r.syscall = context.syscall;
+  r.templateId = TEXT_TEMPLATE;
+  r.importance = importance;
+  r.flags = flags | (context.hasRetval ? RECORD_HAS_RETVAL : 0);
+  r.formatArgCount = 0;
+  r.textLength = 0;
+  return r;
+}
+// =======================================================================================
+void binaryLog::write(
+    uint64_t entryId,
+    uint8_t importance,
+    uint8_t flags,
+    const logContext& context,
+    const char* format,
+    va_list args) {
+  const templateInfo& info = lookupTemplate(format);
+
+  uint64_t values[MAX_FORMAT_ARGS];
+  const char* strings[MAX_FORMAT_ARGS];
+  size_t stringBytes = 0;
+  bool fits = !info.textOnly;
+
+  va_list copy;
+  va_copy(copy, args);
+  for (size_t i = 0; fits && i < info.args.size(); i++) {
+    strings[i] = nullptr;
+    switch (info.args[i]) {
+    case formatArg::integer:
+      values[i] = (uint64_t)(int64_t)va_arg(copy, int);
+      break;
+    case formatArg::longInteger:
+      values[i] = (uint64_t)va_arg(copy, long);
+      break;
+    case formatArg::floating: {
+      double d = va_arg(copy, double);
+      memcpy(&values[i], &d, sizeof(d));
+    } break;
+    case formatArg::pointer:
+      values[i] = (uint64_t)va_arg(copy, void*);
+      break;
+    case formatArg::string:
+      strings[i] = va_arg(copy, const char*);
+      if (strings[i] == nullptr) {
+        strings[i] = "(null)";
+      }
+      stringBytes += strlen(strings[i]) + 1;
+      fits = stringBytes <= RECORD_TEXT_BYTES;
+      break;
+    }
+  }
+  va_end(copy);
+
+  if (!fits) {
+    char buffer[512];
+    va_copy(copy, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, copy);
+    va_end(copy);
+    if (length < 0) {
+      length = 0;
+    }
+    if (length < (int)sizeof(buffer)) {
+      writeText(entryId, importance, flags, context, buffer, length);
+    } else {
+      string text(length + 1, '\0');
+      vsnprintf(&text[0], text.size(), format, args);
+      writeText(entryId, importance, flags, context, text.c_str(), length);
+    }
+    return;
+  }
+
+  binaryLogRecord& r = nextRecord(entryId, importance, flags, context);
+  r.templateId = info.id;
+  r.formatArgCount = info.args.size();
+  for (size_t i = 0; i < info.args.size(); i++) {
+    if (strings[i] == nullptr) {
+      r.formatArgs[i] = values[i];
+      continue;
+    }
+    size_t length = strlen(strings[i]) + 1;
+    memcpy(r.text + r.textLength, strings[i], length);
+    r.formatArgs[i] = r.textLength;
+    r.textLength += length;
+  }
+  header->written++;
+}
+
+void binaryLog::writeText(
+    uint64_t entryId,
+    uint8_t importance,
+    uint8_t flags,
+    const logContext& context,
+    const char* text,
+    size_t length) {
+  size_t offset = 0;
+  do {
+    size_t chunk = min(length - offset, (size_t)RECORD_TEXT_BYTES);
+    uint8_t chunkFlags = offset == 0 ? flags : RECORD_CONTINUATION;
+    if (offset + chunk < length) {
+      chunkFlags |= RECORD_CONTINUES;
+    }
+    binaryLogRecord& r = nextRecord(entryId, importance, chunkFlags, context);
+    memcpy(r.text, text + offset, chunk);
+    r.textLength = chunk;
+    header->written++;
+    offset += chunk;
+  } while (offset < length);
+}
+// =======================================================================================
+binaryLogReader::binaryLogReader(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    runtimeError("Unable to open binary log " + path);
+  }
+  struct stat st;
+  doWithCheck(fstat(fd, &st), "binaryLogReader: fstat");
+  mappedBytes = st.st_size;
+  if (mappedBytes < BINARY_LOG_HEADER_BYTES) {
+    runtimeError(path + " is too small to be a binary log");
+  }
+
+  void* base = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    runtimeError("binaryLogReader: unable to mmap " + path);
+  }
+  close(fd);
+
+  header = (const binaryLogHeader*)base;
+  if (memcmp(header->magic, BINARY_LOG_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != BINARY_LOG_VERSION ||
+      header->recordSize != sizeof(binaryLogRecord)) {
+    runtimeError(
+        path + " is not a version " + to_string(BINARY_LOG_VERSION) +
+        " dettrace binary log");
+  }
+  const char* templateArea = (const char*)base + BINARY_LOG_HEADER_BYTES;
+  ring = (const binaryLogRecord*)(templateArea + header->templateBytes);
+  if (BINARY_LOG_HEADER_BYTES + header->templateBytes +
+          header->capacity * sizeof(binaryLogRecord) >
+      mappedBytes) {
+    runtimeError(path + " is truncated");
+  }
+
+  for (const char* t = templateArea;
+       templates.size() < header->templateCount &&
+       t < templateArea + header->templateUsed;
+       t += strlen(t) + 1) {
+    templates.emplace_back();
+    parseFormat(t, templates.back());
+  }
+}
+
+binaryLogReader::~binaryLogReader() {
+  munmap((void*)header, mappedBytes);
+}
+// =======================================================================================
+static void appendFormatted(string& out, const char* format, ...) {
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  if (length < (int)sizeof(buffer)) {
+    out.append(buffer, length);
+    return;
+  }
+
+  string bigger(length + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&bigger[0], bigger.size(), format, args);
+  va_end(args);
+  out.append(bigger, 0, length);
+}
+
+string binaryLogReader::render(const binaryLogRecord& r) const {
+  if (r.templateId == TEXT_TEMPLATE) {
+    return string(r.text, r.textLength);
+  }
+  if (r.templateId >= templates.size()) {
+    return "<unknown template " + to_string(r.templateId) + ">\n";
+  }
+
+  string message;
+  int arg = 0;
+  for (const formatPiece& piece : templates[r.templateId]) {
+    const char* f = piece.text.c_str();
+    if (!piece.hasArg) {
+      appendFormatted(message, f);
+      continue;
+    }
+    if (arg >= r.formatArgCount) {
+      message += "<missing argument>";
+      continue;
+    }
+
+    uint64_t value = r.formatArgs[arg++];
+    switch (piece.kind) {
+    case formatArg::integer:
+      appendFormatted(message, f, (int)value);
+      break;
+    case formatArg::longInteger:
+      appendFormatted(message, f, (long)value);
+      break;
+    case formatArg::floating: {
+      double d;
+      memcpy(&d, &value, sizeof(d));
+      appendFormatted(message, f, d);
+    } break;
+    case formatArg::pointer:
+      appendFormatted(message, f, (void*)value);
+      break;
+    case formatArg::string:
+      appendFormatted(
+          message, f, value < RECORD_TEXT_BYTES ? r.text + value : "");
+      break;
+    }
+  }
+  return message;
+}
+// =======================================================================================
@@ -11,6 +11,7 @@
 #include <sys/prctl.h>
 #include <sys/ptrace.h>
 #include <sys/reg.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
@@ -24,6 +25,7 @@
 #include "dettrace.hpp"
 #include "devrand.hpp"
 #include "execution.hpp"
+#include "logFilter.hpp"
 #include "logicalclock.hpp"
 #include "seccomp.hpp"
 #include "tempfile.hpp"
@@ -70,6 +72,23 @@ void sigalrmHandler(int _) {
   runtimeError("dettrace timeout expired\n");
 }
 
+/**
+ * Build the debug log filter from the (possibly NULL) filter options.
+ */
+static logFilter makeLogFilter(const TraceOptions* opts) {
+  auto str = [](const char* s) { return std::string{s ? s : ""}; };
+  logFilter filter;
+  filter.setPids(str(opts->log_pids));
+  filter.setExecutables(str(opts->log_executables));
+  filter.setSystemCalls(str(opts->log_syscalls));
+  filter.setSystemCallWindow(str(opts->log_syscall_window));
+  filter.setTimeWindow(
+      str(opts->log_time_window),
+      logical_clock::from_time_t(opts->epoch).time_since_epoch().count());
+  filter.setImportances(str(opts->log_importances));
+  return filter;
+}
+
 /**
  * Use stat to check if file/directory exists to mount.
  * @return boolean if file exists
@@ -138,6 +157,19 @@ static void createFileIfNotExist(const std::string& path) {
   return;
 }
 
+/**
+ * Raise the tracer's soft limit on open files to its hard limit. We keep
+ * descriptors of every tracee's cwd and root, and a pidfd, so a large build
+ * can outgrow the usual 1024. Only after forking the tracee: its limits must
+ * stay as they were.
+ */
+static void raiseFileLimit() {
+  struct rlimit limit;
+  doWithCheck(getrlimit(RLIMIT_NOFILE, &limit), "getrlimit(RLIMIT_NOFILE)");
+  limit.rlim_cur = limit.rlim_max;
+  doWithCheck(setrlimit(RLIMIT_NOFILE, &limit), "setrlimit(RLIMIT_NOFILE)");
+}
+
 static pid_t _dettrace(const TraceOptions* opts) {
   if (!opts) {
     return -1;
@@ -278,6 +310,8 @@ static int _dettrace_child(const CloneArgs* clone_args) {
     runtimeError("fork() failed.\n");
     exit(EXIT_FAILURE);
   } else if (pid > 0) {
+    raiseFileLimit();
+
     // We must mount proc so that the tracer sees the same PID and /proc/
     // directory as the tracee. The tracee will do the same so it sees /proc/
     // under it's chroot.
@@ -324,12 +358,20 @@ static int _dettrace_child(const CloneArgs* clone_args) {
         "spawnTracerTracee, pipe write");
 
     const char* log_file = opts->log_file ? opts->log_file : "";
+    uint64_t log_ring_records =
+        opts->binary_log ? (opts->log_ring_mib << 20) / sizeof(binaryLogRecord)
+                         : 0;
 
     execution exe{opts->debug_level,
                   pid,
                   opts->use_color,
                   log_file,
                   opts->print_statistics,
+                  opts->statistics_json ? opts->statistics_json : "",
+                  opts->live_stats ? opts->live_stats : "",
+                  opts->timeline_file ? opts->timeline_file : "",
+                  opts->fingerprint_file ? opts->fingerprint_file : "",
+                  opts->fingerprint_interval,
                   clone_args->vdso,
                   clone_args->nb_vdso,
                   opts->prng_seed,
@@ -338,7 +380,10 @@ static int _dettrace_child(const CloneArgs* clone_args) {
                   chrono::microseconds(opts->clock_step),
                   opts->sys_enter,
                   opts->sys_exit,
-                  opts->user_data};
+                  opts->user_data,
+                  opts->scheduling_policy,
+                  log_ring_records,
+                  makeLogFilter(opts)};
 
     globalExeObject = &exe;
     struct sigaction sa;
@@ -54,7 +54,6 @@
 
 using namespace std;
 
-static bool fd_is_nonblocking(state& s, int fd);
 
 // =======================================================================================
 bool accessSystemCall::handleDetPre(
@@ -69,8 +68,8 @@ void accessSystemCall::handleDetPost(
 // =======================================================================================
 bool arch_prctlSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "pre-hook for arch_prctl(%d, 0) == ARCH_SET_CPUID? %d\n", t.arg1(),
       t.arg1() == ARCH_SET_CPUID);
 
@@ -89,8 +88,8 @@ void arch_prctlSystemCall::handleDetPost(
     runtimeError("Got to arch_prctl post-hook without it being injected.");
   }
 
-  gs.log.writeToLog(
-      Importance::info, "post-hook for arch_prctl, returning %d\n",
+  LOG(
+      gs.log, Importance::info, "post-hook for arch_prctl, returning %d\n",
       t.getReturnValue());
 
   if (s.CPUIDTrapSet) {
@@ -105,7 +104,7 @@ void arch_prctlSystemCall::handleDetPost(
     string errmsg("cpuid interception (cpuid_fault) via arch_prctl failed: ");
     errmsg += strerror(-t.getReturnValue());
     errmsg += "\nPlease check `cpuid_fault` flag from `cat /proc/cpuinfo`";
-    gs.log.writeToLog(Importance::inter, errmsg);
+    LOG(gs.log, Importance::inter, errmsg);
     gs.allow_trapCPUID = false;
   } else {
     s.CPUIDTrapSet = true;
@@ -115,15 +114,17 @@ void arch_prctlSystemCall::handleDetPost(
   // I don't believe arch_prctl(ARCH_SET_CPUID) writes to tracee memory at all.
   t.setRegs(s.regSaver.popRegisterState());
 
-  gs.log.writeToLog(
-      Importance::info, "restored register state from arch_prctl post-hook\n");
+  LOG(
+      gs.log, Importance::info,
+      "restored register state from arch_prctl post-hook\n");
   replaySystemCall(gs, t, t.getSystemCallNumber());
 }
 // =======================================================================================
 bool alarmSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info, "alarm pre-hook, requesting alarm in %u second(s)\n",
+  LOG(
+      gs.log, Importance::info,
+      "alarm pre-hook, requesting alarm in %u second(s)\n",
       t.arg1());
   // run post-hook if necessary
   return sendTraceeSignalNow(SIGALRM, gs, s, t, sched);
@@ -137,6 +138,8 @@ void alarmSystemCall::handleDetPost(
 bool chdirSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg1(), gs.log, s.traceePid, t);
+  // Shared by the whole thread group, like the cwd itself.
+  s.dirs.write().cwd = nullptr;
 
   return false;
 }
@@ -188,36 +191,21 @@ bool closeSystemCall::handleDetPre(
 void closeSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int fd = (int)t.arg1();
-  gs.log.writeToLog(Importance::info, "close(%d)\n", fd);
-  // Remove entry from our dirEntries.
-  auto result = s.dirEntries.find(fd);
-  // Exists.
-  if (result != s.dirEntries.end()) {
-    gs.log.writeToLog(
-        Importance::info, "Removing directory entries for fd: %d!\n", fd);
-    s.dirEntries.erase(result);
-  }
-
-  // Remove entry from our fd set for pipes.
-  if (s.countFdStatus(fd) != 0) {
-    gs.log.writeToLog(Importance::info, "Removing pipe fd: %d!\n", fd);
-    s.fdStatus.get()->erase(fd);
-  }
-
-  if (s.fd_is_remote(fd)) {
-    s.remote_sockfds->erase(fd);
-  }
-  if (s.fd_is_timerfd(fd)) {
-    s.timerfds->erase(fd);
-  }
-  if (s.fd_is_signalfd(fd)) {
-    s.signalfds->erase(fd);
+  LOG(gs.log, Importance::info, "close(%d)\n", fd);
+  // Remove entry from our file descriptor table.
+  if (s.fdInfo(fd).kind != fdKind::none) {
+    LOG(gs.log, Importance::info, "Removing fd: %d!\n", fd);
+    s.closeFd(fd);
   }
 }
 // =======================================================================================
 // TODO
 bool connectSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
+  if (!gs.log.enabled(Importance::info)) {
+    return true;
+  }
+
   int sockfd = t.arg1();
   socklen_t len = t.arg3();
   char* buff;
@@ -242,7 +230,7 @@ bool connectSystemCall::handleDetPre(
         inet_ntop(AF_INET, &sockaddr.sin_addr, dst, 128),
         ntohs(sockaddr.sin_port));
   }
-  gs.log.writeToLog(Importance::info, buff);
+  LOG(gs.log, Importance::info, buff);
   free(buff);
 
   return true;
@@ -273,8 +261,7 @@ void creatSystemCall::handleDetPost(
   // here to be safe. (Not sure how we could use this information to optimze
   // anyways.)
   auto inode = readInodeFor(gs.log, s.traceePid, t.getReturnValue());
-  gs.mtimeMap[inode] = s.getLogicalTime();
-  gs.inodeMap.addRealValue(inode);
+  gs.inodes.created(inode, s.getLogicalTime());
   s.incrementTime();
 
   return;
@@ -293,14 +280,9 @@ void dupSystemCall::handleDetPost(
     return;
   }
 
-  // dup succeeded.
-  if (s.countFdStatus(fd) != 0) { // Only for pipes
-    s.setFdStatus(newfd, s.getFdStatus(fd)); // copy over status.
-    if (s.fd_is_remote(fd)) {
-      s.remote_sockfds->insert(newfd);
-    }
-    gs.log.writeToLog(Importance::info, "%d = dup(%d)\n", newfd, fd);
-  }
+  // dup succeeded, copy over what we know about fd.
+  s.dupFd(fd, newfd);
+  LOG(gs.log, Importance::info, "%d = dup(%d)\n", newfd, fd);
 }
 // =======================================================================================
 bool dup2SystemCall::handleDetPre(
@@ -312,29 +294,15 @@ void dup2SystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int newfd = t.getReturnValue();
   int fd = t.arg1();
-  gs.log.writeToLog(Importance::info, "dup2(%d) returned %d\n", fd, newfd);
+  LOG(gs.log, Importance::info, "dup2(%d) returned %d\n", fd, newfd);
   if (newfd < 0) {
     return;
   }
 
-  // dup2 succeeded.
-  if (s.countFdStatus(fd) != 0) { // Only for pipes
-
-    // Semantics of dup2 say old fd could be closed and overwritten, we do that
-    // implicitly here!
-    s.setFdStatus(newfd, s.getFdStatus(fd));
-    if (s.fd_is_remote(fd)) {
-      s.remote_sockfds->insert(newfd);
-    }
-    if (s.fd_is_timerfd(fd)) {
-      auto it = (*s.timerfds)[fd];
-      s.timerfds->insert({newfd, it});
-    }
-    if (s.fd_is_signalfd(fd)) {
-      s.signalfds->insert(newfd);
-    }
-    gs.log.writeToLog(Importance::info, "%d = dup2(%d)\n", newfd, fd);
-  }
+  // dup2 succeeded. Semantics of dup2 say old fd could be closed and
+  // overwritten, we do that implicitly here!
+  s.dupFd(fd, newfd);
+  LOG(gs.log, Importance::info, "%d = dup2(%d)\n", newfd, fd);
 }
 
 static const char* epoll_op(int op) {
@@ -360,8 +328,8 @@ bool epoll_ctlSystemCall::handleDetPre(
 
   string op = epoll_op((int)t.arg2());
 
-  gs.log.writeToLog(
-      Importance::info, "epoll_ctl(" + to_string(t.arg1()) + "..)\n");
+  LOG(
+      gs.log, Importance::info, "epoll_ctl(" + to_string(t.arg1()) + "..)\n");
 
   readVmTraceeRaw(
       traceePtr<struct epoll_event>(traceeEvent), &epev, sizeof(epev),
@@ -370,20 +338,24 @@ bool epoll_ctlSystemCall::handleDetPre(
     runtimeError("epoll_ctl call used EPOLLONESHOT flag!");
   }
   if ((epev.events & EPOLLIN) == EPOLLIN) {
-    gs.log.writeToLog(
-        Importance::info, op + " EPOLLIN " + to_string(epev.data.u64) + "\n");
+    LOG(
+        gs.log, Importance::info,
+        op + " EPOLLIN " + to_string(epev.data.u64) + "\n");
   }
   if ((epev.events & EPOLLOUT) == EPOLLOUT) {
-    gs.log.writeToLog(
-        Importance::info, op + " EPOLLOUT " + to_string(epev.data.u64) + "\n");
+    LOG(
+        gs.log, Importance::info,
+        op + " EPOLLOUT " + to_string(epev.data.u64) + "\n");
   }
   if ((epev.events & EPOLLPRI) == EPOLLERR) {
-    gs.log.writeToLog(
-        Importance::info, op + " EPOLLERR " + to_string(epev.data.u64) + "\n");
+    LOG(
+        gs.log, Importance::info,
+        op + " EPOLLERR " + to_string(epev.data.u64) + "\n");
   }
   if ((epev.events & EPOLLPRI) == EPOLLPRI) {
-    gs.log.writeToLog(
-        Importance::info, op + " EPOLLPRI " + to_string(epev.data.u64) + "\n");
+    LOG(
+        gs.log, Importance::info,
+        op + " EPOLLPRI " + to_string(epev.data.u64) + "\n");
   }
 
   return false;
@@ -423,25 +395,26 @@ bool epoll_waitSystemCall::handleDetPre(
     t.writeArg4(0);
   }
 
-  gs.log.writeToLog(
-      Importance::info, "epoll_wait on fd: " + to_string(t.arg1()) + "\n");
+  LOG(
+      gs.log, Importance::info,
+      "epoll_wait on fd: " + to_string(t.arg1()) + "\n");
   return true;
 }
 
 void epoll_waitSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  if ((int)t.getReturnValue() > 0) {
+  if ((int)t.getReturnValue() > 0 && gs.log.enabled(Importance::extra)) {
     epoll_log_event(gs, t);
   }
 
   if ((int)s.originalArg4 < 0) {
-    gs.log.writeToLog(Importance::info, "Blocking epoll_wait found\n");
+    LOG(gs.log, Importance::info, "Blocking epoll_wait found\n");
     bool replay = replaySyscallIfBlocked(gs, s, t, sched, 0);
     if (replay) {
       t.writeArg4(s.originalArg4);
     }
   } else {
-    gs.log.writeToLog(Importance::info, "Non-blocking epoll found\n");
+    LOG(gs.log, Importance::info, "Non-blocking epoll found\n");
     sched.preemptAndScheduleNext();
   }
   return;
@@ -460,13 +433,13 @@ bool epoll_pwaitSystemCall::handleDetPre(
 void epoll_pwaitSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   if ((int)s.originalArg4 < 0) {
-    gs.log.writeToLog(Importance::info, "Blocking epoll_wait found\n");
+    LOG(gs.log, Importance::info, "Blocking epoll_wait found\n");
     bool replay = replaySyscallIfBlocked(gs, s, t, sched, 0);
     if (replay) {
       t.writeArg4(s.originalArg4);
     }
   } else {
-    gs.log.writeToLog(Importance::info, "Non-blocking epoll found\n");
+    LOG(gs.log, Importance::info, "Non-blocking epoll found\n");
     sched.preemptAndScheduleNext();
   }
   return;
@@ -476,8 +449,7 @@ bool execveSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg1(), gs.log, s.traceePid, t);
 
-  auto tgNumber = gs.threadGroupNumber.at(s.traceePid);
-  if (gs.threadGroups.count(tgNumber) != 1) {
+  if (gs.processes->threadGroupSize(s.traceePid) != 1) {
     runtimeError("We do not support exec from threaded process groups!");
   }
 
@@ -487,7 +459,7 @@ bool execveSystemCall::handleDetPre(
   string execveEnvp{};
 
   // Print all arguments to execve!
-  if (gs.log.getDebugLevel() > 0) {
+  if (gs.log.enabled(Importance::info)) {
     // Remeber these are addresses in the tracee. We must explicitly read them
     // ourselves!
     if (argv != nullptr) {
@@ -534,14 +506,14 @@ bool execveSystemCall::handleDetPre(
 // =======================================================================================
 bool exit_groupSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "Saw exit group!!\n");
+  LOG(gs.log, Importance::info, "Saw exit group!!\n");
   s.isExitGroup = true;
   return false;
 }
 
 void exit_groupSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "Saw exit group post hook!!\n");
+  LOG(gs.log, Importance::info, "Saw exit group post hook!!\n");
 }
 // =======================================================================================
 bool fchownatSystemCall::handleDetPre(
@@ -631,37 +603,31 @@ void fcntlSystemCall::handleDetPost(
   int cmd = t.arg2();
   int arg = t.arg3();
 
-  gs.log.writeToLog(
-      Importance::extra, "fcntl(" + to_string(fd) + ", " + to_string(cmd) +
-                             "..) = " + to_string(retval) + "\n");
+  LOG(
+      gs.log, Importance::extra,
+      "fcntl(" + to_string(fd) + ", " + to_string(cmd) + "..) = " +
+          to_string(retval) + "\n");
 
   if (cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC) {
     auto str = "found fcntl(%d, FDUPFD || F_DUPFD_CLOCEXEC) = %d\n";
     int newfd = retval;
-    gs.log.writeToLog(Importance::info, str, fd, newfd);
-    auto it = s.fdStatus.get()->find(fd);
-    auto end = s.fdStatus.get()->end();
-    if (it != end) {
+    LOG(gs.log, Importance::info, str, fd, newfd);
+    if (newfd >= 0) {
       // Same status as what it was duped from.
-      (*s.fdStatus.get())[newfd] = s.getFdStatus(fd);
-      if (s.fd_is_remote(fd)) {
-        s.remote_sockfds->insert(newfd);
-      }
-      if (s.fd_is_timerfd(fd)) {
-        auto it = (*s.timerfds)[fd];
-        s.timerfds->insert({newfd, it});
-      }
-      if (s.fd_is_signalfd(fd)) {
-        s.signalfds->insert(newfd);
-      }
+      s.dupFd(fd, newfd);
     }
   }
 
   // User attempting to change blocked status.
   if (cmd == F_SETFL && ((arg & O_NONBLOCK) != 0)) {
-    gs.log.writeToLog(
-        Importance::info, "found fcntl setting %d to non blocking!\n", fd);
-    (*s.fdStatus.get())[fd] = descriptorType::nonBlocking;
+    LOG(
+        gs.log, Importance::info,
+        "found fcntl setting %d to non blocking!\n", fd);
+    FdInfo& info = s.editFdInfo(fd);
+    if (info.kind == fdKind::none) {
+      info.kind = fdKind::regular;
+    }
+    info.mode = descriptorType::nonBlocking;
   }
 }
 // =======================================================================================
@@ -678,6 +644,17 @@ void faccessatSystemCall::handleDetPost(
   return;
 }
 // =======================================================================================
+bool fchdirSystemCall::handleDetPre(
+    globalState& gs, state& s, ptracer& t, scheduler& sched) {
+  s.dirs.write().cwd = nullptr;
+  return false;
+}
+
+void fchdirSystemCall::handleDetPost(
+    globalState& gs, state& s, ptracer& t, scheduler& sched) {
+  runtimeError("fchdir post hook should never be called.");
+}
+// =======================================================================================
 bool fgetxattrSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   return true;
@@ -704,7 +681,7 @@ void flistxattrSystemCall::handleDetPost(
 // =======================================================================================
 bool fstatSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "fstat(fd=%d)\n", t.arg1());
+  LOG(gs.log, Importance::info, "fstat(fd=%d)\n", t.arg1());
   return true;
 }
 
@@ -739,7 +716,7 @@ void fstatfsSystemCall::handleDetPost(
   struct statfs* statfsPtr = (struct statfs*)t.arg2();
 
   if (statfsPtr == nullptr) {
-    gs.log.writeToLog(Importance::info, "fstatfs: statfsbuf null.\n");
+    LOG(gs.log, Importance::info, "fstatfs: statfsbuf null.\n");
     return;
   }
 
@@ -764,17 +741,18 @@ bool futexSystemCall::handleDetPre(
   // See definitions of variables here.
   // https://github.com/spotify/linux/blob/master/include/linux/futex.h
   int futexCmd = futexOp & FUTEX_CMD_MASK;
-  gs.log.writeToLog(
-      Importance::info, "Operation: " + futexCommands.at(futexCmd) + "\n");
+  LOG(
+      gs.log, Importance::info,
+      "Operation: " + futexCommands.at(futexCmd) + "\n");
 
   if ((futexOp & FUTEX_PRIVATE_FLAG) != 0) {
-    gs.log.writeToLog(Importance::info, "with: FUTEX_PRIVATE_FLAG\n");
+    LOG(gs.log, Importance::info, "with: FUTEX_PRIVATE_FLAG\n");
   }
   if ((futexOp & FUTEX_CLOCK_REALTIME) != 0) {
-    gs.log.writeToLog(Importance::info, "with: FUTEX_CLOCK_REALTIME\n");
+    LOG(gs.log, Importance::info, "with: FUTEX_CLOCK_REALTIME\n");
   }
   if (timeoutPtr != NULL) {
-    gs.log.writeToLog(Importance::info, "with: user defined timeout.\n");
+    LOG(gs.log, Importance::info, "with: user defined timeout.\n");
   }
 
   // Handle wake operations by notifying scheduler of progress.
@@ -783,20 +761,21 @@ bool futexSystemCall::handleDetPre(
       futexCmd == FUTEX_WAKE_OP) {
     traceePtr<int> rptr((int*)t.arg1());
     int val = t.readFromTracee(rptr, t.getPid());
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "Waking on address: %p = %x, my pid: %u, traceesPid: %u\n", t.arg1(),
         val, t.getPid(), s.traceePid);
-    gs.log.writeToLog(
-        Importance::info, "Trying to wake up to %d threads.\n", futexValue);
+    LOG(
+        gs.log, Importance::info,
+        "Trying to wake up to %d threads.\n", futexValue);
 
     /*
     auto waiters = futex_remove_waiters(s, t.arg1(), futexValue);
     for (auto pidToWakeup: waiters) {
       if (pidToWakeup != t.getPid()) {
-        gs.log.writeToLog(Importance::info, "Scheduling task %d.\n",
+        LOG(gs.log, Importance::info, "Scheduling task %d.\n",
     pidToWakeup); sched.addAndScheduleNext(pidToWakeup); } else {
-        gs.log.writeToLog(Importance::info, "Scheduling task %d ignored (already
+        LOG(gs.log, Importance::info, "Scheduling task %d ignored (already
     running)\n", pidToWakeup);
       }
     }
@@ -809,15 +788,18 @@ bool futexSystemCall::handleDetPre(
   // runs out.
   if (futexCmd == FUTEX_WAIT || futexCmd == FUTEX_WAIT_BITSET ||
       futexCmd == FUTEX_WAIT_REQUEUE_PI) {
-    gs.log.writeToLog(
-        Importance::info, "Waiting on value at address: %p.\n", t.arg1());
-    gs.log.writeToLog(
-        Importance::info, "Against value: " + to_string(futexValue) + "\n");
+    LOG(
+        gs.log, Importance::info,
+        "Waiting on value at address: %p.\n", t.arg1());
+    LOG(
+        gs.log, Importance::info,
+        "Against value: " + to_string(futexValue) + "\n");
     if (gs.log.getDebugLevel() > 0) {
       int actualValue =
           (int)t.readFromTracee(traceePtr<int>((int*)t.arg1()), t.getPid());
-      gs.log.writeToLog(
-          Importance::info, "Actual value: " + to_string(actualValue) + "\n");
+      LOG(
+          gs.log, Importance::info,
+          "Actual value: " + to_string(actualValue) + "\n");
     }
 
     // Overwrite the current value with our value. Restore value in post hook.
@@ -826,8 +808,8 @@ bool futexSystemCall::handleDetPre(
 
     timespec ourTimeout = {0};
     if (timeoutPtr == nullptr) {
-      gs.log.writeToLog(
-          Importance::extra,
+      LOG(
+          gs.log, Importance::extra,
           "timeout null, writing our data to mmaped page...\n");
       timespec* newAddress = (timespec*)s.mmapMemory.getAddr().ptr;
       t.writeToTracee(traceePtr<timespec>(newAddress), ourTimeout, s.traceePid);
@@ -839,8 +821,8 @@ bool futexSystemCall::handleDetPre(
       if (gs.log.getDebugLevel() > 0) {
         timespec timeout =
             t.readFromTracee(traceePtr<timespec>(timeoutPtr), t.getPid());
-        gs.log.writeToLog(
-            Importance::info,
+        LOG(
+            gs.log, Importance::info,
             "Using original timeout value: (s = %d, ns = %d)\n", timeout.tv_sec,
             timeout.tv_nsec);
       }
@@ -858,8 +840,9 @@ void futexSystemCall::handleDetPost(
   int futexCmd = futexOp & FUTEX_CMD_MASK;
   if (futexCmd == FUTEX_WAIT || futexCmd == FUTEX_WAIT_BITSET ||
       futexCmd == FUTEX_WAIT_REQUEUE_PI) {
-    gs.log.writeToLog(
-        Importance::info, "Futex post-hook, handling wait operation.\n");
+    LOG(
+        gs.log, Importance::info,
+        "Futex post-hook, handling wait operation.\n");
 
     // *uaddr != val
     if (t.getReturnValue() == -EAGAIN) {
@@ -875,7 +858,7 @@ void futexSystemCall::handleDetPost(
       s.userDefinedTimeout = false;
       return;
     } else {
-      gs.log.writeToLog(Importance::info, "Replaying futex system call.\n");
+      LOG(gs.log, Importance::info, "Replaying futex system call.\n");
       t.writeArg4(s.originalArg4);
       replaySyscallIfBlocked(gs, s, t, sched, ETIMEDOUT);
     }
@@ -897,6 +880,7 @@ void getcwdSystemCall::handleDetPost(
 // =======================================================================================
 bool getdentsSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
+  handleDentsPre(gs, s, t);
   return true;
 }
 void getdentsSystemCall::handleDetPost(
@@ -907,6 +891,7 @@ void getdentsSystemCall::handleDetPost(
 // =======================================================================================
 bool getdents64SystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
+  handleDentsPre(gs, s, t);
   return true;
 }
 void getdents64SystemCall::handleDetPost(
@@ -994,7 +979,7 @@ void getrusageSystemCall::handleDetPost(
   struct rusage* usagePtr = (struct rusage*)t.arg2();
 
   if (usagePtr == nullptr) {
-    gs.log.writeToLog(Importance::info, "getrusage pointer null.");
+    LOG(gs.log, Importance::info, "getrusage pointer null.");
   } else {
     // jld; initializing usage from tracee memory seems redundant, as all fields
     // are overwritten below
@@ -1051,8 +1036,9 @@ bool gettimeofdaySystemCall::handleDetPre(
 
 void gettimeofdaySystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info, "Inside gettimeofday post-hook, sending tv_sec=%d\n",
+  LOG(
+      gs.log, Importance::info,
+      "Inside gettimeofday post-hook, sending tv_sec=%d\n",
       s.getLogicalTime().time_since_epoch().count());
   gs.timeCalls++;
   struct timeval* tp = (struct timeval*)t.arg1();
@@ -1111,8 +1097,8 @@ void ioctlSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int fd = t.arg1();
   const uint64_t request = t.arg2();
-  gs.log.writeToLog(Importance::info, "File descriptor: %d\n", fd);
-  gs.log.writeToLog(Importance::info, "Request 0x%" PRIx64 "\n", request);
+  LOG(gs.log, Importance::info, "File descriptor: %d\n", fd);
+  LOG(gs.log, Importance::info, "Request 0x%" PRIx64 "\n", request);
 
   switch (request) {
   // Even though we don't particularly like TCGETS, we will let it through as we
@@ -1184,10 +1170,15 @@ void ioctlSystemCall::handleDetPost(
     auto blocking_flag =
         flag ? descriptorType::nonBlocking : descriptorType::blocking;
     auto blocking_msg = flag ? "non blocking" : "blocking";
-    gs.log.writeToLog(
-        Importance::info, "found ioctl(%d, FIONBIO, &%d), setting %d to %s!\n",
+    LOG(
+        gs.log, Importance::info,
+        "found ioctl(%d, FIONBIO, &%d), setting %d to %s!\n",
         fd, flag, fd, blocking_msg);
-    (*s.fdStatus.get())[fd] = blocking_flag;
+    FdInfo& info = s.editFdInfo(fd);
+    if (info.kind == fdKind::none) {
+      info.kind = fdKind::regular;
+    }
+    info.mode = blocking_flag;
   } break;
   default:
     runtimeError(
@@ -1225,8 +1216,8 @@ void mmapSystemCall::handleDetPost(
   // This isn't a natural call mmap from the tracee we injected this call
   // ourselves!
   if (s.syscallInjected) {
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "This mmap was inject for use in pre and post hook purposes.\n");
 
     if (t.getRax().ptr == MAP_FAILED) {
@@ -1280,10 +1271,9 @@ void mkdirSystemCall::handleDetPost(
   if (t.getReturnValue() == 0 && (char*)t.arg1() != nullptr) {
     string strPath =
         t.readTraceeCString(traceePtr<char>((char*)t.arg1()), s.traceePid);
-    auto inode = inode_from_tracee(strPath, s.traceePid, gs.log, -1);
+    auto inode = inode_from_tracee(strPath, gs, s, -1);
     if (inode != -1UL) {
-      gs.mtimeMap[inode] = s.getLogicalTime();
-      gs.inodeMap.addRealValue(inode);
+      gs.inodes.created(inode, s.getLogicalTime());
       s.incrementTime();
     }
   }
@@ -1292,7 +1282,7 @@ void mkdirSystemCall::handleDetPost(
 bool mkdiratSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg2(), gs.log, s.traceePid, t);
-  gs.log.writeToLog(Importance::info, "dirfd: %d\n", t.arg1());
+  LOG(gs.log, Importance::info, "dirfd: %d\n", t.arg1());
   return true;
 }
 
@@ -1302,10 +1292,9 @@ void mkdiratSystemCall::handleDetPost(
   // Add/overwrite entry in our map.
   if (t.getReturnValue() == 0 && path != nullptr) {
     string strPath = t.readTraceeCString(traceePtr<char>(path), s.traceePid);
-    auto inode = inode_from_tracee(strPath, s.traceePid, gs.log, t.arg1());
+    auto inode = inode_from_tracee(strPath, gs, s, t.arg1());
     if (inode != -1UL) {
-      gs.mtimeMap[inode] = s.getLogicalTime();
-      gs.inodeMap.addRealValue(inode);
+      gs.inodes.created(inode, s.getLogicalTime());
       s.incrementTime();
     }
   }
@@ -1323,7 +1312,7 @@ void newfstatatSystemCall::handleDetPost(
   // This newfstatat was injected to get the inode belonging to a file that was
   // deleted through: unlink, unlinkat, or rmdir.
   if (s.syscallInjected) {
-    gs.log.writeToLog(Importance::info, "This newfstatat was injected.\n");
+    LOG(gs.log, Importance::info, "This newfstatat was injected.\n");
     s.syscallInjected = false;
 
     if (t.getReturnValue() >= 0) {
@@ -1331,14 +1320,14 @@ void newfstatatSystemCall::handleDetPost(
       struct stat statbuf =
           t.readFromTracee(traceePtr<struct stat>(statbufPtr), s.traceePid);
 
-      gs.log.writeToLog(
-          Importance::extra,
+      LOG(
+          gs.log, Importance::extra,
           "marking (device,inode) = (%lu,%lu) for deletion\n", statbuf.st_dev,
           statbuf.st_ino);
 
       s.inodeToDelete = statbuf.st_ino;
     } else {
-      gs.log.writeToLog(Importance::info, "No such file, that's okay.\n");
+      LOG(gs.log, Importance::info, "No such file, that's okay.\n");
       s.inodeToDelete = -1;
     }
 
@@ -1427,16 +1416,16 @@ void openatSystemCall::handleDetPost(
 // =======================================================================================
 bool pauseSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "pause pre-hook\n");
+  LOG(gs.log, Importance::info, "pause pre-hook\n");
   return true;
 }
 
 void pauseSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "pause post-hook\n");
+  LOG(gs.log, Importance::info, "pause post-hook\n");
   if (s.signalInjected) {
     uint64_t retval = t.getReturnValue();
-    gs.log.writeToLog(Importance::info, "pause returned %lld\n", retval);
+    LOG(gs.log, Importance::info, "pause returned %lld\n", retval);
 
     // ick: fake the return value for the call we hijacked.
     // For alarm(), 0 means there was no previously scheduled alarm.
@@ -1449,8 +1438,8 @@ void pauseSystemCall::handleDetPost(
 // =======================================================================================
 bool pipeSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info, "Making this pipe non-blocking via pipe2\n");
+  LOG(
+      gs.log, Importance::info, "Making this pipe non-blocking via pipe2\n");
 
   s.syscallInjected = true;
   t.changeSystemCall(SYS_pipe2);
@@ -1479,7 +1468,7 @@ bool pipe2SystemCall::handleDetPre(
   // We only see this pre-hook if the call was originally a pipe2 and not a pipe
   // that was converted into a pipe2. That's why it's okay to set s.originalArg2
   // here.
-  gs.log.writeToLog(Importance::info, "Making this pipe2 non-blocking\n");
+  LOG(gs.log, Importance::info, "Making this pipe2 non-blocking\n");
   // Convert pipe call to pipe2 to set O_NONBLOCK.
   s.originalArg2 = t.arg2();
   t.writeArg2(t.arg2() | O_NONBLOCK);
@@ -1494,40 +1483,42 @@ void pipe2SystemCall::handleDetPost(
   auto p = getPipeFds(gs, s, t);
 
   // Track this file descriptor:
-  if (s.countFdStatus(p.first) != 0) {
-    runtimeError("Value already in map (fdStatus): " + to_string(p.first));
+  if (s.fdInfo(p.first).kind != fdKind::none) {
+    runtimeError("Value already in fd table: " + to_string(p.first));
   }
-  if (s.countFdStatus(p.second) != 0) {
-    runtimeError("Value already in map (fdStatus): " + to_string(p.second));
+  if (s.fdInfo(p.second).kind != fdKind::none) {
+    runtimeError("Value already in fd table: " + to_string(p.second));
   }
+  s.editFdInfo(p.first).kind = fdKind::pipe;
+  s.editFdInfo(p.second).kind = fdKind::pipe;
 
   // This was a pipe that got converted to a pipe2.
   if (s.syscallInjected) {
     s.syscallInjected = false;
-    gs.log.writeToLog(Importance::info, "This used to a pipe()!\n");
-    gs.log.writeToLog(Importance::info, "Set pipe %d as blocking.\n", p.first);
-    gs.log.writeToLog(Importance::info, "Set pipe %d as blocking.\n", p.second);
-    s.setFdStatus(p.first, descriptorType::blocking);
-    s.setFdStatus(p.second, descriptorType::blocking);
+    LOG(gs.log, Importance::info, "This used to a pipe()!\n");
+    LOG(gs.log, Importance::info, "Set pipe %d as blocking.\n", p.first);
+    LOG(gs.log, Importance::info, "Set pipe %d as blocking.\n", p.second);
+    s.editFdInfo(p.first).mode = descriptorType::blocking;
+    s.editFdInfo(p.second).mode = descriptorType::blocking;
   } else {
     // Must be checked after resetting state.
     int flags = (int)t.arg2();
 
     // Check if set as non=blocking.
     if ((flags & O_NONBLOCK) == 0) {
-      gs.log.writeToLog(
-          Importance::info, "Set pipe %d as blocking.\n", p.first);
-      gs.log.writeToLog(
-          Importance::info, "Set pipe %d as blocking.\n", p.second);
-      s.setFdStatus(p.first, descriptorType::blocking);
-      s.setFdStatus(p.second, descriptorType::blocking);
+      LOG(
+          gs.log, Importance::info, "Set pipe %d as blocking.\n", p.first);
+      LOG(
+          gs.log, Importance::info, "Set pipe %d as blocking.\n", p.second);
+      s.editFdInfo(p.first).mode = descriptorType::blocking;
+      s.editFdInfo(p.second).mode = descriptorType::blocking;
     } else {
-      gs.log.writeToLog(
-          Importance::info, "Set pipe %d as non-blocking.\n", p.first);
-      gs.log.writeToLog(
-          Importance::info, "Set pipe %d as non-blocking.\n", p.second);
-      s.setFdStatus(p.first, descriptorType::nonBlocking);
-      s.setFdStatus(p.second, descriptorType::nonBlocking);
+      LOG(
+          gs.log, Importance::info, "Set pipe %d as non-blocking.\n", p.first);
+      LOG(
+          gs.log, Importance::info, "Set pipe %d as non-blocking.\n", p.second);
+      s.editFdInfo(p.first).mode = descriptorType::nonBlocking;
+      s.editFdInfo(p.second).mode = descriptorType::nonBlocking;
     }
   }
 }
@@ -1708,10 +1699,11 @@ bool readSystemCall::handleDetPre(
   	saveFile.close();
   }
 
-  gs.log.writeToLog(Importance::info, "File descriptor: %d\n", t.arg1());
-  gs.log.writeToLog(
-      Importance::info, "non-blocking: %d\n", (int)fd_is_nonblocking(s, fd));
-  gs.log.writeToLog(Importance::info, "Bytes to read %d\n", t.arg3());
+  LOG(gs.log, Importance::info, "File descriptor: %d\n", t.arg1());
+  LOG(
+      gs.log, Importance::info,
+      "non-blocking: %d\n", (int)s.fd_is_nonblocking(fd));
+  LOG(gs.log, Importance::info, "Bytes to read %d\n", t.arg3());
 
   return true;
 }
@@ -1731,18 +1723,17 @@ void readSystemCall::handleDetPost(
     s.totalBytes = 0;
   };
 
-  if (s.fd_is_timerfd(fd)) {
+  const FdInfo& info = s.fdInfo(fd);
+  if (info.kind == fdKind::timerfd) {
     t.writeToTracee(
         traceePtr<unsigned long>((unsigned long*)t.arg2()), 1UL, s.traceePid);
     s.totalBytes = sizeof(unsigned long);
     resetState();
     sched.preemptAndScheduleNext();
     return;
-  } else if (
-      s.countFdStatus(fd) != 0 &&
-      s.getFdStatus(fd) == descriptorType::nonBlocking) {
+  } else if (info.mode == descriptorType::nonBlocking) {
     // Pipe exists in our map and it's set to non blocking.
-    gs.log.writeToLog(Importance::info, "read found with non blocking pipe!\n");
+    LOG(gs.log, Importance::info, "read found with non blocking pipe!\n");
     int retval = t.getReturnValue();
 
     // for non-blocking io, if it returns -EAGAIN on the 1st try, let it through
@@ -1769,7 +1760,7 @@ void readSystemCall::handleDetPost(
 
   ssize_t bytes_read = t.getReturnValue();
   if (bytes_read < 0) {
-    gs.log.writeToLog(Importance::info, "Returned negative: %d.", bytes_read);
+    LOG(gs.log, Importance::info, "Returned negative: %d.", bytes_read);
     return;
   }
 
@@ -1788,7 +1779,7 @@ void readSystemCall::handleDetPost(
   s.totalBytes += bytes_read;
 
   if (s.firstTrySystemcall) {
-    gs.log.writeToLog(Importance::info, "First time seeing this read!\n");
+    LOG(gs.log, Importance::info, "First time seeing this read!\n");
     s.firstTrySystemcall = false;
     s.beforeRetry = t.getRegs();
   }
@@ -1798,7 +1789,7 @@ void readSystemCall::handleDetPost(
   if (bytes_read == 0 || // EOF
       s.totalBytes == s.beforeRetry.rdx // original bytes requested
       || isatty(fd) ) { // STDIN is a terminal
-    gs.log.writeToLog(Importance::info, "EOF or read all bytes.\n");
+    LOG(gs.log, Importance::info, "EOF or read all bytes.\n");
     
     // Save process reads
     if (saveToFile && fd == 0 && isatty(fd)) {
@@ -1830,7 +1821,7 @@ void readSystemCall::handleDetPost(
     
     resetState();
   } else {
-    gs.log.writeToLog(Importance::info, "Got less bytes than requested.\n");
+    LOG(gs.log, Importance::info, "Got less bytes than requested.\n");
     t.writeArg2(t.arg2() + bytes_read);
     t.writeArg3(t.arg3() - bytes_read);
     
@@ -1875,31 +1866,23 @@ void readlinkatSystemCall::handleDetPost(
   runtimeError("readlinkat post-hook should never be called.");
 }
 
-static bool fd_is_nonblocking(state& s, int fd) {
-  auto it = s.fdStatus.get()->find(fd);
-  auto end = s.fdStatus.get()->end();
-  if (it != end) {
-    return it->second == descriptorType::nonBlocking;
-  }
-  return false;
-}
-
 // =======================================================================================
 bool recvmsgSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int flags = (int)t.arg3();
   int fd = (int)t.arg1();
   bool nonblock =
-      (flags & MSG_DONTWAIT) == MSG_DONTWAIT || fd_is_nonblocking(s, fd);
-  gs.log.writeToLog(
-      Importance::info, "recvmsg from fd " + to_string(t.arg1()) +
-                            ", nonblock: " + to_string(nonblock) + "\n");
+      (flags & MSG_DONTWAIT) == MSG_DONTWAIT || s.fd_is_nonblocking(fd);
+  LOG(
+      gs.log, Importance::info,
+      "recvmsg from fd " + to_string(t.arg1()) +
+          ", nonblock: " + to_string(nonblock) + "\n");
   return true;
 }
 
 void recvmsgSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  if (!fd_is_nonblocking(s, (int)t.arg1())) {
+  if (!s.fd_is_nonblocking((int)t.arg1())) {
     replaySyscallIfBlocked(gs, s, t, sched, EAGAIN);
   }
 }
@@ -1909,52 +1892,57 @@ bool renameSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg1(), gs.log, s.traceePid, t, " old path: ");
   printInfoString(t.arg2(), gs.log, s.traceePid, t, " new path: ");
+  // A file renamed over loses its name.
+  markLastLink(gs, s, t, t.arg2(), AT_FDCWD, t.arg1(), AT_FDCWD);
   return true;
 }
 
 void renameSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // nothing to do, but return value may be useful for debugging (printed by
-  // handlePostSystemCall)
-  return;
+  eraseMarkedInode(gs, s, t);
 }
 // =======================================================================================
 bool renameatSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg2(), gs.log, s.traceePid, t, " renaming-ing path: ");
   printInfoString(t.arg4(), gs.log, s.traceePid, t, " to path: ");
+  markLastLink(gs, s, t, t.arg4(), t.arg3(), t.arg2(), t.arg1());
   return true;
 }
 
 void renameatSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // nothing to do, but return value may be useful for debugging (printed by
-  // handlePostSystemCall)
+  eraseMarkedInode(gs, s, t);
 }
 // =======================================================================================
 bool renameat2SystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg2(), gs.log, s.traceePid, t, " renaming-ing path: ");
   printInfoString(t.arg4(), gs.log, s.traceePid, t, " to path: ");
+  if ((t.arg5() & RENAME_EXCHANGE) == 0) {
+    markLastLink(gs, s, t, t.arg4(), t.arg3(), t.arg2(), t.arg1());
+  } else {
+    // Both files keep a name.
+    s.inodeToDelete = -1;
+  }
   return true;
 }
 
 void renameat2SystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // nothing to do, but return value may be useful for debugging (printed by
-  // handlePostSystemCall)
+  eraseMarkedInode(gs, s, t);
 }
 // =======================================================================================
 bool rmdirSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg1(), gs.log, s.traceePid, t);
+  markLastLink(gs, s, t, t.arg1(), AT_FDCWD);
   return true;
 }
 
 void rmdirSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // nothing to do, but return value may be useful for debugging (printed by
-  // handlePostSystemCall)
+  eraseMarkedInode(gs, s, t);
 }
 
 bool rt_sigprocmaskSystemCall::handleDetPre(
@@ -1990,8 +1978,8 @@ struct kernel_sigaction {
 };
 bool rt_sigactionSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "rt_sigaction pre-hook for signal " + to_string(t.arg1()) + "\n");
   const uint64_t signum = t.arg1();
   s.requestedSignalToHandle = signum;
@@ -2005,12 +1993,13 @@ bool rt_sigactionSystemCall::handleDetPre(
   struct kernel_sigaction sa = t.readFromTracee(
       traceePtr<struct kernel_sigaction>((struct kernel_sigaction*)t.arg2()),
       t.getPid());
-  gs.log.writeToLog(Importance::info, "struct sigaction*: %p\n", t.arg2());
-  gs.log.writeToLog(
-      Importance::info, "sa_flags: " + to_string(sa.sa_flags) + " " +
-                            to_string(SA_RESETHAND) + " \n");
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(gs.log, Importance::info, "struct sigaction*: %p\n", t.arg2());
+  LOG(
+      gs.log, Importance::info,
+      "sa_flags: " + to_string(sa.sa_flags) + " " + to_string(SA_RESETHAND) +
+          " \n");
+  LOG(
+      gs.log, Importance::info,
       "sa_handler: " + to_string((uint64_t)sa.sa_handler__) + "\n");
 
   if (((unsigned long)SIG_IGN) == sa.sa_handler__) {
@@ -2026,9 +2015,10 @@ bool rt_sigactionSystemCall::handleDetPre(
       s.requestedSignalHandler = SIGHANDLER_CUSTOM;
     }
   }
-  gs.log.writeToLog(
-      Importance::info, "signal " + to_string(signum) + " handler requested: " +
-                            to_string(s.requestedSignalHandler) + "\n");
+  LOG(
+      gs.log, Importance::info,
+      "signal " + to_string(signum) + " handler requested: " +
+          to_string(s.requestedSignalHandler) + "\n");
 
   // run the post-hook to see if signal handler installation was successful
   return true;
@@ -2036,14 +2026,14 @@ bool rt_sigactionSystemCall::handleDetPre(
 
 void rt_sigactionSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "rt_sigaction post-hook\n");
+  LOG(gs.log, Importance::info, "rt_sigaction post-hook\n");
   if (0 == t.getReturnValue()) {
     // signal handler installation was successful
-    s.currentSignalHandlers.get()->insert(
+    s.currentSignalHandlers.write().insert(
         {s.requestedSignalToHandle, s.requestedSignalHandler});
 
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "signal " + to_string(s.requestedSignalToHandle) + " handler of type " +
             to_string(s.requestedSignalHandler) + " installed\n");
 
@@ -2128,11 +2118,11 @@ void rt_sigtimedwaitSystemCall::handleDetPost(
 
   replay = replaySyscallIfBlocked(gs, s, t, sched, EAGAIN);
   if (replay) {
-    gs.log.writeToLog(Importance::info, "replay rt_sigtimedwait\n");
+    LOG(gs.log, Importance::info, "replay rt_sigtimedwait\n");
     t.writeArg3(s.originalArg3);
   } else {
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "rt_sigtimedwait returned: " + to_string(retval) + "\n");
     if (s.syscallInjected) {
       if (retval > 0) {
@@ -2154,7 +2144,7 @@ bool rt_sigsuspendSystemCall::handleDetPre(
   traceePtr<unsigned long> rptr =
       traceePtr<unsigned long>((unsigned long*)t.arg1());
   mask = t.readFromTracee(rptr, t.getPid());
-  gs.log.writeToLog(Importance::info, "rt_sigsuspend, mask = 0x%lx\n", mask);
+  LOG(gs.log, Importance::info, "rt_sigsuspend, mask = 0x%lx\n", mask);
 
   struct PendingSignalInfo info = {
       0,
@@ -2214,8 +2204,8 @@ void sendtoSystemCall::handleDetPost(
 // TODO
 bool sendmsgSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info, "sendmsg to fd " + to_string(t.arg1()) + "\n");
+  LOG(
+      gs.log, Importance::info, "sendmsg to fd " + to_string(t.arg1()) + "\n");
   return true;
 }
 
@@ -2226,8 +2216,8 @@ void sendmsgSystemCall::handleDetPost(
 
 bool sendmmsgSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info, "sendmmsg to fd " + to_string(t.arg1()) + "\n");
+  LOG(
+      gs.log, Importance::info, "sendmmsg to fd " + to_string(t.arg1()) + "\n");
   return true;
 }
 
@@ -2238,8 +2228,8 @@ void sendmmsgSystemCall::handleDetPost(
 
 bool recvfromSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info, "recvfrom fd " + to_string(t.arg1()) + "\n");
+  LOG(
+      gs.log, Importance::info, "recvfrom fd " + to_string(t.arg1()) + "\n");
   return true;
 }
 
@@ -2362,7 +2352,7 @@ void statfsSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   struct statfs* statfsPtr = (struct statfs*)t.arg2();
   if (statfsPtr == nullptr) {
-    gs.log.writeToLog(Importance::info, "statfs: statbuf null.\n");
+    LOG(gs.log, Importance::info, "statfs: statbuf null.\n");
     return;
   }
 
@@ -2420,10 +2410,9 @@ void symlinkSystemCall::handleDetPost(
   if (t.getReturnValue() == 0 && (char*)t.arg2() != nullptr) {
     string linkpath =
         t.readTraceeCString(traceePtr<char>((char*)t.arg2()), s.traceePid);
-    auto inode = inode_from_tracee(linkpath, s.traceePid, gs.log, -1);
+    auto inode = inode_from_tracee(linkpath, gs, s, -1);
     if (inode != -1UL) {
-      gs.mtimeMap[inode] = s.getLogicalTime();
-      gs.inodeMap.addRealValue(inode);
+      gs.inodes.created(inode, s.getLogicalTime());
       s.incrementTime();
     }
   }
@@ -2442,10 +2431,9 @@ void symlinkatSystemCall::handleDetPost(
   if (t.getReturnValue() == 0 && (char*)t.arg3() != nullptr) {
     string linkpath =
         t.readTraceeCString(traceePtr<char>((char*)t.arg3()), s.traceePid);
-    auto inode = inode_from_tracee(linkpath, s.traceePid, gs.log, t.arg2());
+    auto inode = inode_from_tracee(linkpath, gs, s, t.arg2());
     if (inode != -1UL) {
-      gs.mtimeMap[inode] = s.getLogicalTime();
-      gs.inodeMap.addRealValue(inode);
+      gs.inodes.created(inode, s.getLogicalTime());
       s.incrementTime();
     }
   }
@@ -2462,10 +2450,9 @@ void mknodSystemCall::handleDetPost(
   if (t.getReturnValue() == 0 && (char*)t.arg1() != nullptr) {
     string path =
         t.readTraceeCString(traceePtr<char>((char*)t.arg1()), s.traceePid);
-    auto inode = inode_from_tracee(path, s.traceePid, gs.log, -1);
+    auto inode = inode_from_tracee(path, gs, s, -1);
     if (inode != -1UL) {
-      gs.mtimeMap[inode] = s.getLogicalTime();
-      gs.inodeMap.addRealValue(inode);
+      gs.inodes.created(inode, s.getLogicalTime());
       s.incrementTime();
     }
   }
@@ -2482,10 +2469,9 @@ void mknodatSystemCall::handleDetPost(
   if (t.getReturnValue() == 0 && (char*)t.arg2() != nullptr) {
     string path =
         t.readTraceeCString(traceePtr<char>((char*)t.arg2()), s.traceePid);
-    auto inode = inode_from_tracee(path, s.traceePid, gs.log, t.arg1());
+    auto inode = inode_from_tracee(path, gs, s, t.arg1());
     if (inode != -1UL) {
-      gs.mtimeMap[inode] = s.getLogicalTime();
-      gs.inodeMap.addRealValue(inode);
+      gs.inodes.created(inode, s.getLogicalTime());
       s.incrementTime();
     }
   }
@@ -2496,16 +2482,17 @@ bool tgkillSystemCall::handleDetPre(
   int tgid = (int)t.arg1();
   int tid = (int)t.arg2();
   int signal = (int)t.arg3();
-  gs.log.writeToLog(
-      Importance::info, "tgkill(tgid = %d, tid = %d, signal = %d)\n", tgid, tid,
+  LOG(
+      gs.log, Importance::info,
+      "tgkill(tgid = %d, tid = %d, signal = %d)\n", tgid, tid,
       signal);
 
   if (signal == SIGABRT && tgid == s.traceePid &&
       tgid == tid /* TODO: when we support threads, we should also compare against tracee's tid (from gettid) */) {
     // ok
   } else {
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "tgkillSystemCall::handleDetPre: tracee vtgid=" + to_string(tgid) +
             " vtid=" + to_string(tid) + " ptgid=" + to_string(s.traceePid) +
             " trying to send unsupported signal=" + to_string(signal));
@@ -2535,8 +2522,8 @@ long seconds_passed = 0;
 void timeSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   if (s.noopSystemCall) {
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "NOOP system call (getpid) setting return value to 0\n");
     s.noopSystemCall = false;
     // pretend like the system call (that we replaced) has succeeded
@@ -2554,8 +2541,9 @@ void timeSystemCall::handleDetPost(
     gs.timeCalls++;
     int retVal = t.getReturnValue();
     if (retVal < 0) {
-      gs.log.writeToLog(
-          Importance::info, "Time call failed: \n" + string{strerror(-retVal)});
+      LOG(
+          gs.log, Importance::info,
+          "Time call failed: \n" + string{strerror(-retVal)});
       return;
     }
     
@@ -2639,8 +2627,8 @@ void timeSystemCall::handleDetPost(
     // DetTrace stuff before I added my own
     /*
     time_t secs_since_epoch = logical_clock::to_time_t(s.getLogicalTime());
-    gs.log.writeToLog(
-        Importance::info, "time: tloc is null, returning %d\n",
+    LOG(
+        gs.log, Importance::info, "time: tloc is null, returning %d\n",
         secs_since_epoch);
     t.writeRax(secs_since_epoch);
     if (timePtr != nullptr) {
@@ -2663,7 +2651,7 @@ void timeSystemCall::handleDetPost(
 // =======================================================================================
 bool timer_createSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "timer_create syscall pre-hook\n");
+  LOG(gs.log, Importance::info, "timer_create syscall pre-hook\n");
 
   // we support any clockid, but only notification via certain signals
   // delivered to the process
@@ -2712,14 +2700,15 @@ bool timer_createSystemCall::handleDetPre(
     ti.signalHandlerData = ti.sendSignal ? se.sigev_value.sival_ptr : nullptr;
   }
 
-  timerID_t timerid = s.timerCreateTimers.get()->size() + 11000;
-  s.timerCreateTimers.get()->insert({timerid, ti});
+  timerID_t timerid = s.timerCreateTimers->size() + 11000;
+  s.timerCreateTimers.write().insert({timerid, ti});
 
-  gs.log.writeToLog(
-      Importance::info, "created new timer " + to_string(timerid) + "\n");
+  LOG(
+      gs.log, Importance::info,
+      "created new timer " + to_string(timerid) + "\n");
 
   // write timerid into tracee memory
-  gs.log.writeToLog(Importance::info, "writing timerid to %p\n", t.arg3());
+  LOG(gs.log, Importance::info, "writing timerid to %p\n", t.arg3());
   t.writeToTracee(
       traceePtr<uint64_t>((uint64_t*)t.arg3()), timerid, s.traceePid);
 
@@ -2740,11 +2729,11 @@ void timer_createSystemCall::handleDetPost(
 bool timer_deleteSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   timerID_t timerid = t.arg1();
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "timer_delete pre-hook for timer " + to_string(timerid) + "\n");
 
-  if (!s.timerCreateTimers.get()->count(timerid)) {
+  if (!s.timerCreateTimers->count(timerid)) {
     runtimeError("invalid timerid " + to_string(timerid));
   }
   return true;
@@ -2758,10 +2747,10 @@ void timer_deleteSystemCall::handleDetPost(
 bool timer_getoverrunSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   timerID_t timerid = t.arg1();
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "timer_getoverrun pre-hook for timer " + to_string(timerid) + "\n");
-  if (!s.timerCreateTimers.get()->count(timerid)) {
+  if (!s.timerCreateTimers->count(timerid)) {
     runtimeError("invalid timerid " + to_string(timerid));
   }
   return true;
@@ -2776,11 +2765,11 @@ void timer_getoverrunSystemCall::handleDetPost(
 bool timer_gettimeSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   timerID_t timerid = t.arg1();
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "timer_gettime pre-hook for timer " + to_string(timerid) + "\n");
 
-  if (!s.timerCreateTimers.get()->count(timerid)) {
+  if (!s.timerCreateTimers->count(timerid)) {
     runtimeError("invalid timerid " + to_string(timerid));
   }
 
@@ -2809,17 +2798,17 @@ void timer_gettimeSystemCall::handleDetPost(
 // =======================================================================================
 bool timer_settimeSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "timer_settime pre-hook for timer " + to_string(t.arg1()) + "\n");
 
   timerID_t timerid = t.arg1();
 
-  if (!s.timerCreateTimers.get()->count(timerid)) {
+  if (!s.timerCreateTimers->count(timerid)) {
     runtimeError("invalid timerid " + to_string(timerid));
   }
 
-  timerInfo tinfo = s.timerCreateTimers.get()->at(timerid);
+  timerInfo tinfo = s.timerCreateTimers->at(timerid);
   if (!tinfo.sendSignal) {
     replaceSystemCallWithNoop(gs, s, t);
     return true; // run getpid post-hook
@@ -2836,7 +2825,7 @@ void timer_settimeSystemCall::handleDetPost(
 // =======================================================================================
 bool getitimerSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "getitimer pre-hook\n");
+  LOG(gs.log, Importance::info, "getitimer pre-hook\n");
 
   struct itimerval* ivp = (struct itimerval*)t.arg2();
   if (ivp != nullptr) {
@@ -2862,7 +2851,7 @@ void getitimerSystemCall::handleDetPost(
 // =======================================================================================
 bool setitimerSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "setitimer pre-hook\n");
+  LOG(gs.log, Importance::info, "setitimer pre-hook\n");
 
   int whichTimer = t.arg1();
   auto value = t.readFromTracee(traceePtr<struct itimerspec>((struct itimerspec*)t.arg2()), s.traceePid);
@@ -2888,7 +2877,7 @@ void setitimerSystemCall::handleDetPost(
 
 bool timerfd_createSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "timerfd_create syscall pre-hook\n");
+  LOG(gs.log, Importance::info, "timerfd_create syscall pre-hook\n");
 
   int flags = t.arg2();
   s.originalArg2 = (unsigned long)flags;
@@ -2908,13 +2897,12 @@ void timerfd_createSystemCall::handleDetPost(
   t.writeArg2(s.originalArg2);
 
   if (fd >= 0) {
-    struct itimerspec it = {
-        {0, 0},
-        {0, 0},
-    };
-    s.timerfds->insert({fd, it});
-    gs.log.writeToLog(
-        Importance::info, "timerfd_create(%d, %d) = %d\n", clockid, flags, fd);
+    FdInfo& info = s.editFdInfo(fd);
+    info.kind = fdKind::timerfd;
+    info.timer = make_shared<struct itimerspec>();
+    LOG(
+        gs.log, Importance::info,
+        "timerfd_create(%d, %d) = %d\n", clockid, flags, fd);
   }
 }
 
@@ -2924,7 +2912,9 @@ bool timerfd_settimeSystemCall::handleDetPre(
   struct itimerspec* spec = (itimerspec*)s.mmapMemory.getAddr().ptr;
   auto value = t.readFromTracee(
       traceePtr<struct itimerspec>((struct itimerspec*)t.arg3()), s.traceePid);
-  (*s.timerfds)[fd] = value;
+  if (s.fd_is_timerfd(fd)) {
+    *s.fdInfo(fd).timer = value;
+  }
   struct itimerspec timer = {
       {0, 0},
       {0, 0},
@@ -2949,16 +2939,15 @@ void timerfd_settimeSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int fd = t.arg1();
   int retval = t.getReturnValue();
-  gs.log.writeToLog(Importance::info, "timerfd_setttime returned %d\n", retval);
+  LOG(gs.log, Importance::info, "timerfd_setttime returned %d\n", retval);
   t.writeArg3(s.originalArg3);
 
   // restore old_value.
   if (retval == 0 && t.arg4() != 0) {
-    auto it = s.timerfds->find(fd);
-    if (it != s.timerfds->end()) {
+    if (s.fd_is_timerfd(fd)) {
       t.writeToTracee(
           traceePtr<struct itimerspec>((struct itimerspec*)t.arg4()),
-          it->second, s.traceePid);
+          *s.fdInfo(fd).timer, s.traceePid);
     }
   }
 }
@@ -2974,9 +2963,8 @@ void timerfd_gettimeSystemCall::handleDetPost(
   int retval = t.getReturnValue();
   if (retval == 0 && t.arg2() != 0) {
     auto rptr = traceePtr<struct itimerspec>((struct itimerspec*)t.arg2());
-    auto it = s.timerfds->find(fd);
-    if (it != s.timerfds->end()) {
-      auto timer = it->second;
+    if (s.fd_is_timerfd(fd)) {
+      auto timer = *s.fdInfo(fd).timer;
       if (timer.it_value.tv_sec != 0 || timer.it_value.tv_nsec != 0) {
         // timer is active.
         // cannot be 0 otherwise timer is disarmed.
@@ -3058,27 +3046,25 @@ void unameSystemCall::handleDetPost(
 bool unlinkSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg1(), gs.log, s.traceePid, t);
+  markLastLink(gs, s, t, t.arg1(), AT_FDCWD);
   return true;
 }
 
 void unlinkSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // nothing to do, but return value may be useful for debugging (printed by
-  // handlePostSystemCall)
-  return;
+  eraseMarkedInode(gs, s, t);
 }
 // =======================================================================================
 bool unlinkatSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   printInfoString(t.arg2(), gs.log, s.traceePid, t);
+  markLastLink(gs, s, t, t.arg2(), t.arg1());
   return true;
 }
 
 void unlinkatSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  // nothing to do, but return value may be useful for debugging (printed by
-  // handlePostSystemCall)
-  return;
+  eraseMarkedInode(gs, s, t);
 }
 
 // =======================================================================================
@@ -3173,8 +3159,8 @@ bool utimensatSystemCall::handleDetPre(
       readVmTraceeRaw(
           traceePtr<struct timespec>((struct timespec*)origTimespec), times,
           sizeof(times), s.traceePid);
-      gs.log.writeToLog(
-          Importance::info,
+      LOG(
+          gs.log, Importance::info,
           "atime.tv_sec:%lu atime.tv_nsec:%ld mtime.tv_sec:%lu "
           "mtime.tv_nsec:%ld \n",
           times[0].tv_sec, times[0].tv_nsec, times[1].tv_sec, times[1].tv_nsec);
@@ -3235,8 +3221,8 @@ void futimesatSystemCall::handleDetPost(
 // =======================================================================================
 bool writeSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "File descriptor: %d\n", t.arg1());
-  gs.log.writeToLog(Importance::info, "Bytes to write %d\n", t.arg3());
+  LOG(gs.log, Importance::info, "File descriptor: %d\n", t.arg1());
+  LOG(gs.log, Importance::info, "Bytes to write %d\n", t.arg3());
 
   return true;
 }
@@ -3248,7 +3234,7 @@ void writeSystemCall::handleDetPost(
 
   auto resetState = [&]() {
     // Nothing left to write.
-    gs.log.writeToLog(Importance::info, "All bytes written.\n");
+    LOG(gs.log, Importance::info, "All bytes written.\n");
     t.setReturnRegister(s.totalBytes);
 
     t.writeArg2(s.beforeRetry.rsi);
@@ -3259,10 +3245,9 @@ void writeSystemCall::handleDetPost(
   };
 
   // Pipe exists in our map and it's set to non blocking.
-  if (s.countFdStatus(fd) != 0 &&
-      s.getFdStatus(fd) == descriptorType::nonBlocking) {
-    gs.log.writeToLog(
-        Importance::info, "write found with non-blocking pipe!\n");
+  if (s.fd_is_nonblocking(fd)) {
+    LOG(
+        gs.log, Importance::info, "write found with non-blocking pipe!\n");
     int retval = t.getReturnValue();
     // for non-blocking io, if it returns -EAGAIN on the 1st try, let it through
     // if it returns -EAGAIN after the retry logic, return bytes already
@@ -3289,11 +3274,11 @@ void writeSystemCall::handleDetPost(
   }
 
   size_t bytes_written = t.getReturnValue();
-  gs.log.writeToLog(Importance::info, "bytesWritten: %d.\n", bytes_written);
+  LOG(gs.log, Importance::info, "bytesWritten: %d.\n", bytes_written);
 
   if ((int)bytes_written < 0) {
-    gs.log.writeToLog(
-        Importance::info, "Returned negative: %d.\n", bytes_written);
+    LOG(
+        gs.log, Importance::info, "Returned negative: %d.\n", bytes_written);
     return;
   }
 
@@ -3302,9 +3287,9 @@ void writeSystemCall::handleDetPost(
     s.firstTrySystemcall = false;
     s.beforeRetry = t.getRegs();
   }
-  gs.log.writeToLog(Importance::info, "total bytes: %d.\n", bytes_written);
-  gs.log.writeToLog(
-      Importance::info, "before retry rdx: %d.\n", s.beforeRetry.rdx);
+  LOG(gs.log, Importance::info, "total bytes: %d.\n", bytes_written);
+  LOG(
+      gs.log, Importance::info, "before retry rdx: %d.\n", s.beforeRetry.rdx);
 
   // Finally wrote all bytes user wanted.
 
@@ -3314,8 +3299,9 @@ void writeSystemCall::handleDetPost(
   if (s.totalBytes == s.beforeRetry.rdx || bytes_written == 0) {
     resetState();
   } else {
-    gs.log.writeToLog(
-        Importance::info, "Not all bytes written: Replaying system call!\n");
+    LOG(
+        gs.log, Importance::info,
+        "Not all bytes written: Replaying system call!\n");
     t.writeArg2(t.arg2() + bytes_written);
     t.writeArg3(t.arg3() - bytes_written);
     replaySystemCall(gs, t, t.getSystemCallNumber());
@@ -3327,8 +3313,8 @@ void writeSystemCall::handleDetPost(
 bool wait4SystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   s.wait4Blocking = (t.arg3() & WNOHANG) == 0;
-  gs.log.writeToLog(Importance::info, "wait4(%d)\n", (int)t.arg1());
-  gs.log.writeToLog(Importance::info, "Making this a non-blocking wait4\n");
+  LOG(gs.log, Importance::info, "wait4(%d)\n", (int)t.arg1());
+  LOG(gs.log, Importance::info, "Making this a non-blocking wait4\n");
 
   // Make this a non blocking hang!
   s.originalArg3 = t.arg3();
@@ -3338,10 +3324,10 @@ bool wait4SystemCall::handleDetPre(
 void wait4SystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   if (s.wait4Blocking) {
-    gs.log.writeToLog(Importance::info, "Blocking wait4 found\n");
+    LOG(gs.log, Importance::info, "Blocking wait4 found\n");
     replaySyscallIfBlocked(gs, s, t, sched, 0);
   } else {
-    gs.log.writeToLog(Importance::info, "Non-blocking wait4 found\n");
+    LOG(gs.log, Importance::info, "Non-blocking wait4 found\n");
     preemptIfBlocked(gs, s, t, sched, EAGAIN);
   }
   // Reset.
@@ -3353,8 +3339,8 @@ void wait4SystemCall::handleDetPost(
 bool waitidSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   s.wait4Blocking = (t.arg4() & WNOHANG) == 0;
-  gs.log.writeToLog(Importance::info, "waitid(%d)\n", (int)t.arg1());
-  gs.log.writeToLog(Importance::info, "Making this a non-blocking waitid\n");
+  LOG(gs.log, Importance::info, "waitid(%d)\n", (int)t.arg1());
+  LOG(gs.log, Importance::info, "Making this a non-blocking waitid\n");
 
   // Make this a non blocking hang!
   s.originalArg4 = t.arg4();
@@ -3364,10 +3350,10 @@ bool waitidSystemCall::handleDetPre(
 void waitidSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   if (s.wait4Blocking) {
-    gs.log.writeToLog(Importance::info, "Blocking waitid found\n");
+    LOG(gs.log, Importance::info, "Blocking waitid found\n");
     replaySyscallIfBlocked(gs, s, t, sched, 0);
   } else {
-    gs.log.writeToLog(Importance::info, "Non-blocking waitid found\n");
+    LOG(gs.log, Importance::info, "Non-blocking waitid found\n");
     preemptIfBlocked(gs, s, t, sched, EAGAIN);
   }
   // Reset.
@@ -3395,8 +3381,8 @@ bool socketSystemCall::handleDetPre(
 
   if (domain == AF_INET || domain == AF_INET6) {
     if (!gs.allow_network) {
-      gs.log.writeToLog(
-          Importance::inter,
+      LOG(
+          gs.log, Importance::inter,
           "socket syscall disabled, add `--allow-network` to enable socket "
           "syscall\n");
       cancelSystemCall(gs, s, t);
@@ -3418,16 +3404,16 @@ void socketSystemCall::handleDetPost(
   int domain = t.arg1();
   int type = t.arg2();
 
-  if (domain == AF_INET || domain == AF_INET6) {
-    s.remote_sockfds->insert(fd);
-  }
-
+  FdInfo& info = s.editFdInfo(fd);
+  info = FdInfo();
+  info.kind = (domain == AF_INET || domain == AF_INET6) ? fdKind::remoteSocket
+                                                        : fdKind::socket;
   if (type & SOCK_NONBLOCK) {
-    (*s.fdStatus)[fd] = descriptorType::nonBlocking;
+    info.mode = descriptorType::nonBlocking;
   }
 
-  gs.log.writeToLog(
-      Importance::info, "socket returned " + to_string(fd) + "\n");
+  LOG(
+      gs.log, Importance::info, "socket returned " + to_string(fd) + "\n");
 }
 // =======================================================================================
 
@@ -3441,8 +3427,8 @@ void listenSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int retval = (int)t.getReturnValue();
 
-  gs.log.writeToLog(
-      Importance::info, "listen returned " + to_string(retval) + "\n");
+  LOG(
+      gs.log, Importance::info, "listen returned " + to_string(retval) + "\n");
 
   return;
 }
@@ -3455,7 +3441,7 @@ bool acceptSystemCall::handleDetPre(
   t.writeArg4(0);
   replaySystemCall(gs, t, SYS_accept4);
 
-  gs.log.writeToLog(Importance::info, "change syscall accept => accept4\n");
+  LOG(gs.log, Importance::info, "change syscall accept => accept4\n");
   return false;
 }
 
@@ -3516,21 +3502,19 @@ bool accept4SystemCall::handleDetPre(
   int fd = t.arg1();
   int flags = t.arg4();
 
-  gs.log.writeToLog(Importance::info, "accept4(%d), flags = %d\n", fd, flags);
+  LOG(gs.log, Importance::info, "accept4(%d), flags = %d\n", fd, flags);
 
-  auto it = s.fdStatus.get()->find(fd);
-  if (it != s.fdStatus.get()->end()) {
-    if (it->second == descriptorType::nonBlocking) {
-      return true;
-    }
+  if (s.fd_is_nonblocking(fd)) {
+    return true;
   }
 
   int fd_flags = get_proc_fd_flags(t.getPid(), fd);
   /* blocking accept4, simulating nonblocking io */
   s.userDefinedTimeout = true; // XXX: we have no timeout, borrow a variable
   s.originalArg1 = fd_flags;
-  gs.log.writeToLog(
-      Importance::info, "fd %d flags = 0x%x, nonblocking?: %d\n", fd, fd_flags,
+  LOG(
+      gs.log, Importance::info,
+      "fd %d flags = 0x%x, nonblocking?: %d\n", fd, fd_flags,
       (fd_flags & O_NONBLOCK) == O_NONBLOCK);
 
   return true;
@@ -3543,21 +3527,27 @@ void accept4SystemCall::handleDetPost(
   int retval = (int)t.getReturnValue();
 
   if (retval >= 0) {
+    // Connected socket is of the same family as the listening one.
+    fdKind kind = s.fd_is_remote(fd) ? fdKind::remoteSocket : fdKind::socket;
+    FdInfo& info = s.editFdInfo(retval);
+    info = FdInfo();
+    info.kind = kind;
     if ((flags & SOCK_NONBLOCK) == SOCK_NONBLOCK) {
-      (*s.fdStatus.get())[retval] = descriptorType::nonBlocking;
+      info.mode = descriptorType::nonBlocking;
     } else {
-      (*s.fdStatus.get())[retval] = descriptorType::blocking;
+      info.mode = descriptorType::blocking;
     }
-    gs.log.writeToLog(
-        Importance::info, "accept4(%d) returned new fd %d\n", fd, retval);
+    LOG(
+        gs.log, Importance::info,
+        "accept4(%d) returned new fd %d\n", fd, retval);
     return;
   }
 
   if (s.userDefinedTimeout) {
     /* both EAGAIN/EWOULDBLOCK are valid return values for nonblocking mode */
     if (retval == -EAGAIN || retval == -EWOULDBLOCK) {
-      gs.log.writeToLog(
-          Importance::info, "accetp4 would have blocked! Replaying\n");
+      LOG(
+          gs.log, Importance::info, "accetp4 would have blocked! Replaying\n");
       gs.replayDueToBlocking++;
       sched.preemptAndScheduleNext();
       replaySystemCall(gs, t, t.getSystemCallNumber());
@@ -3570,7 +3560,7 @@ void accept4SystemCall::handleDetPost(
 // =======================================================================================
 bool shutdownSystemCall::handleDetPre(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
-  gs.log.writeToLog(Importance::info, "shutdown(%d, %d)\n", t.arg1(), t.arg2());
+  LOG(gs.log, Importance::info, "shutdown(%d, %d)\n", t.arg1(), t.arg2());
 
   return true;
 }
@@ -3579,14 +3569,15 @@ void shutdownSystemCall::handleDetPost(
     globalState& gs, state& s, ptracer& t, scheduler& sched) {
   int retval = (int)t.getReturnValue();
 
-  gs.log.writeToLog(
-      Importance::info, "shutdown returned " + to_string(retval) + "\n");
+  LOG(
+      gs.log, Importance::info,
+      "shutdown returned " + to_string(retval) + "\n");
 
   if (retval == 0) {
     int fd = t.arg1();
     int how = t.arg2();
-    if (how == SHUT_RDWR) {
-      s.remote_sockfds->erase(fd);
+    if (how == SHUT_RDWR && s.fd_is_remote(fd)) {
+      s.editFdInfo(fd).kind = fdKind::socket;
     }
   }
 
@@ -0,0 +1,95 @@
+#include <linux/magic.h>
+
+#include "directoryCache.hpp"
+
+static bool operator<(const struct timespec& a, const struct timespec& b) {
+  return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+static bool operator!=(const struct timespec& a, const struct timespec& b) {
+  return a.tv_sec != b.tv_sec || a.tv_nsec != b.tv_nsec;
+}
+
+/**
+ * Whether directory times on this filesystem change with every entry added
+ * or removed, as we see them. Not so for pseudo filesystems, whose listings
+ * change on their own, nor for network filesystems, whose times come from
+ * another clock.
+ */
+static bool trustedTimes(long filesystemType) {
+  switch (filesystemType) {
+  case PROC_SUPER_MAGIC:
+  case SYSFS_MAGIC:
+  case DEVPTS_SUPER_MAGIC:
+  case CGROUP_SUPER_MAGIC:
+  case CGROUP2_SUPER_MAGIC:
+  case DEBUGFS_MAGIC:
+  case TRACEFS_MAGIC:
+  case NFS_SUPER_MAGIC:
+  case FUSE_SUPER_MAGIC:
+  case (long)CIFS_SUPER_MAGIC:
+  case (long)SMB2_SUPER_MAGIC:
+    return false;
+  default:
+    return true;
+  }
+}
+// =======================================================================================
+directoryCache::directoryCache(size_t maxBytes) : maxBytes(maxBytes) {}
+
+shared_ptr<directoryCache::listing> directoryCache::find(
+    const struct stat& dir) {
+  auto found = index.find(key{dir.st_dev, dir.st_ino});
+  if (found == index.end()) {
+    return nullptr;
+  }
+  auto it = found->second;
+  if (it->mtime != dir.st_mtim || it->ctime != dir.st_ctim) {
+    // Entries were added or removed since, or the inode is another directory.
+    erase(it);
+    return nullptr;
+  }
+  lru.splice(lru.begin(), lru, it);
+  return it->entries;
+}
+
+void directoryCache::insert(
+    const struct stat& dir,
+    long filesystemType,
+    const struct timespec& readStart,
+    shared_ptr<listing> entries) {
+  // The kernel stamps directory changes with the coarse clock. A change in
+  // the same tick as the one dir saw would not change its times, so a
+  // directory changed at readStart or later might be ahead of our stat.
+  if (!(dir.st_ctim < readStart) || !trustedTimes(filesystemType)) {
+    return;
+  }
+  // Sorted once here, readers share it read only. Most directories are far
+  // smaller than the buffer reserved to read them.
+  entries->sort();
+  entries->shrinkToFit();
+  size_t bytes = entries->bufferedBytes();
+  if (bytes > maxBytes) {
+    return;
+  }
+
+  key k{dir.st_dev, dir.st_ino};
+  auto found = index.find(k);
+  if (found != index.end()) {
+    erase(found->second);
+  }
+  lru.push_front(cached{k, dir.st_mtim, dir.st_ctim, move(entries), bytes});
+  index[k] = lru.begin();
+  heldBytes += bytes;
+
+  while (heldBytes > maxBytes) {
+    erase(prev(lru.end()));
+  }
+}
+
+void directoryCache::erase(list<cached>::iterator it) {
+  heldBytes -= it->bytes;
+  index.erase(it->k);
+  lru.erase(it);
+}
+// =======================================================================================
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "eventFingerprint.hpp"
+#include "util.hpp"
+
+eventFingerprint traceFingerprint;
+
+eventFingerprint::~eventFingerprint() {
+  if (out != nullptr) {
+    fclose(out);
+  }
+}
+
+void eventFingerprint::start(const string& path, uint64_t interval) {
+  out = fopen(path.c_str(), "we");
+  if (out == nullptr) {
+    runtimeError("Unable to open fingerprint file " + path);
+  }
+  this->interval = interval;
+  nextCheckpoint = interval;
+  enabled = true;
+}
+
+void eventFingerprint::addBytes(const void* data, size_t length) {
+  if (!enabled) {
+    return;
+  }
+  const uint8_t* bytes = (const uint8_t*)data;
+  mix(length);
+  for (; length >= 8; bytes += 8, length -= 8) {
+    uint64_t word;
+    memcpy(&word, bytes, 8);
+    mix(word);
+  }
+  for (; length > 0; bytes++, length--) {
+    hash ^= *bytes * PRIME5;
+    hash = rotl(hash, 11) * PRIME1;
+  }
+}
+
+uint64_t eventFingerprint::digest() const {
+  uint64_t h = hash;
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+void eventFingerprint::checkpoint(uint64_t systemCalls) {
+  checkpoints++;
+  fprintf(
+      out, "checkpoint %lu systemCalls %lu fingerprint %016lx\n", checkpoints,
+      systemCalls, digest());
+  // So the checkpoints are there even if we crash later.
+  fflush(out);
+  nextCheckpoint = systemCalls + interval;
+}
+
+void eventFingerprint::finish(uint64_t systemCalls) {
+  if (!enabled) {
+    return;
+  }
+  fprintf(
+      out, "final systemCalls %lu fingerprint %016lx\n", systemCalls,
+      digest());
+  fclose(out);
+  out = nullptr;
+  enabled = false;
+}
@@ -10,15 +10,15 @@
 #include "util.hpp"
 #include "vdso.hpp"
 
+#include <sched.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
+#include <fstream>
 #include <stack>
 #include <tuple>
 
 #define MAKE_KERNEL_VERSION(x, y, z) ((x) << 16 | (y) << 8 | (z))
 
-void deleteMultimapEntry(
-    unordered_multimap<pid_t, pid_t>& mymap, pid_t key, pid_t value);
-pid_t eraseChildEntry(multimap<pid_t, pid_t>& map, pid_t process);
 bool kernelCheck(int a, int b, int c);
 void trapCPUID(globalState& gs, state& s, ptracer& t);
 
@@ -54,6 +54,11 @@ execution::execution(
     bool useColor,
     string logFile,
     bool printStatistics,
+    string statisticsJson,
+    string liveStatsPath,
+    string timelinePath,
+    string fingerprintPath,
+    uint64_t fingerprintInterval,
     VDSOSymbol* vdsoFuncs,
     int nbVdsoFuncs,
     unsigned prngSeed,
@@ -62,20 +67,29 @@ execution::execution(
     logical_clock::duration clock_step,
     SysEnter sys_enter_hook,
     SysExit sys_exit_hook,
-    void* user_data)
+    void* user_data,
+    SchedulingPolicy schedulingPolicy,
+    uint64_t logRingRecords,
+    const logFilter& filter)
     : kernelPre4_8{kernelCheck(4, 8, 0)},
-      log{logFile, debugLevel, useColor},
+      log{logFile, debugLevel, useColor, logRingRecords},
       silentLogger{"", 0},
       printStatistics{printStatistics},
+      statisticsJson{statisticsJson},
       // Waits for first process to be ready!
       tracer{startingPid},
       // Create our global state once, share across class.
-      myGlobalState{
-          log,          ValueMapper<ino_t, ino_t>{log, "inode map", 1},
-          ModTimeMap{}, kernelCheck(4, 12, 0),
-          prngSeed,     epoch,
-          allow_network},
-      myScheduler{startingPid, log},
+      myGlobalState{log, kernelCheck(4, 12, 0), prngSeed, epoch, allow_network},
+      myScheduler{startingPid, log,
+                  makeSchedulingPolicy(
+                      schedulingPolicy,
+                      [this](pid_t pid) {
+                        // The starting process is queued before its state
+                        // exists.
+                        state* s = processes.find(pid);
+                        return s == nullptr ? logical_clock::time_point{}
+                                            : s->getLogicalTime();
+                      })},
       debugLevel{debugLevel},
       vdsoFuncs(vdsoFuncs, vdsoFuncs + nbVdsoFuncs),
       epoch(epoch),
@@ -85,10 +99,22 @@ execution::execution(
       sys_exit_hook(sys_exit_hook),
       user_data(user_data) {
   // Set state for first process.
-  states.emplace(
-      startingPid, state{startingPid, debugLevel, epoch, clock_step});
-  myGlobalState.threadGroups.insert({startingPid, startingPid});
-  myGlobalState.threadGroupNumber.insert({startingPid, startingPid});
+  processes.addProcess(
+      startingPid, -1, state{startingPid, debugLevel, epoch, clock_step});
+  myGlobalState.processes = &processes;
+  log.setFilter(filter);
+  if (printStatistics || !statisticsJson.empty()) {
+    myGlobalState.callStats.enableTiming();
+  }
+  if (!liveStatsPath.empty()) {
+    live.reset(new liveStats(liveStatsPath));
+  }
+  if (!timelinePath.empty()) {
+    timeline.reset(new traceTimeline(timelinePath));
+  }
+  if (!fingerprintPath.empty()) {
+    traceFingerprint.start(fingerprintPath, fingerprintInterval);
+  }
 
   // First process is special and we must set the options ourselves.
   // This is done everytime a new process is spawned.
@@ -106,41 +132,29 @@ execution::execution(
 // currentProcess itself has children and got here, this can't happen. A process
 // with live children will never get a nonEventExit.
 bool execution::handleNonEventExit(const pid_t traceesPid) {
-  // We are done. Erase ourselves from our parent's list of children.
-  pid_t parent = eraseChildEntry(processTree, traceesPid);
-  auto tgNumber = myGlobalState.threadGroupNumber.at(traceesPid);
-
-  // Erase tracee from our state.
-  if (states.erase(traceesPid) != 1) {
-    runtimeError("Not such tracee to delete: " + to_string(traceesPid));
+  // Last look at our structures before the last process goes. The inode table
+  // may have been bigger before files were deleted, the periodic samples
+  // catch that peak.
+  if ((printStatistics || !statisticsJson.empty()) &&
+      processes.entryCount() == 1) {
+    memory.sample(myGlobalState, processes, log);
   }
 
-  // if this is a thread, clean up the thread specific state that we save.
-  if (myGlobalState.liveThreads.count(traceesPid) != 0) {
-    if (myGlobalState.liveThreads.erase(traceesPid) != 1) {
-      runtimeError(
-          "Not such thread to delete from liveThreads: " +
-          to_string(traceesPid));
-    }
-    if (myGlobalState.threadGroupNumber.erase(traceesPid) != 1) {
-      runtimeError(
-          "Not such thread to delete from threadGroupNumber: " +
-          to_string(traceesPid));
-    }
+  // We are done. Erase our state, and ourselves from our parent's list of
+  // children and our thread group.
+  pid_t parent = processes.remove(traceesPid);
+  if (timeline != nullptr) {
+    timeline->exited(traceesPid);
   }
 
-  // If thread, we should always be able to delete this entry.
-  // If process, then it should have their own thread group as well.
-  deleteMultimapEntry(myGlobalState.threadGroups, tgNumber, traceesPid);
-
   // Parent has no childrent left, and want's to exit! Schedule for exit as it
   // is no longer in our scheduler's heaps.
   if (parent != -1 && // We have no parent, we're root.
       myScheduler.isFinished(
           parent) && // Check if our parent is marked as finished.
-      processTree.count(parent) == 0) { // Parent has no children left.
-    log.writeToLog(
-        Importance::info,
+      processes.childCount(parent) == 0) { // Parent has no children left.
+    LOG(
+        log, Importance::info,
         "All children of finished parent %d have exited"
         ", scheduling parent for exiting.\n",
         parent);
@@ -161,6 +175,14 @@ bool execution::handleNonEventExit(const pid_t traceesPid) {
   }
 }
 // =======================================================================================
+void execution::setLogContext(const state& currState, int syscallNum) {
+  const uint64_t args[6] = {tracer.arg1(), tracer.arg2(), tracer.arg3(),
+                            tracer.arg4(), tracer.arg5(), tracer.arg6()};
+  log.setContextSystemCall(
+      syscallNum, args, currState.getLogicalTime().time_since_epoch().count(),
+      systemCallsEvents);
+}
+// =======================================================================================
 // Despite what the name will imply, this function is actually called during a
 // ptrace seccomp event. Not a pre-system call event. In newer kernel version
 // there is no need to deal with ptrace pre-system call events. So the only
@@ -172,22 +194,28 @@ bool execution::handlePreSystemCall(state& currState, const pid_t traceesPid) {
     runtimeError("Unkown system call number: " + to_string(syscallNum));
   }
 
+  if (log.wantsContext()) {
+    setLogContext(currState, syscallNum);
+  }
+
   // Print!
-  string systemCall = systemCallMappings[syscallNum];
-  string redColoredSyscall = log.makeTextColored(Color::red, systemCall);
-  log.writeToLog(
-      Importance::inter, "[Pid %d] Intercepted %s\n", traceesPid,
-      redColoredSyscall.c_str());
+  LOG(
+      log, Importance::inter, "[Pid %d] Intercepted %s\n", traceesPid,
+      log.makeTextColored(Color::red, systemCallMappings[syscallNum]).c_str());
   log.setPadding();
 
-  bool callPostHook =
-      callPreHook(syscallNum, myGlobalState, currState, tracer, myScheduler);
-
-  if (sys_enter_hook && syscallNum != SYS_arch_prctl &&
-      !currState.syscallInjected) {
-    rnr::callPreHook(
-        user_data, sys_enter_hook, syscallNum, myGlobalState, currState, tracer,
-        myScheduler);
+  bool callPostHook;
+  {
+    phaseTimer timer(Phase::handler);
+    callPostHook =
+        callPreHook(syscallNum, myGlobalState, currState, tracer, myScheduler);
+
+    if (sys_enter_hook && syscallNum != SYS_arch_prctl &&
+        !currState.syscallInjected) {
+      rnr::callPreHook(
+          user_data, sys_enter_hook, syscallNum, myGlobalState, currState,
+          tracer, myScheduler);
+    }
   }
 
   if (kernelPre4_8) {
@@ -201,7 +229,8 @@ bool execution::handlePreSystemCall(state& currState, const pid_t traceesPid) {
   // See:
   // https://stackoverflow.com/questions/29997244/
   // occasionally-missing-ptrace-event-vfork-when-running-ptrace
-  if (systemCall == "fork" || systemCall == "vfork" || systemCall == "clone") {
+  if (syscallNum == SYS_fork || syscallNum == SYS_vfork ||
+      syscallNum == SYS_clone) {
     processSpawnEvents++;
     int status;
     ptraceEvent e;
@@ -238,48 +267,95 @@ void execution::handlePostSystemCall(state& currState) {
   if (syscallNum < 0 || syscallNum > SYSTEM_CALL_COUNT) {
     runtimeError("Unkown system call number: " + to_string(syscallNum));
   }
+  myGlobalState.callStats.postStop(syscallNum);
+  if (timeline != nullptr) {
+    timeline->systemCall(syscallNum, true);
+  }
 
-  string syscallName = systemCallMappings[syscallNum];
-  log.writeToLog(
-      Importance::info, "Calling post hook for: " + syscallName + "\n");
+  if (log.wantsContext()) {
+    setLogContext(currState, syscallNum);
+    log.setContextReturnValue(tracer.getReturnValue());
+  }
+
+  LOG(
+      log, Importance::info, "Calling post hook for: %s\n",
+      systemCallMappings[syscallNum].c_str());
 
   if (SYS_times == syscallNum || SYS_time == syscallNum) {
     // for syscalls with a nondet return value, print it at Importance::extra
-    log.writeToLog(
-        Importance::extra, "(nondet) Value before handler: %d\n",
+    LOG(
+        log, Importance::extra, "(nondet) Value before handler: %d\n",
         tracer.getReturnValue());
   } else {
-    log.writeToLog(
-        Importance::info, "Value before handler: %d\n",
+    LOG(
+        log, Importance::info, "Value before handler: %d\n",
         tracer.getReturnValue());
   }
 
-  callPostHook(syscallNum, myGlobalState, currState, tracer, myScheduler);
-
-  if (sys_exit_hook && syscallNum != SYS_arch_prctl &&
-      !currState.syscallInjected) {
-    rnr::callPostHook(
-        user_data, sys_exit_hook, syscallNum, myGlobalState, currState, tracer,
-        myScheduler);
+  {
+    phaseTimer timer(Phase::handler);
+    callPostHook(syscallNum, myGlobalState, currState, tracer, myScheduler);
+
+    if (sys_exit_hook && syscallNum != SYS_arch_prctl &&
+        !currState.syscallInjected) {
+      rnr::callPostHook(
+          user_data, sys_exit_hook, syscallNum, myGlobalState, currState,
+          tracer, myScheduler);
+    }
   }
 
-  log.writeToLog(
-      Importance::info, "Value after handler: %d\n", tracer.getReturnValue());
+  if (log.wantsContext()) {
+    log.setContextReturnValue(tracer.getReturnValue());
+  }
+  traceFingerprint.add(tracer.getReturnValue());
+  LOG(
+      log, Importance::info,
+      "Value after handler: %d\n", tracer.getReturnValue());
 
   log.unsetPadding();
   return;
 }
 
 // =======================================================================================
+static const char* ptraceEventName(ptraceEvent event) {
+  switch (event) {
+  case ptraceEvent::syscall:
+    return "post system call";
+  case ptraceEvent::nonEventExit:
+    return "exited";
+  case ptraceEvent::eventExit:
+    return "exiting";
+  case ptraceEvent::signal:
+    return "signal";
+  case ptraceEvent::exec:
+    return "exec";
+  case ptraceEvent::clone:
+    return "clone";
+  case ptraceEvent::fork:
+    return "fork";
+  case ptraceEvent::vfork:
+    return "vfork";
+  case ptraceEvent::terminatedBySignal:
+    return "terminated by signal";
+  case ptraceEvent::seccomp:
+    return "seccomp";
+  }
+  return "unknown";
+}
+
 int execution::runProgram() {
   // When using seccomp, we run with PTRACE_CONT, but seccomp only reports
   // pre-hook events. To get post hook events we must call ptrace with
   // PTRACE_SYSCALL intead. This happens in @getNextEvent.
 
-  log.writeToLog(Importance::inter, "dettrace starting up\n");
+  LOG(log, Importance::inter, "dettrace starting up\n");
+  if (printStatistics || !statisticsJson.empty()) {
+    tracerProfile.start();
+  }
 
   // Once all process' have ended. We exit.
   bool exitLoop = false;
+  uint64_t events = 0;
 
   // Iterate over entire process' and all subprocess' execution.
   while (!exitLoop) {
@@ -287,15 +363,44 @@ int execution::runProgram() {
     pid_t traceesPid;
     ptraceEvent ret;
 
+    traceFingerprint.checkpointIfDue(systemCallsEvents);
     pid_t nextPid = myScheduler.getNext();
-    bool post = states.at(nextPid).callPostHook;
+    if ((printStatistics || !statisticsJson.empty()) &&
+        ++events % memoryAccounting::SAMPLE_EVENTS == 0) {
+      memory.sample(myGlobalState, processes, log);
+    }
+    if (live != nullptr) {
+      live->update(
+          nextPid, systemCallsEvents, myGlobalState.totalReplays, rdtscEvents,
+          rdtscpEvents, processSpawnEvents, myScheduler.runnableCount(),
+          myScheduler.blockedCount());
+    }
+    if (timeline != nullptr) {
+      timeline->handled(myScheduler.isBlocked(timeline->stoppedProcess()));
+      timeline->resumed(nextPid);
+    }
+    bool post = processes.at(nextPid).callPostHook;
     tie(ret, traceesPid, status) = getNextEvent(nextPid, post);
+    traceFingerprint.add((uint64_t)ret << 32 | (uint32_t)traceesPid);
+    if (timeline != nullptr) {
+      timeline->stopped(traceesPid, ptraceEventName(ret));
+    }
+    log.setContextPid(traceesPid);
+    if (log.wantsContext()) {
+      state* s = processes.find(traceesPid);
+      if (s != nullptr) {
+        log.setContextProcess(
+            s->executable, s->getLogicalTime().time_since_epoch().count());
+      }
+    }
 
     // Most common event. We handle the pre-hook for system calls here.
     if (ret == ptraceEvent::seccomp) {
-      log.writeToLog(Importance::extra, "Is seccomp event!\n");
+      LOG(log, Importance::extra, "Is seccomp event!\n");
       systemCallsEvents++;
-      states.at(traceesPid).callPostHook = handleSeccomp(traceesPid);
+      uint64_t start = myGlobalState.callStats.startTimer();
+      processes.at(traceesPid).callPostHook = handleSeccomp(traceesPid);
+      myGlobalState.callStats.endPreStop(start);
       continue;
     }
 
@@ -307,20 +412,22 @@ int execution::runProgram() {
       // seccomp event. I chose to always handle the pre-system call on the
       // ptracer seccomp event. So we skip the pre-system call event here on
       // older kernels.
-      state& currentState = states.at(traceesPid);
+      state& currentState = processes.at(traceesPid);
 
       // old-kernel-only ptrace system call event for pre exit hook.
       if (kernelPre4_8 && currentState.onPreExitEvent) {
-        states.at(traceesPid).callPostHook = true;
+        processes.at(traceesPid).callPostHook = true;
         currentState.onPreExitEvent = false;
       } else {
         // Only count here due to comment above (we see this event twice in
         // older kernels).
         systemCallsEvents++;
+        uint64_t start = myGlobalState.callStats.startTimer();
         tracer.updateState(traceesPid);
         handlePostSystemCall(currentState);
+        myGlobalState.callStats.endPostStop(start);
         // set callPostHook to default value for next iteration.
-        states.at(traceesPid).callPostHook = false;
+        processes.at(traceesPid).callPostHook = false;
       }
 
       continue;
@@ -328,9 +435,11 @@ int execution::runProgram() {
 
     // Current process was ended by signal.
     if (ret == ptraceEvent::terminatedBySignal) {
-      auto msg = log.makeTextColored(
-          Color::blue, "Process [%d] ended by signal %d.\n");
-      log.writeToLog(Importance::inter, msg, traceesPid, WTERMSIG(status));
+      LOG(
+          log, Importance::inter,
+          log.makeTextColored(
+              Color::blue, "Process [%d] ended by signal %d.\n"),
+          traceesPid, WTERMSIG(status));
       exitLoop = handleNonEventExit(traceesPid);
       continue;
     }
@@ -354,11 +463,11 @@ int execution::runProgram() {
           Color::blue,
           "Process [%d] has finished. "
           "With ptraceEventExit, exit_code: %d.");
-      log.writeToLog(Importance::inter, msg, traceesPid, exit_code);
-      states.at(traceesPid).callPostHook = false;
+      LOG(log, Importance::inter, msg, traceesPid, exit_code);
+      processes.at(traceesPid).callPostHook = false;
 
-      bool isExitGroup = states.at(traceesPid).isExitGroup;
-      pid_t threadGroup = myGlobalState.threadGroupNumber.at(traceesPid);
+      bool isExitGroup = processes.at(traceesPid).isExitGroup;
+      pid_t threadGroup = processes.threadGroupOf(traceesPid);
 
       // there is two reasons this is necessary
       // 1) case where a thread called exit group: this process goes on to
@@ -368,45 +477,34 @@ int execution::runProgram() {
       // group, it will do the same as #1. Only when we have a non-main thread
       // call exit group, do we not need to set this flag, and that's only
       // because this flag is per process/thread!
-      states.at(traceesPid).isExitGroup = false;
+      processes.at(traceesPid).isExitGroup = false;
       // We state that the main process in a thread group was killed by an exit
       // group, this way, the main process ever stops responding, we know why.
       // This is needed as this process may get stuck in getNextEvent
-      // otherwise... states.at(threadGroup).killedByExitGroup = true;
+      // otherwise... processes.at(threadGroup).killedByExitGroup = true;
 
       // Iterate through all threads in this exit group exiting them.
       // Only go in here for exit groups where there is threads. By default,
       // there is at least 1 (the process)
-      log.writeToLog(
-          Importance::info, "thread group #%d\n",
-          myGlobalState.threadGroups.count(threadGroup));
+      LOG(
+          log, Importance::info, "thread group #%d\n",
+          processes.threadGroupSize(threadGroup));
 
-      if (isExitGroup && myGlobalState.threadGroups.count(threadGroup) != 1) {
+      if (isExitGroup && processes.threadGroupSize(threadGroup) != 1) {
         auto msg =
             "Caught exit group! Ending all thread in our process group %d.\n";
-        log.writeToLog(Importance::info, msg, threadGroup);
+        LOG(log, Importance::info, msg, threadGroup);
 
         // Mark as finished so that handleNonEventExit function takes care of
         // eventually deleting parent process.
         myScheduler.markFinishedAndScheduleNext(threadGroup);
 
-        // Make a copy to avoid deleting entries in original (done in
-        // handleTraceeExit) while iterating through it.
-        auto copyThreadGroups = myGlobalState.threadGroups;
-        auto iterpair = copyThreadGroups.equal_range(threadGroup);
-        auto it = iterpair.first;
-
-        for (; it != iterpair.second; ++it) {
-          pid_t thread = it->second;
-
-          if (threadGroup == thread) {
-            // This is not a thread! This is the thread group leader (process),
-            // skip.
-            continue;
-          }
-
+        // handleNonEventExit removes each thread from the group, so we keep
+        // taking one until only the thread group leader (process) is left.
+        pid_t thread;
+        while ((thread = processes.anyThreadOf(threadGroup)) != -1) {
           auto msg = "Manually exiting thread %d after exit_group.\n";
-          log.writeToLog(Importance::info, msg, thread);
+          LOG(log, Importance::info, msg, thread);
 
           ptraceEvent event;
           int ret = ptrace(PTRACE_CONT, thread, 0, 0);
@@ -437,7 +535,7 @@ int execution::runProgram() {
       }
 
       // We have children still, we cannot exit.
-      if (processTree.count(traceesPid) != 0) {
+      if (processes.childCount(traceesPid) != 0) {
         myScheduler.markFinishedAndScheduleNext(traceesPid);
       } else {
         // We have no more children, nothing stops us from exiting, we continue
@@ -448,7 +546,7 @@ int execution::runProgram() {
 
     // Current process is finally truly done (unlike eventExit).
     if (ret == ptraceEvent::nonEventExit) {
-      if (states.at(traceesPid).isExitGroup) {
+      if (processes.at(traceesPid).isExitGroup) {
         // never seen this, don't know how to handle.
         runtimeError(
             "We should not see nonEventExit from a exitGroup event.\n");
@@ -458,10 +556,10 @@ int execution::runProgram() {
           Color::blue,
           "Process [%d] has finished. "
           "With ptraceNonEventExit.\n");
-      log.writeToLog(Importance::inter, msg, traceesPid);
+      LOG(log, Importance::inter, msg, traceesPid);
 
-      states.at(traceesPid).callPostHook = false;
-      if (processTree.count(traceesPid) != 0) {
+      processes.at(traceesPid).callPostHook = false;
+      if (processes.childCount(traceesPid) != 0) {
         runtimeError(
             "We receieved a nonEventExit with children left."
             "This should be impossible!");
@@ -503,23 +601,23 @@ int execution::runProgram() {
             to_string(syscallNumber));
       }
 
-      log.writeToLog(
-          Importance::inter,
+      LOG(
+          log, Importance::inter,
           log.makeTextColored(Color::blue, "[%d] caught %s event!\n"),
           traceesPid, msg.c_str());
 
       handleForkEvent(traceesPid, isThread);
-      states.at(traceesPid).callPostHook = false;
+      processes.at(traceesPid).callPostHook = false;
       continue;
     }
 
     if (ret == ptraceEvent::exec) {
-      log.writeToLog(
-          Importance::inter,
+      LOG(
+          log, Importance::inter,
           log.makeTextColored(Color::blue, "[%d] Caught execve event!\n"),
           traceesPid);
       // reset CPUID trap flag
-      states.at(traceesPid).CPUIDTrapSet = false;
+      processes.at(traceesPid).CPUIDTrapSet = false;
 
       handleExecEvent(traceesPid);
       continue;
@@ -536,108 +634,177 @@ int execution::runProgram() {
         " Uknown return value for ptracer::getNextEvent()\n");
   }
 
-  auto msg = log.makeTextColored(
-      Color::blue, "All processes done. Finished successfully!\n");
-  log.writeToLog(Importance::info, msg);
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(
+          Color::blue, "All processes done. Finished successfully!\n"));
+  tracerProfile.stop();
+  if (live != nullptr) {
+    live->finish();
+  }
+  // Complete the timeline file now, our caller may exit() without destroying
+  // us.
+  timeline.reset();
+  bool fingerprinted = traceFingerprint.running();
+  traceFingerprint.finish(systemCallsEvents);
+  // Statistics go to stderr, which may be where the log goes too. Our caller
+  // also closes every fd once we return.
+  log.flush();
+
+  if (printStatistics || !statisticsJson.empty()) {
+    vector<statistic> stats = {
+        {"System Call Events: ", "systemCallEvents", systemCallsEvents},
+        {"rdtsc instructions: ", "rdtscInstructions", rdtscEvents},
+        {"rdtscp instructions: ", "rdtscpInstructions", rdtscpEvents},
+        {"read retries: ", "readRetries", myGlobalState.readRetryEvents},
+        {"write retries: ", "writeRetries", myGlobalState.writeRetryEvents},
+        {"getRandom() calls: ", "getRandomCalls",
+         myGlobalState.getRandomCalls},
+        {"/dev/urandom opens: ", "devUrandomOpens",
+         myGlobalState.devUrandomOpens},
+        {"/dev/random opens: ", "devRandomOpens", myGlobalState.devRandomOpens},
+        {"Time Related Sytem Calls: ", "timeSystemCalls",
+         myGlobalState.timeCalls},
+        {"Process spawn events: ", "processSpawnEvents", processSpawnEvents},
+        {"Calls for scheduling next process: ", "scheduleNextProcessCalls",
+         myScheduler.callsToScheduleNextProcess},
+        {"Scheduler preemptions: ", "schedulerPreemptions",
+         myScheduler.preemptions},
+        {"Scheduler queue swaps: ", "schedulerQueueSwaps",
+         myScheduler.queueSwaps},
+        {"Scheduler context switches: ", "schedulerContextSwitches",
+         myScheduler.contextSwitches},
+        {"Replays due to blocking system call: ", "blockingReplays",
+         myGlobalState.replayDueToBlocking},
+        {"Total replays: ", "totalReplays", myGlobalState.totalReplays},
+        {"Injected system calls: ", "injectedSystemCalls",
+         myGlobalState.injectedSystemCalls},
+        {"Replay storms: ", "replayStorms", myGlobalState.replayStorms},
+        {"Replay storm backoff skips: ", "replayStormBackoffSkips",
+         myScheduler.backoffSkips},
+        {"ptrace peeks: ", "ptracePeeks", tracer.ptracePeeks},
+        {"process_vm_reads: ", "processVmReads", tracer.readVmCalls},
+        {"process_vm_writes: ", "processVmWrites", tracer.writeVmCalls},
+        {"Log writer stalls: ", "logWriterStalls", log.writerStalls()},
+    };
+    memory.addStatistics(stats);
+    if (fingerprinted) {
+      stats.push_back(
+          {"Event fingerprint: ", "eventFingerprint",
+           traceFingerprint.digest()});
+    }
 
-  if (printStatistics) {
-    auto printStat = [&](string type, uint32_t value) {
+    if (printStatistics) {
       string preStr = "dettrace Statistic. ";
-      cerr << preStr + type + to_string(value) << endl;
-    };
+      cerr << endl;
+      cerr << preStr << "Scheduling policy: " << myScheduler.policyName()
+           << endl;
+      for (auto& stat : stats) {
+        cerr << preStr + stat.label + to_string(stat.value) << endl;
+      }
+      myGlobalState.callStats.printText(cerr);
+      tracerProfile.printText(cerr);
+    }
 
-    cerr << endl;
-    printStat("System Call Events: ", systemCallsEvents);
-    printStat("rdtsc instructions: ", rdtscEvents);
-    printStat("rdtscp instructions: ", rdtscpEvents);
-    printStat("read retries: ", myGlobalState.readRetryEvents);
-    printStat("write retries: ", myGlobalState.writeRetryEvents);
-    printStat("getRandom() calls: ", myGlobalState.getRandomCalls);
-    printStat("/dev/urandom opens: ", myGlobalState.devUrandomOpens);
-    printStat("/dev/random opens: ", myGlobalState.devRandomOpens);
-    printStat("Time Related Sytem Calls: ", myGlobalState.timeCalls);
-    printStat("Process spawn events: ", processSpawnEvents);
-    printStat(
-        "Calls for scheduling next process: ",
-        myScheduler.callsToScheduleNextProcess);
-    printStat(
-        "Replays due to blocking system call: ",
-        myGlobalState.replayDueToBlocking);
-    printStat("Total replays: ", myGlobalState.totalReplays);
-    printStat("ptrace peeks: ", tracer.ptracePeeks);
-    printStat("process_vm_reads: ", tracer.readVmCalls);
-    printStat("process_vm_writes: ", tracer.writeVmCalls);
-  }
-
-  if (!myGlobalState.liveThreads.empty()) {
+    if (!statisticsJson.empty()) {
+      vector<statistic> counters = stats;
+      for (int i = 0; i < PHASE_COUNT; i++) {
+        Phase p = (Phase)i;
+        counters.push_back(
+            {"", string{phaseProfiler::name(p)} + "PhaseNanos",
+             tracerProfile.nanos(p)});
+      }
+      counters.push_back({"", "totalNanos", tracerProfile.totalNanos()});
+
+      ofstream json(statisticsJson);
+      myGlobalState.callStats.writeJson(
+          json, counters, myScheduler.policyName());
+      if (!json) {
+        cerr << "Unable to write statistics to " << statisticsJson << endl;
+      }
+    }
+  }
+
+  if (processes.threadCount() != 0) {
+    // Get the log lines leading up to this out first.
+    log.flush();
     cerr << "Live thread set is not empty! We miss counted the threads "
             "somewhere..."
          << endl;
     exit(1);
   }
 
-  if (!myGlobalState.threadGroups.empty()) {
-    cerr
-        << "threadGroups is not empty! We miss counted the threads somewhere..."
-        << endl;
+  if (!processes.empty()) {
+    log.flush();
+    cerr << "Process table is not empty! We miss counted the threads "
+            "somewhere..."
+         << endl;
     exit(1);
   }
 
   return exit_code;
-  // Add a check for states.empty(). Not adding it now since I don't want a
-  // bunch of packages. to fail over this :b
+}
+// =======================================================================================
+bool execution::sharesFileTable(bool isThread) {
+  // The tracee is stopped in its fork/vfork/clone and tracer holds its
+  // registers. Only clone has flags saying whether the file table is shared;
+  // clone3 is not intercepted, so we never stop in it.
+  if (tracer.getSystemCallNumber() != SYS_clone) {
+    return isThread;
+  }
+  return (tracer.arg1() & CLONE_FILES) != 0;
 }
 // =======================================================================================
 pid_t execution::handleForkEvent(const pid_t traceesPid, bool isThread) {
   processSpawnEvents++;
 
   pid_t newChildPid = ptracer::getEventMessage(traceesPid);
-  auto threadGroup = myGlobalState.threadGroupNumber.at(traceesPid);
+  auto threadGroup = processes.threadGroupOf(traceesPid);
+  if (timeline != nullptr) {
+    timeline->spawned(traceesPid, newChildPid, isThread);
+  }
 
   if (isThread) {
-    myGlobalState.liveThreads.insert(newChildPid);
-    auto msg = log.makeTextColored(
-        Color::blue, "Adding thread %d to thread group %d\n");
-    log.writeToLog(Importance::info, msg, newChildPid, threadGroup);
-
-    // Careful here, the thread group is not necessarily traceesPid, as
-    // traceesPid may be a thread, fetch the actual threadGroup by querying our
-    // (traceesPid) thread group number.
-    myGlobalState.threadGroups.insert({threadGroup, newChildPid});
-    myGlobalState.threadGroupNumber.insert({newChildPid, threadGroup});
+    LOG(
+        log, Importance::info,
+        log.makeTextColored(
+            Color::blue, "Adding thread %d to thread group %d\n"),
+        newChildPid, threadGroup);
   } else {
-    auto msg =
-        log.makeTextColored(Color::blue, "Creating new thread group: %d\n");
-    log.writeToLog(Importance::info, msg, newChildPid);
-
-    // This should not happen! (Pid recycling?)
-    if (myGlobalState.threadGroups.count(newChildPid) != 0) {
-      runtimeError("Thread group already existed.\n");
-    }
-
-    // This is a process it owns it's own process group, create it.
-    myGlobalState.threadGroups.insert({newChildPid, newChildPid});
-    myGlobalState.threadGroupNumber.insert({newChildPid, newChildPid});
+    LOG(
+        log, Importance::info,
+        log.makeTextColored(Color::blue, "Creating new thread group: %d\n"),
+        newChildPid);
   }
 
   // If a thread T1 spawns thread T2, then T1 is NOT the parent of T2. The
   // parent is always the process (the thread group leader) that T1 belongs to.
-  // This is where we add new children to the thread group leader.
-  processTree.insert(make_pair(threadGroup, newChildPid));
-
-  state& parent_state = states.at(traceesPid);
-  // Share fdStatus. Processes get their own, threads share with thread group.
+  // The process table takes care of adding new children to the thread group
+  // leader, and of joining threads to traceesPid's thread group.
+  state& parent_state = processes.at(traceesPid);
+  // Table entries never move, so parent_state stays valid while adding.
+  state* child_state;
   if (isThread) {
-    states.emplace(newChildPid, parent_state.cloned(newChildPid));
+    child_state = &processes.addThread(
+        newChildPid, traceesPid, parent_state.cloned(newChildPid));
   } else {
-    // Deep Copy!
-    states.emplace(newChildPid, parent_state.forked(newChildPid));
+    // Deep Copy! Adding fails if the pid is still in the table (recycling?).
+    child_state = &processes.addProcess(
+        newChildPid, traceesPid, parent_state.forked(newChildPid));
   }
-  // Add this new process to our states.
 
-  log.writeToLog(
-      Importance::info,
-      log.makeTextColored(Color::blue, "Added process [%d] to states map.\n"),
+  // Threads share the file descriptor table, processes get their own. Unless
+  // clone was explicitly asked otherwise.
+  bool shareFiles = sharesFileTable(isThread);
+  if (shareFiles != isThread) {
+    child_state->fds =
+        shareFiles ? parent_state.fds : parent_state.fds.snapshot();
+  }
+
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(
+          Color::blue, "Added process [%d] to process table.\n"),
       newChildPid);
 
   // Let child run instead of the parent, inform scheduler of new process.
@@ -647,22 +814,27 @@ pid_t execution::handleForkEvent(const pid_t traceesPid, bool isThread) {
   // attributes to MAP_PRIVATE. new child's `mmapMemory` hence must be inherited
   // from parent process, to be consistent with fork() semantic.
   // TODO for threads we may not need to do this?!
-  // states.at(newChildPid).mmapMemory.doesExist = true;
-  // states.at(newChildPid).mmapMemory.setAddr(states.at(traceesPid).mmapMemory.getAddr());
+  // processes.at(newChildPid).mmapMemory.doesExist = true;
+  // processes.at(newChildPid).mmapMemory.setAddr(processes.at(traceesPid).mmapMemory.getAddr());
 
   // Wait for child to be ready.
-  log.writeToLog(
-      Importance::info,
+  LOG(
+      log, Importance::info,
       log.makeTextColored(
           Color::blue, "Waiting for child to be ready for tracing...\n"));
   int status;
-  int retPid = doWithCheck(waitpid(newChildPid, &status, 0), "waitpid");
+  int retPid;
+  {
+    phaseTimer timer(Phase::wait);
+    retPid = doWithCheck(waitpid(newChildPid, &status, 0), "waitpid");
+  }
   // This should never happen.
   if (retPid != newChildPid) {
     runtimeError("wait call return pid does not match new child's pid.");
   }
-  log.writeToLog(
-      Importance::info, log.makeTextColored(Color::blue, "Child ready!\n"));
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(Color::blue, "Child ready!\n"));
   return newChildPid;
 }
 
@@ -773,6 +945,40 @@ static unsigned long traceePreinitMmap(pid_t pid, ptracer& t) {
   return ret;
 }
 
+/**
+ * Base name of the binary pid is running, empty if we can't tell.
+ */
+static string executableName(pid_t pid) {
+  phaseTimer timer(Phase::proc);
+  char path[PATH_MAX];
+  string link = "/proc/" + to_string(pid) + "/exe";
+  ssize_t n = readlink(link.c_str(), path, sizeof(path) - 1);
+  if (n == -1) {
+    return "";
+  }
+  path[n] = '\0';
+  const char* slash = strrchr(path, '/');
+  return slash == nullptr ? path : slash + 1;
+}
+
+/**
+ * execve unshares the file descriptor table and closes the descriptors marked
+ * FD_CLOEXEC. The others stay open with what we know about them: a timerfd is
+ * still armed, a directory still part way through its listing.
+ */
+static void forgetClosedOnExec(pid_t pid, state& s) {
+  phaseTimer timer(Phase::proc);
+  s.fds = s.fds.snapshot();
+  string dir = "/proc/" + to_string(pid) + "/fd/";
+  struct stat link;
+  for (size_t fd = 0; fd < s.fds->size(); fd++) {
+    if (s.fdInfo(fd).kind != fdKind::none &&
+        lstat((dir + to_string(fd)).c_str(), &link) == -1) {
+      s.closeFd(fd);
+    }
+  }
+}
+
 void execution::handleExecEvent(pid_t pid) {
   struct user_regs_struct regs;
 
@@ -796,14 +1002,26 @@ void execution::handleExecEvent(pid_t pid) {
   disableVdso(pid);
 
   // TODO When does this ever happen?
-  if (states.find(pid) == states.end()) {
-    states.emplace(pid, state{pid, debugLevel, epoch, clock_step});
+  if (processes.find(pid) == nullptr) {
+    processes.addProcess(pid, -1, state{pid, debugLevel, epoch, clock_step});
+  }
+  forgetClosedOnExec(pid, processes.at(pid));
+  // Only the timeline and log filters look at executables, spare the
+  // readlink otherwise.
+  if (timeline != nullptr || log.wantsExecutables()) {
+    processes.at(pid).executable = executableName(pid);
+  }
+  if (timeline != nullptr) {
+    timeline->exec(pid, processes.at(pid).executable);
+  }
+  if (log.wantsContext()) {
+    log.setContextProcess(
+        processes.at(pid).executable,
+        processes.at(pid).getLogicalTime().time_since_epoch().count());
   }
-  // Reset file descriptor state, it is wiped after execve.
-  states.at(pid).fdStatus = make_shared<unordered_map<int, descriptorType>>();
 
-  states.at(pid).mmapMemory.doesExist = true;
-  states.at(pid).mmapMemory.setAddr(traceePtr<void>((void*)mmapAddr));
+  processes.at(pid).mmapMemory.doesExist = true;
+  processes.at(pid).mmapMemory.setAddr(traceePtr<void>((void*)mmapAddr));
 
   ptracer::doPtrace(PTRACE_POKETEXT, pid, (void*)rip, (void*)saved_insn);
 }
@@ -834,16 +1052,42 @@ bool execution::handleSeccomp(const pid_t traceesPid) {
   // small optimization we might not want to...
   // Get registers from tracee.
   tracer.updateState(traceesPid);
+  myGlobalState.callStats.preStop(tracer.getSystemCallNumber());
+  if (traceFingerprint.running()) {
+    traceFingerprint.add(tracer.getSystemCallNumber());
+    for (uint64_t arg :
+         {tracer.arg1(), tracer.arg2(), tracer.arg3(), tracer.arg4(),
+          tracer.arg5(), tracer.arg6()}) {
+      traceFingerprint.add(arg);
+    }
+  }
+  if (live != nullptr) {
+    live->countSystemCall(tracer.getSystemCallNumber());
+  }
+  if (timeline != nullptr) {
+    timeline->systemCall(tracer.getSystemCallNumber(), false);
+  }
 
   if (myGlobalState.allow_trapCPUID) {
-    if (!states.at(traceesPid).CPUIDTrapSet && !myGlobalState.kernelPre4_12 &&
+    if (!processes.at(traceesPid).CPUIDTrapSet &&
+        !myGlobalState.kernelPre4_12 &&
         NULL == getenv("DETTRACE_NO_CPUID_INTERCEPTION")) {
       // check if CPUID needs to be set, if it does, set trap
-      trapCPUID(myGlobalState, states.at(traceesPid), tracer);
+      trapCPUID(myGlobalState, processes.at(traceesPid), tracer);
     }
   }
 
-  auto callPostHook = handlePreSystemCall(states.at(traceesPid), traceesPid);
+  state& currState = processes.at(traceesPid);
+  if (currState.replayingBlockedSyscall) {
+    // Second try of a system call that would have blocked, not progress.
+    currState.replayingBlockedSyscall = false;
+  } else {
+    myGlobalState.progressEvents++;
+    currState.replaysWithoutProgress = 0;
+    currState.stormLevel = 0;
+  }
+
+  auto callPostHook = handlePreSystemCall(currState, traceesPid);
   return callPostHook;
 }
 
@@ -923,13 +1167,13 @@ void execution::handleSignal(int sigNum, const pid_t traceesPid) {
       tracer.writeIp((uint64_t)tracer.getRip().ptr + ip_step);
 
       // Signal is now suppressed.
-      states.at(traceesPid).signalToDeliver = 0;
-
-      auto coloredMsg = log.makeTextColored(Color::blue, msg);
+      processes.at(traceesPid).signalToDeliver = 0;
 
       // force a preemption to avoid possible busy reading TSCs.
       // myScheduler.preemptAndScheduleNext();
-      log.writeToLog(Importance::inter, coloredMsg, traceesPid, sigNum);
+      LOG(
+          log, Importance::inter, log.makeTextColored(Color::blue, msg),
+          traceesPid, sigNum);
       return;
     } else if ((curr_insn32 << 16) == 0xA20F0000) {
       struct user_regs_struct regs = tracer.getRegs();
@@ -937,16 +1181,15 @@ void execution::handleSignal(int sigNum, const pid_t traceesPid) {
       auto msg =
           "[%d] Tracer: intercepted cpuid instruction at %p. %rax == %p, %rcx "
           "== %p\n";
-      auto coloredMsg = log.makeTextColored(Color::blue, msg);
-      log.writeToLog(
-          Importance::inter, coloredMsg, traceesPid, regs.rip, regs.rax,
-          regs.rcx);
+      LOG(
+          log, Importance::inter, log.makeTextColored(Color::blue, msg),
+          traceesPid, regs.rip, regs.rax, regs.rcx);
 
       // step over cpuid insn
       tracer.writeIp((uint64_t)tracer.getRip().ptr + 2);
 
       // suppress SIGSEGV from reaching the tracee
-      states.at(traceesPid).signalToDeliver = 0;
+      processes.at(traceesPid).signalToDeliver = 0;
 
       // fill in canonical cpuid return values
 
@@ -984,11 +1227,12 @@ void execution::handleSignal(int sigNum, const pid_t traceesPid) {
 
   // Remember to deliver this signal to the tracee for next event! Happens in
   // getNextEvent.
-  states.at(traceesPid).signalToDeliver = sigNum;
+  processes.at(traceesPid).signalToDeliver = sigNum;
 
   auto msg = "[%d] Tracer: Received signal: %d. Forwarding signal to tracee.\n";
-  auto coloredMsg = log.makeTextColored(Color::blue, msg);
-  log.writeToLog(Importance::inter, coloredMsg, traceesPid, sigNum);
+  LOG(
+      log, Importance::inter, log.makeTextColored(Color::blue, msg), traceesPid,
+      sigNum);
   return;
 }
 // =======================================================================================
@@ -1050,6 +1294,9 @@ bool execution::callPreHook(
   case SYS_faccessat:
     return faccessatSystemCall::handleDetPre(gs, s, t, sched);
 
+  case SYS_fchdir:
+    return fchdirSystemCall::handleDetPre(gs, s, t, sched);
+
   case SYS_fgetxattr:
     return fgetxattrSystemCall::handleDetPre(gs, s, t, sched);
 
@@ -1400,6 +1647,9 @@ void execution::callPostHook(
   case SYS_faccessat:
     return faccessatSystemCall::handleDetPost(gs, s, t, sched);
 
+  case SYS_fchdir:
+    return fchdirSystemCall::handleDetPost(gs, s, t, sched);
+
   case SYS_fgetxattr:
     return fgetxattrSystemCall::handleDetPost(gs, s, t, sched);
 
@@ -1696,10 +1946,10 @@ tuple<ptraceEvent, pid_t, int> execution::getNextEvent(
   // @handleSignal
   //
   // 64 bit value to avoid warning when casting to void* below.
-  int64_t signalToDeliver = states.at(pidToContinue).signalToDeliver;
+  int64_t signalToDeliver = processes.at(pidToContinue).signalToDeliver;
 
   // Reset signal field after for next event.
-  states.at(pidToContinue).signalToDeliver = 0;
+  processes.at(pidToContinue).signalToDeliver = 0;
 
   // Usually we use PTRACE_CONT below because we are letting seccomp + bpf
   // handle the events. So unlike standard ptrace, we do not rely on system call
@@ -1708,8 +1958,8 @@ tuple<ptraceEvent, pid_t, int> execution::getNextEvent(
   // we need the system call to be called and then we change it's arguments. So
   // we call PTRACE_SYSCALL instead.
   if (ptraceSystemcall) {
-    log.writeToLog(
-        Importance::extra,
+    LOG(
+        log, Importance::extra,
         "getNextEvent(): Waiting for next system call event.\n");
     struct user_regs_struct regs;
     ptracer::doPtrace(PTRACE_GETREGS, pidToContinue, 0, &regs);
@@ -1719,8 +1969,9 @@ tuple<ptraceEvent, pid_t, int> execution::getNextEvent(
     // for more details, see `Caveats` section of kernel document:
     // https://www.kernel.org/doc/Documentation/prctl/seccomp_filter.txt
     if ((regs.rip & ~0xc00ULL) == 0xFFFFFFFFFF600000ULL) {
-      log.writeToLog(
-          Importance::extra, "getNextEvent(): Looking at VDSO in old glibc.\n");
+      LOG(
+          log, Importance::extra,
+          "getNextEvent(): Looking at VDSO in old glibc.\n");
       int status;
       int syscallNum = regs.orig_rax;
       // vsyscall seccomp stop is a special case
@@ -1738,9 +1989,12 @@ tuple<ptraceEvent, pid_t, int> execution::getNextEvent(
 
       // TODO this assumes we wanted to call the post-hook for this system call,
       // is this always true?
-      callPostHook(
-          syscallNum, myGlobalState, states.at(pidToContinue), tracer,
-          myScheduler);
+      {
+        phaseTimer timer(Phase::handler);
+        callPostHook(
+            syscallNum, myGlobalState, processes.at(pidToContinue), tracer,
+            myScheduler);
+      }
 
       // TODO What's the point of this second updateState call?
       tracer.updateState(pidToContinue);
@@ -1762,8 +2016,8 @@ tuple<ptraceEvent, pid_t, int> execution::getNextEvent(
           "here at syscall!");
     }
   } else {
-    log.writeToLog(
-        Importance::extra, "getNextEvent(): Waiting at ptrace(CONT).\n");
+    LOG(
+        log, Importance::extra, "getNextEvent(): Waiting at ptrace(CONT).\n");
     // Tell the process that we just intercepted an event for to continue, with
     // us tracking it's system calls. If this is the first time this function is
     // called, it will be the starting process. Which we expect to be in a
@@ -1777,9 +2031,12 @@ tuple<ptraceEvent, pid_t, int> execution::getNextEvent(
   }
 
   // Wait for next event to intercept.
-  traceesPid = doWithCheck(waitpid(pidToContinue, &status, 0), "waitpid");
-  log.writeToLog(
-      Importance::extra, "getNextEvent(): Got event from waitpid().\n");
+  {
+    phaseTimer timer(Phase::wait);
+    traceesPid = doWithCheck(waitpid(pidToContinue, &status, 0), "waitpid");
+  }
+  LOG(
+      log, Importance::extra, "getNextEvent(): Got event from waitpid().\n");
 
   return make_tuple(getPtraceEvent(status), traceesPid, status);
 }
@@ -1800,26 +2057,26 @@ ptraceEvent execution::getPtraceEvent(const int status) {
 
   // Check if tracee has exited.
   if (WIFEXITED(status)) {
-    log.writeToLog(Importance::extra, "nonEventExit\n");
+    LOG(log, Importance::extra, "nonEventExit\n");
     exit_code = WEXITSTATUS(status);
     return ptraceEvent::nonEventExit;
   }
 
   // Condition for PTRACE_O_TRACEEXEC
   if (ptracer::isPtraceEvent(status, PTRACE_EVENT_EXEC)) {
-    log.writeToLog(Importance::extra, "exec\n");
+    LOG(log, Importance::extra, "exec\n");
     return ptraceEvent::exec;
   }
 
   // Condition for PTRACE_O_TRACECLONE
   if (ptracer::isPtraceEvent(status, PTRACE_EVENT_CLONE)) {
-    log.writeToLog(Importance::extra, "clone\n");
+    LOG(log, Importance::extra, "clone\n");
     return ptraceEvent::clone;
   }
 
   // Condition for PTRACE_O_TRACEVFORK
   if (ptracer::isPtraceEvent(status, PTRACE_EVENT_VFORK)) {
-    log.writeToLog(Importance::extra, "vfork\n");
+    LOG(log, Importance::extra, "vfork\n");
     return ptraceEvent::vfork;
   }
 
@@ -1827,13 +2084,13 @@ ptraceEvent execution::getPtraceEvent(const int status) {
   // with SIGCHLD, ptrace calls that event a fork *sigh*. Also requires
   // PTRACE_O_FORK flag.
   if (ptracer::isPtraceEvent(status, PTRACE_EVENT_FORK)) {
-    log.writeToLog(Importance::extra, "fork\n");
+    LOG(log, Importance::extra, "fork\n");
     return ptraceEvent::fork;
   }
 
 #ifdef PTRACE_EVENT_STOP
   if (ptracer::isPtraceEvent(status, PTRACE_EVENT_STOP)) {
-    log.writeToLog(Importance::extra, "event stop\n");
+    LOG(log, Importance::extra, "event stop\n");
     runtimeError("Ptrace event stop.\n");
   }
 #endif
@@ -1861,26 +2118,10 @@ ptraceEvent execution::getPtraceEvent(const int status) {
   return ptraceEvent::nonEventExit;
 }
 // =======================================================================================
-/**
- * Find and erase process from map. Returns parent (if any). Otherwise, -1.
- */
-pid_t eraseChildEntry(multimap<pid_t, pid_t>& map, pid_t process) {
-  pid_t parent = -1;
-  for (auto iter = map.begin(); iter != map.end(); iter++) {
-    if (iter->second == process) {
-      parent = iter->first;
-      map.erase(iter);
-      break;
-    }
-  }
-
-  return parent;
-}
-// =======================================================================================
 
 void trapCPUID(globalState& gs, state& s, ptracer& t) {
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "Injecting arch_prctl call to tracee to intercept CPUID!\n");
   // Save current register state to restore after arch_prctl
   s.regSaver.pushRegisterState(t.getRegs());
@@ -1900,26 +2141,12 @@ void trapCPUID(globalState& gs, state& s, ptracer& t) {
   }
 
   gs.totalReplays++;
+  gs.injectedSystemCalls++;
+  gs.callStats.injection();
   // Replay system call!
   t.changeSystemCall(SYS_arch_prctl);
   t.writeIp((uint64_t)t.getRip().ptr - 2);
-  gs.log.writeToLog(Importance::info, "arch_prctl(%d, 0)\n", ARCH_SET_CPUID);
-}
-
-void deleteMultimapEntry(
-    unordered_multimap<pid_t, pid_t>& mymap, pid_t key, pid_t value) {
-  auto iterpair = mymap.equal_range(key);
-  auto it = iterpair.first;
-  for (; it != iterpair.second; ++it) {
-    if (it->second == value) {
-      mymap.erase(it);
-      return;
-    }
-  }
-
-  runtimeError(
-      "Unable to delete entry thread group entry for (" + to_string(key) +
-      ", " + to_string(value) + ")\n");
+  LOG(gs.log, Importance::info, "arch_prctl(%d, 0)\n", ARCH_SET_CPUID);
 }
 
 ptraceEvent execution::handleExitedThread(pid_t currentPid) {
@@ -1932,8 +2159,8 @@ ptraceEvent execution::handleExitedThread(pid_t currentPid) {
   // After that, it seems to respond just fine to a new PTRACE_CONT, which will
   // take us into the ptraceNonEventExit. I don't actually know that this will
   // always work, but emperically this seems to be what's happening.
-  log.writeToLog(
-      Importance::info,
+  LOG(
+      log, Importance::info,
       "No reponse from process, attempting to get exit event from waitpid.\n");
   bool succ;
   ptraceEvent event;
@@ -1941,8 +2168,8 @@ ptraceEvent execution::handleExitedThread(pid_t currentPid) {
 
   if (!succ) {
     // assume we exited correctly.
-    log.writeToLog(
-        Importance::info,
+    LOG(
+        log, Importance::info,
         "Did not hear back from process after first loopOnWaitpid() "
         "assume it is done.\n");
     return ptraceEvent::nonEventExit;
@@ -1963,16 +2190,16 @@ ptraceEvent execution::handleExitedThread(pid_t currentPid) {
       "ptraceNonEventExit.\n");
   tie(succ, event) = loopOnWaitpid(currentPid);
   if (!succ) {
-    log.writeToLog(
-        Importance::info,
+    LOG(
+        log, Importance::info,
         "Did not hear back from process after second loopOnWaitpid() "
         "assume it is done.\n");
     // assume we exited correctly.
     return ptraceEvent::nonEventExit;
   }
 
-  log.writeToLog(
-      Importance::info, "Successfully received all events from thread.\n");
+  LOG(
+      log, Importance::info, "Successfully received all events from thread.\n");
   return event;
 }
 
@@ -1982,19 +2209,24 @@ pair<bool, ptraceEvent> execution::loopOnWaitpid(pid_t currentPid) {
   int status;
 
   // Attempt blocking wait. Will error if thread no longer responds.
-  if (waitpid(currentPid, &status, 0) != -1) {
+  int ret;
+  {
+    phaseTimer timer(Phase::wait);
+    ret = waitpid(currentPid, &status, 0);
+  }
+  if (ret != -1) {
     return make_pair(true, getPtraceEvent(status));
   } else {
-    log.writeToLog(
-        Importance::info, "Failed to hear from tracee through waitpid\n.");
+    LOG(
+        log, Importance::info, "Failed to hear from tracee through waitpid\n.");
     // dummy ptrace event, you should ignore this field on false.
     return make_pair(false, ptraceEvent::eventExit);
   }
 
   // It seems we don't actually need to poll like this: but we leave in case it
   // is needed in the future.
-  log.writeToLog(
-      Importance::info,
+  LOG(
+      log, Importance::info,
       "Initial blocking waitpid failed, switching to polling?\n.");
 
   // Wait for event for N times.
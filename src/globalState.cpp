@@ -1,16 +1,20 @@
 #include "globalState.hpp"
 
+/**
+ * Bound on the directory listings we keep, plenty for the few thousand
+ * directories a large build lists.
+ */
+static const size_t DIRECTORY_CACHE_BYTES = 64 << 20;
+
 globalState::globalState(
     logger& log,
-    ValueMapper<ino_t, ino_t> inodeMap,
-    ModTimeMap mtimeMap,
     bool kernelPre4_12,
     unsigned prngSeed,
     logical_clock::time_point epoch,
     bool allow_network)
     : log(log),
-      inodeMap{inodeMap},
-      mtimeMap{mtimeMap},
+      inodes{log, 1, epoch},
+      directories{DIRECTORY_CACHE_BYTES},
       kernelPre4_12{kernelPre4_12},
       prng(prngSeed),
       epoch(epoch),
@@ -0,0 +1,114 @@
+#include "inodeTable.hpp"
+
+/**
+ * Slots of a new table, a power of two.
+ */
+static const size_t INITIAL_SLOTS = 1024;
+
+inodeTable::inodeTable(
+    logger& log, ino_t firstVirtualInode, logical_clock::time_point epoch)
+    : slots(INITIAL_SLOTS),
+      freshInode(firstVirtualInode),
+      epoch(epoch),
+      log(log) {}
+// =======================================================================================
+size_t inodeTable::home(ino_t realInode) const {
+  // Fibonacci hashing: inodes are often handed out sequentially, the top bits
+  // of the product spread them over the table.
+  int shift = 64 - __builtin_ctzll(slots.size());
+  return (uint64_t)realInode * 0x9E3779B97F4A7C15ull >> shift;
+}
+
+inodeTable::slot& inodeTable::probe(ino_t realInode) {
+  size_t mask = slots.size() - 1;
+  size_t i = home(realInode);
+  while (slots[i].record.virtualInode != 0 &&
+         slots[i].realInode != realInode) {
+    i = (i + 1) & mask;
+  }
+  return slots[i];
+}
+
+void inodeTable::reserveOne() {
+  if ((count + 1) * 2 > slots.size()) {
+    rehash(slots.size() * 2);
+  }
+}
+
+void inodeTable::rehash(size_t newSize) {
+  vector<slot> old(newSize);
+  old.swap(slots);
+  for (const slot& s : old) {
+    if (s.record.virtualInode != 0) {
+      probe(s.realInode) = s;
+    }
+  }
+}
+// =======================================================================================
+const inodeRecord& inodeTable::findOrInsert(ino_t realInode) {
+  slot* s = &probe(realInode);
+  bool seen = s->record.virtualInode != 0;
+  if (!seen) {
+    reserveOne();
+    s = &probe(realInode);
+    *s = slot{realInode, inodeRecord{freshInode++, epoch}};
+    count++;
+  }
+
+  // Whether we had seen this inode is not deterministic, log the same number
+  // of messages either way to keep log message IDs deterministic.
+  LOG(
+      log, Importance::info, "inode table: virtual inode %lu\n",
+      s->record.virtualInode);
+  LOG(
+      log, Importance::extra, "  (real inode %lu, %s)\n", realInode,
+      seen ? "seen before" : "new");
+  return s->record;
+}
+
+void inodeTable::created(ino_t realInode, logical_clock::time_point mtime) {
+  reserveOne();
+  slot& s = probe(realInode);
+  if (s.record.virtualInode == 0) {
+    s.realInode = realInode;
+    count++;
+  }
+  s.record = inodeRecord{freshInode++, mtime};
+
+  LOG(
+      log, Importance::info, "inode table: created virtual inode %lu\n",
+      s.record.virtualInode);
+  LOG(log, Importance::extra, "  (real inode %lu)\n", realInode);
+}
+
+void inodeTable::erase(ino_t realInode) {
+  slot* hole = &probe(realInode);
+  // As in findOrInsert, log the same whether we had it or not.
+  LOG(
+      log, Importance::info, "inode table: erasing virtual inode %lu\n",
+      hole->record.virtualInode);
+  if (hole->record.virtualInode == 0) {
+    return;
+  }
+  count--;
+
+  // Backward shift deletion: pull later inodes of the run into the hole when
+  // their probe passes through it, so no lookup stops short at it.
+  size_t mask = slots.size() - 1;
+  size_t i = hole - slots.data();
+  for (size_t j = (i + 1) & mask; slots[j].record.virtualInode != 0;
+       j = (j + 1) & mask) {
+    // Distance of j from its home slot, and of the hole from that home.
+    size_t jHome = home(slots[j].realInode);
+    if (((j - jHome) & mask) >= ((j - i) & mask)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i].record.virtualInode = 0;
+
+  if (count * 8 < slots.size() && slots.size() > INITIAL_SLOTS) {
+    rehash(slots.size() / 2);
+  }
+}
+// =======================================================================================
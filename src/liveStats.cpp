@@ -0,0 +1,114 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "liveStats.hpp"
+#include "util.hpp"
+
+static uint64_t realtimeNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+// =======================================================================================
+liveStats::liveStats(const string& path) {
+  int fd = doWithCheck(
+      open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644),
+      "liveStats: open");
+  doWithCheck(ftruncate(fd, sizeof(liveStatsPage)), "liveStats: ftruncate");
+
+  void* base = mmap(
+      nullptr, sizeof(liveStatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+      0);
+  if (base == MAP_FAILED) {
+    runtimeError("liveStats: unable to mmap " + path);
+  }
+  close(fd);
+
+  // The file starts out zeroed, readers check the magic last.
+  page = (liveStatsPage*)base;
+  page->version = LIVE_STATS_VERSION;
+  page->systemCallCount = SYSTEM_CALL_COUNT + 1;
+  page->tracerPid = getpid();
+  page->startTime = page->lastUpdate = realtimeNanos();
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(page->magic, LIVE_STATS_MAGIC, sizeof(page->magic));
+}
+
+liveStats::~liveStats() { munmap(page, sizeof(liveStatsPage)); }
+
+void liveStats::update(
+    pid_t currentPid,
+    uint64_t systemCallEvents,
+    uint64_t replays,
+    uint64_t rdtscEvents,
+    uint64_t rdtscpEvents,
+    uint64_t processSpawnEvents,
+    uint64_t runnable,
+    uint64_t blocked) {
+  beginWrite();
+  page->currentPid = currentPid;
+  page->lastUpdate = realtimeNanos();
+  page->events++;
+  page->systemCallEvents = systemCallEvents;
+  page->replays = replays;
+  page->rdtscEvents = rdtscEvents;
+  page->rdtscpEvents = rdtscpEvents;
+  page->processSpawnEvents = processSpawnEvents;
+  page->runnable = runnable;
+  page->blocked = blocked;
+  endWrite();
+}
+
+void liveStats::finish() {
+  beginWrite();
+  page->lastUpdate = realtimeNanos();
+  page->finished = 1;
+  endWrite();
+}
+// =======================================================================================
+void readLiveStats(const string& path, liveStatsPage& out) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    runtimeError("Unable to open live statistics " + path);
+  }
+  struct stat st;
+  doWithCheck(fstat(fd, &st), "readLiveStats: fstat");
+  if ((size_t)st.st_size < sizeof(liveStatsPage)) {
+    close(fd);
+    runtimeError(path + " is too small to be a live statistics page");
+  }
+  void* base =
+      mmap(nullptr, sizeof(liveStatsPage), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    runtimeError("readLiveStats: unable to mmap " + path);
+  }
+  const liveStatsPage* page = (const liveStatsPage*)base;
+
+  bool valid =
+      memcmp(page->magic, LIVE_STATS_MAGIC, sizeof(page->magic)) == 0 &&
+      page->version == LIVE_STATS_VERSION &&
+      page->systemCallCount == SYSTEM_CALL_COUNT + 1;
+  if (valid) {
+    // Retry until the tracer was not in the middle of an update.
+    uint64_t before, after;
+    do {
+      before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+      memcpy(&out, page, sizeof(liveStatsPage));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      after = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) != 0 || before != after);
+  }
+  munmap(base, sizeof(liveStatsPage));
+
+  if (!valid) {
+    runtimeError(
+        path + " is not a version " + to_string(LIVE_STATS_VERSION) +
+        " dettrace live statistics page");
+  }
+}
+// =======================================================================================
@@ -0,0 +1,146 @@
+#include <sstream>
+
+#include "logFilter.hpp"
+#include "logger.hpp"
+#include "systemCallList.hpp"
+#include "util.hpp"
+
+/**
+ * Split a comma separated list, skipping empty items.
+ */
+static vector<string> splitList(const string& list) {
+  vector<string> items;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+static uint64_t parseUnsigned(const string& number, const string& what) {
+  size_t end = 0;
+  uint64_t value = 0;
+  try {
+    value = stoull(number, &end);
+  } catch (...) {
+    end = 0;
+  }
+  if (number.empty() || end != number.size() || number[0] == '-') {
+    runtimeError("Invalid " + what + ": " + number);
+  }
+  return value;
+}
+// =======================================================================================
+void logFilter::setPids(const string& list) {
+  for (auto& pid : splitList(list)) {
+    pids.insert(parseUnsigned(pid, "pid"));
+    eventFilters = true;
+  }
+}
+
+void logFilter::setExecutables(const string& list) {
+  for (auto& name : splitList(list)) {
+    executables.insert(name);
+    eventFilters = true;
+  }
+}
+
+void logFilter::setSystemCalls(const string& list) {
+  for (auto& name : splitList(list)) {
+    int syscall = -1;
+    for (int i = 0; i < SYSTEM_CALL_COUNT; i++) {
+      if (systemCallMappings[i] == name) {
+        syscall = i;
+        break;
+      }
+    }
+    if (syscall == -1) {
+      runtimeError("Unknown system call: " + name);
+    }
+    systemCalls.resize(SYSTEM_CALL_COUNT + 1);
+    systemCalls[syscall] = true;
+    eventFilters = true;
+  }
+}
+
+pair<uint64_t, uint64_t> logFilter::parseWindow(const string& window) {
+  size_t colon = window.find(':');
+  if (colon == string::npos) {
+    runtimeError("Expected a FROM:TO window, got: " + window);
+  }
+  string from = window.substr(0, colon);
+  string to = window.substr(colon + 1);
+  pair<uint64_t, uint64_t> bounds{
+      from.empty() ? 0 : parseUnsigned(from, "window start"),
+      to.empty() ? UINT64_MAX : parseUnsigned(to, "window end")};
+  if (bounds.first > bounds.second) {
+    runtimeError("Empty window: " + window);
+  }
+  return bounds;
+}
+
+void logFilter::setSystemCallWindow(const string& window) {
+  if (window.empty()) {
+    return;
+  }
+  tie(fromSystemCall, toSystemCall) = parseWindow(window);
+  eventFilters = true;
+}
+
+void logFilter::setTimeWindow(const string& window, uint64_t epochMicros) {
+  if (window.empty()) {
+    return;
+  }
+  tie(fromTime, toTime) = parseWindow(window);
+  fromTime += epochMicros;
+  toTime = toTime == UINT64_MAX ? UINT64_MAX : toTime + epochMicros;
+  eventFilters = true;
+}
+
+void logFilter::setImportances(const string& list) {
+  auto names = splitList(list);
+  if (names.empty()) {
+    return;
+  }
+
+  importances = 0;
+  for (auto& name : names) {
+    if (name == "inter") {
+      importances |= 1 << (int)Importance::inter;
+    } else if (name == "info") {
+      importances |= 1 << (int)Importance::info;
+    } else if (name == "extra") {
+      importances |= 1 << (int)Importance::extra;
+    } else {
+      runtimeError(
+          "Unknown importance: " + name + ". Expected inter|info|extra.");
+    }
+  }
+}
+// =======================================================================================
+bool logFilter::matches(
+    pid_t pid,
+    const string& executable,
+    int syscall,
+    uint64_t systemCallCount,
+    uint64_t logicalTime) const {
+  if (!pids.empty() || !executables.empty()) {
+    if (pids.count(pid) == 0 && executables.count(executable) == 0) {
+      return false;
+    }
+  }
+  if (!systemCalls.empty()) {
+    if (syscall < 0 || syscall >= (int)systemCalls.size() ||
+        !systemCalls[syscall]) {
+      return false;
+    }
+  }
+  if (systemCallCount < fromSystemCall || systemCallCount > toSystemCall) {
+    return false;
+  }
+  return logicalTime >= fromTime && logicalTime <= toTime;
+}
+// =======================================================================================
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <exception>
+
+#include "logWriter.hpp"
+#include "util.hpp"
+
+/**
+ * Longest a message waits in the ring before the writer picks it up, unless
+ * someone calls flush().
+ */
+static const chrono::milliseconds WRITER_PERIOD(10);
+
+/**
+ * Live writers. The tracer usually dies of an uncaught runtimeError, through
+ * std::terminate without running destructors, and that is when the end of the
+ * log matters most: both flush them first.
+ */
+static mutex liveWritersLock;
+static vector<logWriter*> liveWriters;
+static terminate_handler previousTerminate;
+
+static void flushLiveWriters() {
+  lock_guard<mutex> lock(liveWritersLock);
+  for (logWriter* w : liveWriters) {
+    w->flush();
+  }
+}
+
+static void flushAndTerminate() {
+  flushLiveWriters();
+  previousTerminate();
+}
+
+static size_t roundUpToPowerOfTwo(size_t n) {
+  size_t p = 1;
+  while (p < n) {
+    p <<= 1;
+  }
+  return p;
+}
+// =======================================================================================
+logWriter::logWriter(int fd, size_t capacity)
+    : fd(fd),
+      ring(roundUpToPowerOfTwo(capacity)),
+      mask(ring.size() - 1) {
+  // The thread inherits our signal mask. Block everything in it, signals such
+  // as the --timeout SIGALRM must reach the tracer thread.
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  writer = thread(&logWriter::run, this);
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+
+  static once_flag installed;
+  call_once(installed, [] {
+    setRuntimeErrorHook(flushLiveWriters);
+    previousTerminate = set_terminate(flushAndTerminate);
+  });
+  lock_guard<mutex> lock(liveWritersLock);
+  liveWriters.push_back(this);
+}
+
+logWriter::~logWriter() {
+  {
+    lock_guard<mutex> lock(liveWritersLock);
+    liveWriters.erase(find(liveWriters.begin(), liveWriters.end(), this));
+  }
+  {
+    lock_guard<mutex> lock(m);
+    stopping = true;
+  }
+  dataAvailable.notify_one();
+  writer.join();
+}
+// =======================================================================================
+void logWriter::write(const char* data, size_t length) {
+  while (length > 0) {
+    uint64_t h = head.load(memory_order_relaxed);
+    uint64_t room = ring.size() - (h - tail.load(memory_order_acquire));
+    if (room == 0) {
+      stalls++;
+      waitForWriter([&] { return tail.load() != h - ring.size(); });
+      continue;
+    }
+
+    size_t chunk = min((uint64_t)length, room);
+    size_t offset = h & mask;
+    size_t first = min(chunk, ring.size() - offset);
+    memcpy(&ring[offset], data, first);
+    memcpy(&ring[0], data + first, chunk - first);
+
+    head.store(h + chunk);
+    data += chunk;
+    length -= chunk;
+
+    // Let small messages pile up into bigger batches, the writer also wakes
+    // up on its own every WRITER_PERIOD.
+    if (h + chunk - tail.load() >= ring.size() / 4) {
+      wakeWriter();
+    }
+  }
+}
+
+void logWriter::flush() {
+  uint64_t h = head.load(memory_order_relaxed);
+  if (tail.load() != h) {
+    waitForWriter([&] { return tail.load() == h; });
+  }
+}
+
+void logWriter::wakeWriter() {
+  // Both sides store their flag/index before reading the other's, so either
+  // we see the writer going to sleep or it sees our new head.
+  if (writerSleeping.load()) {
+    lock_guard<mutex> lock(m);
+    dataAvailable.notify_one();
+  }
+}
+
+template <typename Pred>
+void logWriter::waitForWriter(Pred done) {
+  producerWaiting = true;
+  {
+    unique_lock<mutex> lock(m);
+    dataAvailable.notify_one();
+    spaceAvailable.wait(lock, done);
+  }
+  producerWaiting = false;
+}
+// =======================================================================================
+void logWriter::run() {
+  for (;;) {
+    uint64_t t = tail.load(memory_order_relaxed);
+    uint64_t h = head.load(memory_order_acquire);
+
+    if (h == t) {
+      if (stopping) {
+        return;
+      }
+      writerSleeping = true;
+      {
+        unique_lock<mutex> lock(m);
+        dataAvailable.wait_for(
+            lock, WRITER_PERIOD, [&] { return head.load() != t || stopping; });
+      }
+      writerSleeping = false;
+      continue;
+    }
+
+    // Everything queued so far, in at most two pieces if it wraps around.
+    size_t offset = t & mask;
+    size_t length = h - t;
+    size_t first = min(length, ring.size() - offset);
+    struct iovec iov[2] = {{&ring[offset], first},
+                           {&ring[0], length - first}};
+    int iovcnt = length == first ? 1 : 2;
+
+    while (iovcnt > 0) {
+      ssize_t n = writev(fd, iov, iovcnt);
+      if (n == -1 && errno == EINTR) {
+        continue;
+      }
+      if (n == -1) {
+        // Nowhere to write to (e.g. the fd was closed), drop the batch rather
+        // than stalling the tracer forever.
+        break;
+      }
+      while (iovcnt > 0 && (size_t)n >= iov[0].iov_len) {
+        n -= iov[0].iov_len;
+        iov[0] = iov[1];
+        iovcnt--;
+      }
+      if (iovcnt > 0) {
+        iov[0].iov_base = (char*)iov[0].iov_base + n;
+        iov[0].iov_len -= n;
+      }
+    }
+
+    tail.store(h);
+    if (producerWaiting.load()) {
+      lock_guard<mutex> lock(m);
+      spaceAvailable.notify_one();
+    }
+  }
+}
+// =======================================================================================
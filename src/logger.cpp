@@ -1,5 +1,6 @@
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
@@ -14,7 +15,8 @@
 using namespace std;
 
 /*======================================================================================*/
-logger::logger(string logFile, int debugLevel, bool useColor)
+logger::logger(
+    string logFile, int debugLevel, bool useColor, uint64_t binaryRecords)
     : debugLevel(debugLevel), useColor(useColor) {
   // Check value of debugLevel.
   if (debugLevel > 5 || debugLevel < 0) {
@@ -22,9 +24,13 @@ logger::logger(string logFile, int debugLevel, bool useColor)
     exit(1);
   }
 
-  if (logFile.empty()) {
-    fin = stderr;
-  } else {
+  if (binaryRecords != 0 && logFile.empty()) {
+    fprintf(stderr, "A binary log needs a log file to write to.\n");
+    exit(1);
+  }
+
+  string path;
+  if (!logFile.empty()) {
     // find a unique name for our log file
     char buf[1024];
     for (int i = 0; i < 100; i++) {
@@ -32,17 +38,53 @@ logger::logger(string logFile, int debugLevel, bool useColor)
       int rv = access(buf, F_OK);
       if (0 != rv) break; // file doesn't exist, we can use this name!
     }
-    FILE* logfile = fopen(buf, "w");
+    path = buf;
+  }
+
+  if (path.empty()) {
+    fin = stderr;
+  } else if (binaryRecords != 0) {
+    fin = nullptr;
+    // Nothing to record at level 0, don't create a file full of zeros.
+    if (debugLevel != 0) {
+      binary.reset(new binaryLog(path, binaryRecords));
+    }
+  } else {
+    FILE* logfile = fopen(path.c_str(), "w");
     VERIFY(logfile != NULL);
 
     fin = logfile;
   }
 
+  // Nothing is logged at level 0, don't start a thread for it.
+  if (fin != nullptr && debugLevel > 0) {
+    writer.reset(new logWriter(fileno(fin)));
+    line.resize(1024);
+  }
+
   padding = false;
+  logPrintfFormattingEnabled = true;
+
+  if (debugLevel > DETTRACE_MAX_LOG_LEVEL) {
+    fprintf(
+        stderr,
+        "Warning: debug level %d requested but only levels up to %d were "
+        "compiled in.\n",
+        debugLevel,
+        DETTRACE_MAX_LOG_LEVEL);
+  }
 
   return;
 }
 
+logger::~logger() {
+  // Stop the writer before closing the file it writes to.
+  writer.reset();
+  if (fin != nullptr && fin != stderr) {
+    fclose(fin);
+  }
+}
+
 void logger::writeToLogNoFormat(Importance imp, std::string s) {
   logPrintfFormattingEnabled = false;
   writeToLog(imp, s);
@@ -51,70 +93,140 @@ void logger::writeToLogNoFormat(Importance imp, std::string s) {
 
 void logger::writeToLog(Importance imp, std::string format, ...) {
   // Don't bother, we're not printing anything.
-  if (debugLevel == 0) {
+  if (!enabled(imp)) {
     return;
   }
+  phaseTimer timer(Phase::logging);
 
   va_list args;
-  bool print = false;
-
-  /* Print information based on debug level. */
-  switch (debugLevel) {
-    /* Most verbose, print all messages. Also does extraI. */
-  case 5:
-    print = true;
-    break;
-  case 4:
-    if (imp == Importance::inter || imp == Importance::info) {
-      print = true;
-    }
-    break;
-    /* Ignore informatory messages. */
-  case 3:
-  case 2:
-    if (imp == Importance::inter) {
-      print = true;
+  va_start(args, format);
+  if (binary != nullptr) {
+    // Not a literal, so not a template the binary log can reuse.
+    const char* text = format.c_str();
+    size_t length = format.length();
+    string formatted;
+    if (logPrintfFormattingEnabled) {
+      char* buffer;
+      int n = vasprintf(&buffer, text, args);
+      if (n >= 0) {
+        formatted.assign(buffer, n);
+        free(buffer);
+      }
+      text = formatted.c_str();
+      length = formatted.length();
     }
+    binary->writeText(
+        logEntryID++, importanceLevel(imp), padding ? RECORD_PADDED : 0,
+        context, text, length);
+  } else {
+    write(imp, format.c_str(), args);
+  }
+  va_end(args);
+}
+
+void logger::writeToLog(Importance imp, const char* format, ...) {
+  if (!enabled(imp)) {
+    return;
+  }
+  phaseTimer timer(Phase::logging);
+
+  va_list args;
+  va_start(args, format);
+  if (binary != nullptr) {
+    binary->write(
+        logEntryID++, importanceLevel(imp), padding ? RECORD_PADDED : 0,
+        context, format, args);
+  } else {
+    write(imp, format, args);
+  }
+  va_end(args);
+}
+
+void logger::write(Importance imp, const char* format, va_list args) {
+  if (writer == nullptr) {
+    return;
+  }
+
+  const char* label = "";
+  switch (imp) {
+  case Importance::extra:
+    label = "[5]EXTRA ";
     break;
-  case 1:
-    break;
-  case 0:
+  case Importance::info:
+    label = "[4]INFO  "; // Extra space for correct alignment.
     break;
-  default:
-    fprintf(fin, "  Warning Unknown DEBUG level %d.\n", debugLevel);
+  case Importance::inter:
+    label = "[3]INTER ";
     break;
   }
 
-  if (print) {
-    switch (imp) {
-    case Importance::extra:
-      fprintf(fin, "[5]EXTRA ");
-      break;
-    case Importance::info:
-      fprintf(fin, "[4]INFO  "); // Extra space for correct alignment.
-      break;
-    case Importance::inter:
-      fprintf(fin, "[3]INTER ");
-      break;
-    }
-    fprintf(fin, "%lx ", logEntryID);
-    logEntryID++;
+  // Format the whole line here, while the arguments are still valid, and
+  // leave the I/O to the writer thread.
+  int length = snprintf(
+      line.data(), line.size(), "%s%lx %s", label, logEntryID,
+      padding ? "  " : "");
+  logEntryID++;
 
-    if (padding) {
-      fprintf(fin, "  ");
+  if (logPrintfFormattingEnabled) {
+    va_list copy;
+    va_copy(copy, args);
+    int n = vsnprintf(&line[length], line.size() - length, format, copy);
+    va_end(copy);
+    if (n >= 0 && (size_t)(length + n) >= line.size()) {
+      line.resize(length + n + 1);
+      vsnprintf(&line[length], n + 1, format, args);
     }
-
-    if (logPrintfFormattingEnabled) {
-      va_start(args, format);
-      vfprintf(fin, format.c_str(), args);
-      va_end(args);
-    } else {
-      fwrite(format.c_str(), 1, format.length(), fin);
+    length += max(n, 0);
+  } else {
+    size_t n = strlen(format);
+    if (length + n >= line.size()) {
+      line.resize(length + n + 1);
     }
-    fflush(fin);
+    memcpy(&line[length], format, n);
+    length += n;
   }
 
-  return;
+  writer->write(line.data(), length);
+}
+
+void logger::flush() {
+  if (writer != nullptr) {
+    writer->flush();
+  }
+}
+
+void logger::setFilter(const logFilter& f) {
+  filter = f;
+  refilter();
+}
+
+void logger::refilter() {
+  bool matches = !filter.filtersEvents() ||
+                 filter.matches(
+                     context.pid, contextExecutable, context.syscall,
+                     contextSystemCallCount, context.logicalTime);
+  enabledImportances = matches ? filter.importanceMask() : 0;
+}
+
+void logger::setContextProcess(
+    const string& executable, uint64_t logicalTime) {
+  if (filter.usesExecutables()) {
+    contextExecutable = executable;
+  }
+  context.logicalTime = logicalTime;
+  refilter();
+}
+
+void logger::setContextSystemCall(
+    int syscall,
+    const uint64_t (&args)[6],
+    uint64_t logicalTime,
+    uint64_t systemCallCount) {
+  context.syscall = syscall;
+  memcpy(context.syscallArgs, args, sizeof(context.syscallArgs));
+  context.logicalTime = logicalTime;
+  contextSystemCallCount = systemCallCount;
+  refilter();
 }
 
 void logger::setPadding() {
@@ -129,6 +241,17 @@ void logger::unsetPadding() {
 
 int logger::getDebugLevel() { return debugLevel; }
 
+uint64_t logger::bufferBytes() const {
+  uint64_t bytes = line.capacity();
+  if (writer != nullptr) {
+    bytes += writer->capacity();
+  }
+  if (binary != nullptr) {
+    bytes += binary->mappedSize();
+  }
+  return bytes;
+}
+
 string logger::makeTextColored(Color color, string text) {
   if (!useColor) {
     return text;
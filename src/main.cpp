@@ -18,7 +18,9 @@
 #include <vector>
 
 #include "dettrace.hpp"
+#include "logFilter.hpp"
 #include "logicalclock.hpp"
+#include "schedulingPolicy.hpp"
 #include "util.hpp"
 #define CXXOPTS_NO_RTTI 1 // no rtti for cxxopts, this should be default.
 #define CXXOPTS_VECTOR_DELIMITER '\0'
@@ -60,6 +62,19 @@ struct programArgs {
 
   bool useColor;
   bool printStatistics;
+  std::string statisticsJson;
+  std::string liveStats;
+  std::string timelineFile;
+  std::string fingerprintFile;
+  unsigned long fingerprintInterval;
+  bool binaryLog;
+  unsigned long logRingMiB;
+  std::string logPids;
+  std::string logExecutables;
+  std::string logSyscalls;
+  std::string logSyscallWindow;
+  std::string logTimeWindow;
+  std::string logImportances;
   // We sometimes want to run dettrace inside a chrooted environment.
   // Annoyingly, Linux does not let us create a user namespace if the current
   // process is chrooted. This is a feature. So we handle this special case, by
@@ -86,6 +101,7 @@ struct programArgs {
 
   unsigned short prng_seed;
   bool in_docker;
+  SchedulingPolicy schedulingPolicy;
   
   // Record and replay
   std::string pathtorrfile;
@@ -104,6 +120,8 @@ struct programArgs {
     this->useColor = true;
     this->logFile = "";
     this->printStatistics = false;
+    this->binaryLog = false;
+    this->logRingMiB = 64;
     this->convertUids = false;
     this->alreadyInChroot = false;
     this->timeoutSeconds = 0;
@@ -117,6 +135,7 @@ struct programArgs {
     this->with_etc_overrides = true;
     this->prng_seed = 0;
     this->in_docker = false;
+    this->schedulingPolicy = SCHEDULE_PID_PRIORITY;
     this->pathtorrfile = "";
     this->record = false;
     this->replay = false;
@@ -271,10 +290,24 @@ static int run_main(programArgs& args) {
       .mounts = (Mount* const*)(mountPtrs.data()),
       .chroot_dir = nullptr,
       .with_devrand_overrides = args.with_devrand_overrides,
+      .scheduling_policy = args.schedulingPolicy,
       .debug_level = args.debugLevel,
       .use_color = args.useColor,
       .print_statistics = args.printStatistics,
+      .statistics_json = args.statisticsJson.c_str(),
+      .live_stats = args.liveStats.c_str(),
+      .timeline_file = args.timelineFile.c_str(),
+      .fingerprint_file = args.fingerprintFile.c_str(),
+      .fingerprint_interval = args.fingerprintInterval,
       .log_file = args.logFile.c_str(),
+      .binary_log = args.binaryLog,
+      .log_ring_mib = args.logRingMiB,
+      .log_pids = args.logPids.c_str(),
+      .log_executables = args.logExecutables.c_str(),
+      .log_syscalls = args.logSyscalls.c_str(),
+      .log_syscall_window = args.logSyscallWindow.c_str(),
+      .log_time_window = args.logTimeWindow.c_str(),
+      .log_importances = args.logImportances.c_str(),
   };
 
   pid_t pid = dettrace(&options);
@@ -586,13 +619,70 @@ programArgs parseProgramArguments(int argc, char* argv[]) {
       "Path to write log to. If writing to a file, the filename "
       "has a unique suffix appended. The default is stderr. ",
       cxxopts::value<std::string>())
+    ( "binary-log",
+      "Write the log as fixed-size binary records to a ring buffer mmapped from "
+      "--log-file instead of as text. Much cheaper at high debug levels; render "
+      "it with dettrace-logdecode. The default is `false`.",
+      cxxopts::value<bool>()->default_value("false"))
+    ( "log-ring-mib",
+      "Size of the --binary-log ring in MiB. Older records are overwritten once "
+      "it is full. The default is `64`.",
+      cxxopts::value<unsigned long>()->default_value("64"))
+    ( "log-pids",
+      "Only log events of these (comma separated) pids. Combined with "
+      "--log-executables, events matching either list are logged.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "log-executables",
+      "Only log events of processes that exec'd one of these (comma separated) "
+      "binary names, e.g. `cc1,ld`.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "log-syscalls",
+      "Only log while handling one of these (comma separated) system calls, "
+      "e.g. `openat,stat`.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "log-syscall-window",
+      "Only log while the number of system call stops so far is in FROM:TO. "
+      "A system call with a post hook stops twice, the total is the `System "
+      "Call Events` statistic. Either bound may be omitted.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "log-time-window",
+      "Only log while the process's logical time, in microseconds since "
+      "--epoch, is in FROM:TO. Either bound may be omitted.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "log-importance",
+      "Only log messages of these (comma separated) importances: "
+      "inter|info|extra. The default is all of them.",
+      cxxopts::value<std::string>()->default_value(""))
     ( "with-color",
       "Allow use of ANSI colors in log output. Useful when piping log to a file. The default is `true`. ",
       cxxopts::value<bool>())
     ( "print-statistics",
       "Print metadata about process that just ran including: number of system call events "
       "read/write retries, rdtsc, rdtscp, cpuid. The default is `false`.",
-      cxxopts::value<bool>()->default_value("false"));
+      cxxopts::value<bool>()->default_value("false"))
+    ( "statistics-json",
+      "Also write the statistics, including per system call counters and "
+      "handling latency histograms, as JSON to this file.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "live-stats",
+      "Keep live statistics in this file while running, e.g. "
+      "/dev/shm/dettrace.stats. Watch them with dettrace-top.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "timeline",
+      "Write a timeline of which process ran when, every stop, and the time "
+      "processes spent waiting for their turn, to this file in Chrome trace "
+      "format. Open it in chrome://tracing or ui.perfetto.dev.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "fingerprint",
+      "Keep a hash of every event, system call, return value and tracee memory "
+      "write, and write checkpoints of it to this file. Runs that behaved the "
+      "same have the same checkpoints; the first differing one tells which "
+      "--log-syscall-window to rerun with logging.",
+      cxxopts::value<std::string>()->default_value(""))
+    ( "fingerprint-interval",
+      "System call stops between fingerprint checkpoints, counted as for "
+      "--log-syscall-window.",
+      cxxopts::value<unsigned long>()->default_value("100000"));
 
   // internal options
   options.add_options(
@@ -612,6 +702,12 @@ programArgs parseProgramArguments(int argc, char* argv[]) {
     ( "timeoutSeconds",
       "Tear down all tracee processes with SIGKILL after this many seconds. The default is `0` (i.e., indefinite).",
       cxxopts::value<unsigned long>()->default_value("0"))
+    ( "scheduling-policy",
+      "pid-priority|round-robin|logical-time|spawn-order. Order in which dettrace "
+      "runs runnable and blocked processes. All policies are deterministic, but "
+      "they trade off retries and context switches differently depending on the "
+      "workload. The default is `pid-priority` (highest pid first).",
+      cxxopts::value<std::string>()->default_value("pid-priority"))
     ( "program",
       "program to run",
       cxxopts::value<std::string>())
@@ -657,10 +753,47 @@ programArgs parseProgramArguments(int argc, char* argv[]) {
     args.printStatistics =
         (static_cast<OptionValue1>(result["print-statistics"]))
             .unwrap_or(false);
+    args.statisticsJson = result["statistics-json"].as<std::string>();
+    args.liveStats = result["live-stats"].as<std::string>();
+    args.timelineFile = result["timeline"].as<std::string>();
+    args.fingerprintFile = result["fingerprint"].as<std::string>();
+    args.fingerprintInterval =
+        result["fingerprint-interval"].as<unsigned long>();
+    if (args.fingerprintInterval == 0) {
+      fprintf(stderr, "--fingerprint-interval must be non-zero\n");
+      exit(1);
+    }
+    args.binaryLog = result["binary-log"].as<bool>();
+    args.logRingMiB = result["log-ring-mib"].as<unsigned long>();
+    if (args.binaryLog && (args.logFile.empty() || args.logRingMiB == 0)) {
+      fprintf(
+          stderr, "--binary-log needs a --log-file and a non-zero ring size\n");
+      exit(1);
+    }
+    args.logPids = result["log-pids"].as<std::string>();
+    args.logExecutables = result["log-executables"].as<std::string>();
+    args.logSyscalls = result["log-syscalls"].as<std::string>();
+    args.logSyscallWindow = result["log-syscall-window"].as<std::string>();
+    args.logTimeWindow = result["log-time-window"].as<std::string>();
+    args.logImportances = result["log-importance"].as<std::string>();
+    try {
+      logFilter filter;
+      filter.setPids(args.logPids);
+      filter.setExecutables(args.logExecutables);
+      filter.setSystemCalls(args.logSyscalls);
+      filter.setSystemCallWindow(args.logSyscallWindow);
+      filter.setTimeWindow(args.logTimeWindow, 0);
+      filter.setImportances(args.logImportances);
+    } catch (const std::runtime_error& e) {
+      fprintf(stderr, "%s\n", e.what());
+      exit(1);
+    }
     args.convertUids =
         (static_cast<OptionValue1>(result["convert-uids"])).unwrap_or(false);
     args.timeoutSeconds =
         (static_cast<OptionValue1>(result["timeoutSeconds"])).unwrap_or(0);
+    args.schedulingPolicy =
+        parseSchedulingPolicy(result["scheduling-policy"].as<std::string>());
     args.allow_network =
         (static_cast<OptionValue1>(result["network"])).unwrap_or(false);
     args.with_aslr =
@@ -0,0 +1,105 @@
+#include <ctype.h>
+#include <sys/resource.h>
+
+#include <unordered_set>
+
+#include "globalState.hpp"
+#include "logger.hpp"
+#include "memoryAccounting.hpp"
+#include "processTable.hpp"
+#include "state.hpp"
+
+// =======================================================================================
+void memoryAccounting::sample(
+    globalState& gs, processTable& processes, logger& log) {
+  memoryUsage usage[STRUCTURE_COUNT];
+
+  usage[(int)Structure::inodes] = {gs.inodes.size(), gs.inodes.bytes()};
+
+  // Forked children and threads share their tables until they write to them,
+  // duplicated descriptors share their directory buffer, and buffers share
+  // listings with the directory cache.
+  unordered_set<const void*> seen;
+  memoryUsage& directories = usage[(int)Structure::directoryCache];
+  gs.directories.forEach([&](const directoryCache::listing& listing) {
+    seen.insert(listing.listingId());
+    directories.entries += listing.size();
+  });
+  directories.bytes = gs.directories.bytes();
+  memoryUsage& states = usage[(int)Structure::states];
+  memoryUsage& dirEntries = usage[(int)Structure::dirEntries];
+  processes.forEachState([&](const state& s) {
+    states.entries++;
+    states.bytes += s.executable.capacity();
+    if (seen.insert(&*s.fds).second) {
+      states.bytes += s.fds->capacity() * sizeof(FdInfo);
+      for (const FdInfo& info : *s.fds) {
+        if (info.dir != nullptr && seen.insert(info.dir.get()).second) {
+          dirEntries.entries += info.dir->size();
+          dirEntries.bytes += sizeof(*info.dir);
+          if (seen.insert(info.dir->listingId()).second) {
+            dirEntries.bytes += info.dir->bufferedBytes();
+          }
+        }
+      }
+    }
+    if (seen.insert(&*s.currentSignalHandlers).second) {
+      states.bytes += hashTableBytes(*s.currentSignalHandlers);
+    }
+    if (seen.insert(&*s.timerCreateTimers).second) {
+      states.bytes += hashTableBytes(*s.timerCreateTimers);
+    }
+  });
+
+  usage[(int)Structure::processTable] = {
+      processes.entryCount(), processes.tableBytes()};
+  usage[(int)Structure::logBuffers] = {0, log.bufferBytes()};
+
+  for (int i = 0; i < STRUCTURE_COUNT; i++) {
+    peaks[i].entries = max(peaks[i].entries, usage[i].entries);
+    peaks[i].bytes = max(peaks[i].bytes, usage[i].bytes);
+  }
+  samples++;
+}
+// =======================================================================================
+const char* memoryAccounting::name(Structure s) {
+  switch (s) {
+  case Structure::inodes:
+    return "inodes";
+  case Structure::directoryCache:
+    return "directoryCache";
+  case Structure::dirEntries:
+    return "dirEntries";
+  case Structure::states:
+    return "states";
+  case Structure::processTable:
+    return "processTable";
+  case Structure::logBuffers:
+    return "logBuffers";
+  }
+  return "unknown";
+}
+
+void memoryAccounting::addStatistics(vector<statistic>& stats) const {
+  stats.push_back({"Memory samples: ", "memorySamples", samples});
+  for (int i = 0; i < STRUCTURE_COUNT; i++) {
+    string structure = name((Structure)i);
+    string key = structure;
+    key[0] = toupper(key[0]);
+    if (i != (int)Structure::logBuffers) {
+      stats.push_back(
+          {"Peak " + structure + " entries: ", "peak" + key + "Entries",
+           peaks[i].entries});
+    }
+    stats.push_back(
+        {"Peak " + structure + " bytes: ", "peak" + key + "Bytes",
+         peaks[i].bytes});
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  stats.push_back(
+      {"Tracer peak RSS bytes: ", "tracerPeakRssBytes",
+       (uint64_t)usage.ru_maxrss * 1024});
+}
+// =======================================================================================
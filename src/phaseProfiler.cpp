@@ -0,0 +1,60 @@
+#include <stdio.h>
+
+#include "phaseProfiler.hpp"
+
+phaseProfiler tracerProfile;
+
+void phaseProfiler::start() {
+  startTime = lastSwitch = nowNanos();
+  enabled = true;
+}
+
+void phaseProfiler::stop() {
+  if (enabled) {
+    account();
+    stopTime = lastSwitch;
+    enabled = false;
+  }
+}
+
+uint64_t phaseProfiler::totalNanos() const {
+  return (enabled ? nowNanos() : stopTime) - startTime;
+}
+
+const char* phaseProfiler::name(Phase p) {
+  switch (p) {
+  case Phase::other:
+    return "other";
+  case Phase::wait:
+    return "wait";
+  case Phase::registers:
+    return "registers";
+  case Phase::handler:
+    return "handler";
+  case Phase::memory:
+    return "memory";
+  case Phase::proc:
+    return "proc";
+  case Phase::scheduler:
+    return "scheduler";
+  case Phase::logging:
+    return "logging";
+  }
+  return "unknown";
+}
+
+void phaseProfiler::printText(ostream& out) const {
+  const char* prefix = "dettrace Statistic. ";
+  uint64_t total = totalNanos();
+  char line[128];
+
+  out << prefix << "Tracer time per phase:" << endl;
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    snprintf(
+        line, sizeof(line), "%-10s %12.3f ms %6.2f%%", name((Phase)i),
+        totals[i] / 1e6, total == 0 ? 0.0 : 100.0 * totals[i] / total);
+    out << prefix << line << endl;
+  }
+  snprintf(line, sizeof(line), "%-10s %12.3f ms", "total", total / 1e6);
+  out << prefix << line << endl;
+}
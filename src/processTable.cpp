@@ -0,0 +1,215 @@
+#include "processTable.hpp"
+#include "memoryAccounting.hpp"
+#include "util.hpp"
+
+// =======================================================================================
+processTable::~processTable() {
+  for (auto& p : index) {
+    entry& e = slot(p.second);
+    if (e.live) {
+      e.st().~state();
+      e.live = false;
+    }
+  }
+}
+// =======================================================================================
+uint64_t processTable::tableBytes() const {
+  return slabs.size() * SLAB_ENTRIES * sizeof(entry) +
+         slabs.capacity() * sizeof(slabs[0]) + hashTableBytes(index) +
+         freeSlots.capacity() * sizeof(uint32_t);
+}
+// =======================================================================================
+uint32_t processTable::lookup(pid_t pid) const {
+  auto it = index.find(pid);
+  if (it == index.end()) {
+    runtimeError("No process table entry for pid " + to_string(pid));
+  }
+  return it->second;
+}
+// =======================================================================================
+state& processTable::at(pid_t pid) {
+  entry& e = slot(lookup(pid));
+  if (!e.live) {
+    runtimeError("Process " + to_string(pid) + " has already exited");
+  }
+  return e.st();
+}
+
+state* processTable::find(pid_t pid) {
+  auto it = index.find(pid);
+  if (it == index.end()) {
+    return nullptr;
+  }
+  entry& e = slot(it->second);
+  return e.live ? &e.st() : nullptr;
+}
+// =======================================================================================
+uint32_t processTable::allocate(pid_t pid, state&& s) {
+  if (index.find(pid) != index.end()) {
+    runtimeError(
+        "Process table already has an entry for pid " + to_string(pid));
+  }
+
+  uint32_t i;
+  if (!freeSlots.empty()) {
+    i = freeSlots.back();
+    freeSlots.pop_back();
+  } else {
+    i = slabs.size() * SLAB_ENTRIES;
+    slabs.emplace_back(new entry[SLAB_ENTRIES]);
+    // Hand out the rest of the new slab lowest slot first.
+    for (uint32_t j = i + SLAB_ENTRIES - 1; j > i; j--) {
+      freeSlots.push_back(j);
+    }
+  }
+
+  entry& e = slot(i);
+  e = entry();
+  e.pid = pid;
+  new (&e.storage) state(move(s));
+  e.live = true;
+  index[pid] = i;
+  return i;
+}
+
+void processTable::releaseIfUnused(uint32_t i) {
+  entry& e = slot(i);
+  if (e.pid == -1 || e.live || e.childCount != 0 || e.threadCount != 0) {
+    return;
+  }
+
+  index.erase(e.pid);
+  e.pid = -1;
+  freeSlots.push_back(i);
+}
+// =======================================================================================
+void processTable::linkChild(uint32_t parent, uint32_t child) {
+  entry& p = slot(parent);
+  entry& c = slot(child);
+  c.parent = parent;
+  c.prevSibling = NONE;
+  c.nextSibling = p.firstChild;
+  if (p.firstChild != NONE) {
+    slot(p.firstChild).prevSibling = child;
+  }
+  p.firstChild = child;
+  p.childCount++;
+}
+
+void processTable::unlinkChild(uint32_t child) {
+  entry& c = slot(child);
+  entry& p = slot(c.parent);
+  if (c.prevSibling != NONE) {
+    slot(c.prevSibling).nextSibling = c.nextSibling;
+  } else {
+    p.firstChild = c.nextSibling;
+  }
+  if (c.nextSibling != NONE) {
+    slot(c.nextSibling).prevSibling = c.prevSibling;
+  }
+  p.childCount--;
+
+  uint32_t parent = c.parent;
+  c.parent = c.prevSibling = c.nextSibling = NONE;
+  releaseIfUnused(parent);
+}
+
+void processTable::linkThread(uint32_t leader, uint32_t thread) {
+  entry& l = slot(leader);
+  entry& t = slot(thread);
+  t.leader = leader;
+  t.prevThread = NONE;
+  t.nextThread = l.firstThread;
+  if (l.firstThread != NONE) {
+    slot(l.firstThread).prevThread = thread;
+  }
+  l.firstThread = thread;
+  l.threadCount++;
+}
+
+void processTable::unlinkThread(uint32_t thread) {
+  entry& t = slot(thread);
+  entry& l = slot(t.leader);
+  if (t.prevThread != NONE) {
+    slot(t.prevThread).nextThread = t.nextThread;
+  } else {
+    l.firstThread = t.nextThread;
+  }
+  if (t.nextThread != NONE) {
+    slot(t.nextThread).prevThread = t.prevThread;
+  }
+  l.threadCount--;
+
+  uint32_t leader = t.leader;
+  t.leader = t.prevThread = t.nextThread = NONE;
+  releaseIfUnused(leader);
+}
+// =======================================================================================
+state& processTable::addProcess(pid_t pid, pid_t parent, state&& s) {
+  // Look up parent first, allocating may not invalidate it but throwing after
+  // allocating would leave a half linked entry behind.
+  uint32_t parentSlot = parent == -1 ? NONE : lookup(parent);
+  uint32_t i = allocate(pid, move(s));
+  slot(i).leader = i;
+  if (parentSlot != NONE) {
+    linkChild(slot(parentSlot).leader, i);
+  }
+  return slot(i).st();
+}
+
+state& processTable::addThread(pid_t tid, pid_t creator, state&& s) {
+  uint32_t leader = slot(lookup(creator)).leader;
+  uint32_t i = allocate(tid, move(s));
+  slot(i).isThread = true;
+  linkThread(leader, i);
+  linkChild(leader, i);
+  liveThreads++;
+  return slot(i).st();
+}
+// =======================================================================================
+pid_t processTable::remove(pid_t pid) {
+  uint32_t i = lookup(pid);
+  entry& e = slot(i);
+  if (!e.live) {
+    runtimeError("Process " + to_string(pid) + " removed twice");
+  }
+
+  e.st().~state();
+  e.live = false;
+
+  pid_t parent = -1;
+  if (e.parent != NONE) {
+    parent = slot(e.parent).pid;
+    unlinkChild(i);
+  }
+  if (e.isThread) {
+    liveThreads--;
+    unlinkThread(i);
+  }
+  releaseIfUnused(i);
+  return parent;
+}
+// =======================================================================================
+pid_t processTable::threadGroupOf(pid_t pid) const {
+  return slot(slot(lookup(pid)).leader).pid;
+}
+
+uint32_t processTable::threadGroupSize(pid_t pid) const {
+  const entry& leader = slot(slot(lookup(pid)).leader);
+  return (leader.live ? 1 : 0) + leader.threadCount;
+}
+
+uint32_t processTable::childCount(pid_t pid) const {
+  return slot(lookup(pid)).childCount;
+}
+
+pid_t processTable::anyThreadOf(pid_t pid) const {
+  // The entry of an exited leader goes away along with its last thread.
+  auto it = index.find(pid);
+  if (it == index.end()) {
+    return -1;
+  }
+  const entry& leader = slot(slot(it->second).leader);
+  return leader.firstThread == NONE ? -1 : slot(leader.firstThread).pid;
+}
+// =======================================================================================
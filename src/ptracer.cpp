@@ -129,6 +129,56 @@ string ptracer::readTraceeCString(
   return r;
 }
 
+bool ptracer::tryReadTraceeCString(
+    traceePtr<char> readAddress, pid_t traceePid, string& str) {
+  const size_t pageSize = 4096;
+  char chunk[pageSize];
+  char* address = readAddress.ptr;
+  str.clear();
+
+  // Up to the end of a page at a time, process_vm_readv fails with EFAULT
+  // rather than reading past the end of mapped memory.
+  while (str.size() < PATH_MAX) {
+    size_t toPageEnd = pageSize - (uintptr_t)address % pageSize;
+    readVmCalls++;
+    ssize_t bytesRead = readVmTraceeRaw(
+        traceePtr<char>(address), chunk, toPageEnd, traceePid);
+    if (bytesRead <= 0) {
+      return false;
+    }
+    size_t length = strnlen(chunk, bytesRead);
+    str.append(chunk, length);
+    if (length < (size_t)bytesRead) {
+      return true;
+    }
+    address += bytesRead;
+  }
+  return false;
+}
+
+/**
+ * ptrace, with register and memory access accounted to their phase.
+ */
+static long timedPtrace(
+    enum __ptrace_request request, pid_t pid, void *addr, void *data) {
+  switch (request) {
+  case PTRACE_GETREGS:
+  case PTRACE_SETREGS: {
+    phaseTimer timer(Phase::registers);
+    return ptrace(request, pid, addr, data);
+  }
+  case PTRACE_PEEKTEXT:
+  case PTRACE_PEEKDATA:
+  case PTRACE_POKETEXT:
+  case PTRACE_POKEDATA: {
+    phaseTimer timer(Phase::memory);
+    return ptrace(request, pid, addr, data);
+  }
+  default:
+    return ptrace(request, pid, addr, data);
+  }
+}
+
 long ptracer::doPtrace(
     enum __ptrace_request request, pid_t pid, void *addr, void *data) {
   /*
@@ -142,7 +192,7 @@ long ptracer::doPtrace(
   */
 
   errno = 0;
-  const long val = ptrace(request, pid, addr, data);
+  const long val = timedPtrace(request, pid, addr, data);
 
   if (PTRACE_PEEKTEXT == request || PTRACE_PEEKDATA == request ||
       PTRACE_PEEKUSER == request) {
@@ -6,22 +6,40 @@
 #include "systemCallList.hpp"
 #include "util.hpp"
 
-//#include <deque>
-#include <queue>
 #include <set>
 #include <vector>
 
-bool removeElementFromHeap(priority_queue<pid_t>& heap, pid_t element);
+// =======================================================================================
+void runQueue::push(pid_t pid, int64_t key) {
+  if (!keys.insert({pid, key}).second) {
+    runtimeError(
+        "runQueue::push: process " + to_string(pid) + " already queued.");
+  }
+  order.insert({key, pid});
+}
 
-scheduler::scheduler(pid_t startingPid, logger& log)
-    : log(log), nextPid(startingPid) {
+bool runQueue::erase(pid_t pid) {
+  auto it = keys.find(pid);
+  if (it == keys.end()) {
+    return false;
+  }
+  order.erase({it->second, pid});
+  keys.erase(it);
+  return true;
+}
+// =======================================================================================
+scheduler::scheduler(
+    pid_t startingPid, logger& log, unique_ptr<schedulingPolicy> policy)
+    : log(log), nextPid(startingPid), policy(std::move(policy)) {
   // Processes are always spawned as runnable.
-  runnableHeap.push(startingPid);
+  this->policy->spawned(startingPid);
+  runnableQueue.push(startingPid, this->policy->key(startingPid));
 }
 
 pid_t scheduler::getNext() { return nextPid; }
 
 void scheduler::removeAndScheduleParent(pid_t child, pid_t parent) {
+  phaseTimer timer(Phase::scheduler);
   // Error if the parent of the proces has not finished.
   // Else, remove the process, and schedule its parent to run next.
   if (!isFinished(parent)) {
@@ -31,11 +49,12 @@ void scheduler::removeAndScheduleParent(pid_t child, pid_t parent) {
   }
 
   remove(child);
-  auto msg =
-      log.makeTextColored(Color::blue, "Parent [%d] scheduled for exit.\n");
-  log.writeToLog(Importance::info, msg, parent);
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(Color::blue, "Parent [%d] scheduled for exit.\n"),
+      parent);
 
-  nextPid = parent;
+  setNext(parent);
 }
 
 bool scheduler::isFinished(pid_t process) {
@@ -46,49 +65,107 @@ bool scheduler::isFinished(pid_t process) {
 
 // CHECK
 void scheduler::markFinishedAndScheduleNext(pid_t process) {
-  auto msg =
-      log.makeTextColored(Color::blue, "Process [%d] marked as finished!\n");
-  log.writeToLog(Importance::info, msg, process);
+  phaseTimer timer(Phase::scheduler);
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(Color::blue, "Process [%d] marked as finished!\n"),
+      process);
 
   auto str =
-      "Process moved to finished set (deleted from runnable/blocked heaps)\n";
-  log.writeToLog(Importance::info, str);
+      "Process moved to finished set (deleted from runnable/blocked queues)\n";
+  LOG(log, Importance::info, str);
 
   // Remove process from our regular set of runnable!
   remove(process);
   // Add the process to the set of finished processes.
   finishedProcesses.insert(process);
 
-  nextPid = scheduleNextProcess();
+  setNext(scheduleNextProcess());
 }
 
 // CHECK
 void scheduler::preemptAndScheduleNext() {
-  pid_t curr = runnableHeap.top();
-  auto msg = log.makeTextColored(Color::blue, "Preempting process: [%d]\n");
-  log.writeToLog(Importance::info, msg, curr);
+  phaseTimer timer(Phase::scheduler);
+  // The running process is the one we last scheduled. Policies other than
+  // pid-priority do not guarantee it is at the top of the runnable queue.
+  pid_t curr = runnableQueue.contains(nextPid) ? nextPid : runnableQueue.top();
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(Color::blue, "Preempting process: [%d]\n"), curr);
 
   // We're now blocked.
-  runnableHeap.pop();
-  blockedHeap.push(curr);
-  log.writeToLog(Importance::extra, "Process marked as blocked.\n", curr);
+  runnableQueue.erase(curr);
+  blockedQueue.push(curr, policy->key(curr));
+  preemptions++;
+  LOG(log, Importance::extra, "Process marked as blocked.\n", curr);
 
-  nextPid = scheduleNextProcess();
+  setNext(scheduleNextProcess());
 }
 
-// CHECK
-void scheduler::addAndScheduleNext(pid_t newProcess) {
-  auto msg = log.makeTextColored(
-      Color::blue, "New process added to scheduler: [%d]\n");
-  log.writeToLog(Importance::info, msg, newProcess);
+void scheduler::backoffAndScheduleNext(uint32_t rounds) {
+  phaseTimer timer(Phase::scheduler);
+  pid_t curr = runnableQueue.contains(nextPid) ? nextPid : runnableQueue.top();
+  LOG(
+      log, Importance::info, "Backing off process [%d] for %u rounds\n", curr,
+      rounds);
+  backoff[curr] = rounds;
+  preemptAndScheduleNext();
+}
+
+void scheduler::applyBackoff() {
+  if (backoff.empty()) {
+    return;
+  }
+
+  bool everyoneBackedOff = true;
+  for (auto& entry : runnableQueue) {
+    if (backoff.count(entry.second) == 0) {
+      everyoneBackedOff = false;
+      break;
+    }
+  }
+
+  for (auto it = backoff.begin(); it != backoff.end();) {
+    pid_t pid = it->first;
+    if (!runnableQueue.contains(pid)) {
+      ++it;
+      continue;
+    }
+
+    // Someone else can run, sit this round out.
+    if (!everyoneBackedOff) {
+      runnableQueue.erase(pid);
+      blockedQueue.push(pid, policy->key(pid));
+      backoffSkips++;
+    }
 
-  msg = log.makeTextColored(Color::blue, "[%d] scheduled as next.\n");
-  log.writeToLog(Importance::info, msg, newProcess);
+    if (--it->second == 0) {
+      it = backoff.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
 
-  // Add the process to the runnableHeap, and set nextPid ourselves.
+// CHECK
+void scheduler::addAndScheduleNext(pid_t newProcess) {
+  phaseTimer timer(Phase::scheduler);
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(
+          Color::blue, "New process added to scheduler: [%d]\n"),
+      newProcess);
+
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(Color::blue, "[%d] scheduled as next.\n"),
+      newProcess);
+
+  // Add the process to the runnableQueue, and set nextPid ourselves.
   // (This is because the new process is always capable of running.)
-  runnableHeap.push(newProcess);
-  nextPid = newProcess;
+  policy->spawned(newProcess);
+  runnableQueue.push(newProcess, policy->key(newProcess));
+  setNext(newProcess);
 
   // We still want to count this scheduling event :)
   callsToScheduleNextProcess++;
@@ -97,49 +174,54 @@ void scheduler::addAndScheduleNext(pid_t newProcess) {
 
 // CHECK
 void scheduler::remove(pid_t process) {
-  auto msg = log.makeTextColored(
-      Color::blue, "Removing process runnable|blocked heaps: [%d]\n");
-  log.writeToLog(Importance::info, msg, process);
+  LOG(
+      log, Importance::info,
+      log.makeTextColored(
+          Color::blue, "Removing process runnable|blocked queues: [%d]\n"),
+      process);
 
   // Sanity check that there is at least one process available.
-  if (runnableHeap.empty() && blockedHeap.empty()) {
+  if (runnableQueue.empty() && blockedQueue.empty()) {
     string err = "scheduler::remove: No such element to delete from scheduler.";
     runtimeError(err);
   }
 
-  if (!removeElementFromHeap(runnableHeap, process)) {
-    if (!removeElementFromHeap(blockedHeap, process)) {
+  if (!runnableQueue.erase(process)) {
+    if (!blockedQueue.erase(process)) {
       string err =
           "scheduler::remove: No such element to delete from scheduler.";
       runtimeError(err);
     }
   }
+  policy->removed(process);
+  backoff.erase(process);
 
   return;
 }
 
 // CHECK
 bool scheduler::removeAndScheduleNext(pid_t process) {
+  phaseTimer timer(Phase::scheduler);
   // This process was removed from the heaps a while ago, it only lives in the
   // finished set now. Note not all processes are marked as finished, only
   // processes that had children alive at their time of exit. This may seem more
   // complicated, but it keeps finihsed processes out of the runnable/blocked
   // queues.
   if (isFinished(process)) {
-    log.writeToLog(
-        Importance::info,
+    LOG(
+        log, Importance::info,
         "Removing markedAsFinished process from finish set.\n");
     finishedProcesses.erase(process);
   } else {
-    // Remove the process forever. If both heaps are empty, we are done.
+    // Remove the process forever. If both queues are empty, we are done.
     // Otherwise, schedule the next process to run.
     remove(process);
   }
 
-  if (runnableHeap.empty() && blockedHeap.empty()) {
+  if (runnableQueue.empty() && blockedQueue.empty()) {
     return true;
   } else {
-    nextPid = scheduleNextProcess();
+    setNext(scheduleNextProcess());
     return false;
   }
 }
@@ -149,64 +231,44 @@ pid_t scheduler::scheduleNextProcess() {
   printProcesses();
   callsToScheduleNextProcess++;
 
-  if (!runnableHeap.empty()) {
-    pid_t nextProcess = runnableHeap.top();
+  if (!runnableQueue.empty()) {
+    pid_t nextProcess = runnableQueue.top();
     return nextProcess;
   } else {
-    if (blockedHeap.empty()) {
+    if (blockedQueue.empty()) {
       runtimeError("No processes left to run!\n");
     }
-    priority_queue<pid_t> temp = runnableHeap;
-    runnableHeap = blockedHeap;
-    blockedHeap = temp;
+    runnableQueue.swap(blockedQueue);
+    queueSwaps++;
+    applyBackoff();
 
-    pid_t nextProcess = runnableHeap.top();
+    pid_t nextProcess = runnableQueue.top();
     return nextProcess;
   }
 }
 
-// CHECK
-void scheduler::printProcesses() {
-  log.writeToLog(Importance::extra, "Printing runnable processes\n");
-  // Print the runnableHeap.
-  priority_queue<pid_t> runnableCopy = runnableHeap;
-  while (!runnableCopy.empty()) {
-    pid_t curr = runnableCopy.top();
-    runnableCopy.pop();
-    log.writeToLog(Importance::extra, "Pid [%d], runnable\n", curr);
+void scheduler::setNext(pid_t pid) {
+  if (pid != nextPid) {
+    contextSwitches++;
   }
-
-  log.writeToLog(Importance::extra, "Printing blocked processes\n");
-  // Print the blockedHeap.
-  priority_queue<pid_t> blockedCopy = blockedHeap;
-  while (!blockedCopy.empty()) {
-    pid_t curr = blockedCopy.top();
-    blockedCopy.pop();
-    log.writeToLog(Importance::extra, "Pid [%d], blocked\n", curr);
-  }
-  return;
+  nextPid = pid;
 }
 
 // CHECK
-bool removeElementFromHeap(priority_queue<pid_t>& heap, pid_t element) {
-  vector<pid_t> elements;
-  bool foundElement = false;
-
-  // Go through heap, try to find the element.
-  while (!heap.empty()) {
-    pid_t p = heap.top();
-    heap.pop();
-    if (element == p) {
-      foundElement = true;
-    } else {
-      elements.push_back(p);
-    }
+void scheduler::printProcesses() {
+  // Skip walking the queues if nobody is going to see it.
+  if (log.getDebugLevel() < 5) {
+    return;
   }
 
-  // Take all elements that we popped off and put them back in the heap.
-  for (auto e : elements) {
-    heap.push(e);
+  LOG(log, Importance::extra, "Printing runnable processes\n");
+  for (auto& entry : runnableQueue) {
+    LOG(log, Importance::extra, "Pid [%d], runnable\n", entry.second);
   }
 
-  return foundElement;
+  LOG(log, Importance::extra, "Printing blocked processes\n");
+  for (auto& entry : blockedQueue) {
+    LOG(log, Importance::extra, "Pid [%d], blocked\n", entry.second);
+  }
+  return;
 }
@@ -0,0 +1,54 @@
+#include "schedulingPolicy.hpp"
+#include "util.hpp"
+
+// =======================================================================================
+int64_t spawnOrderPolicy::key(pid_t pid) {
+  auto it = spawnNumber.find(pid);
+  if (it == spawnNumber.end()) {
+    // The starting process is queued before anyone tells us about it.
+    spawned(pid);
+    return spawnNumber.at(pid);
+  }
+  return it->second;
+}
+
+void spawnOrderPolicy::spawned(pid_t pid) {
+  spawnNumber.insert({pid, nextSpawn++});
+}
+
+void spawnOrderPolicy::removed(pid_t pid) { spawnNumber.erase(pid); }
+// =======================================================================================
+unique_ptr<schedulingPolicy> makeSchedulingPolicy(
+    SchedulingPolicy type,
+    function<logical_clock::time_point(pid_t)> logicalTimeOf) {
+  switch (type) {
+  case SCHEDULE_PID_PRIORITY:
+    return unique_ptr<schedulingPolicy>(new pidPriorityPolicy());
+  case SCHEDULE_ROUND_ROBIN:
+    return unique_ptr<schedulingPolicy>(new roundRobinPolicy());
+  case SCHEDULE_LOGICAL_TIME:
+    return unique_ptr<schedulingPolicy>(new logicalTimePolicy(logicalTimeOf));
+  case SCHEDULE_SPAWN_ORDER:
+    return unique_ptr<schedulingPolicy>(new spawnOrderPolicy());
+  }
+
+  runtimeError("Unknown scheduling policy: " + to_string((int)type));
+  return nullptr;
+}
+// =======================================================================================
+SchedulingPolicy parseSchedulingPolicy(const string& name) {
+  if (name == "pid-priority") {
+    return SCHEDULE_PID_PRIORITY;
+  } else if (name == "round-robin") {
+    return SCHEDULE_ROUND_ROBIN;
+  } else if (name == "logical-time") {
+    return SCHEDULE_LOGICAL_TIME;
+  } else if (name == "spawn-order") {
+    return SCHEDULE_SPAWN_ORDER;
+  }
+
+  runtimeError(
+      "Unknown scheduling policy: " + name +
+      ". Expected pid-priority|round-robin|logical-time|spawn-order.");
+  return SCHEDULE_PID_PRIORITY;
+}
@@ -74,7 +74,6 @@ void seccomp::loadRules(bool debug, bool convertUids) {
   noIntercept(SYS_fallocate);
   // Variants of regular function that use file descriptor instead of char*
   // path.
-  noIntercept(SYS_fchdir);
   noIntercept(SYS_fchmod);
   noIntercept(SYS_fchmodat);
 
@@ -168,12 +167,13 @@ void seccomp::loadRules(bool debug, bool convertUids) {
 
   noIntercept(SYS_clone);
 
-  intercept(SYS_rename, debug);
-  intercept(SYS_renameat, debug);
-  intercept(SYS_renameat2, debug);
-  intercept(SYS_rmdir, debug);
-  intercept(SYS_unlink, debug);
-  intercept(SYS_unlinkat, debug);
+  // Always, to erase the inodes they delete from our inode table.
+  intercept(SYS_rename);
+  intercept(SYS_renameat);
+  intercept(SYS_renameat2);
+  intercept(SYS_rmdir);
+  intercept(SYS_unlink);
+  intercept(SYS_unlinkat);
 
   intercept(SYS_execve);
 
@@ -195,7 +195,8 @@ void seccomp::loadRules(bool debug, bool convertUids) {
   intercept(SYS_access, debug);
   // Not used, let's figure out who does one!
   intercept(SYS_alarm);
-  intercept(SYS_chdir, debug);
+  intercept(SYS_chdir);
+  intercept(SYS_fchdir);
   intercept(SYS_chmod, debug);
   intercept(SYS_creat);
   intercept(SYS_clock_gettime);
@@ -1,6 +1,7 @@
 #include "state.hpp"
 
 #include "logicalclock.hpp"
+#include "util.hpp"
 
 state::state(
     pid_t traceePid,
@@ -9,46 +10,59 @@ state::state(
     logical_clock::duration clock_step)
     : clock(clock),
       clock_step(clock_step),
-      fdStatus(new unordered_map<int, descriptorType>),
       traceePid(traceePid),
       signalToDeliver(0),
       mmapMemory(2048),
       debugLevel(debugLevel) {
-  currentSignalHandlers =
-      std::make_shared<unordered_map<int, enum sighandler_type>>();
-  timerCreateTimers = std::make_shared<unordered_map<timerID_t, timerInfo>>();
-  remote_sockfds = std::make_shared<unordered_set<int>>();
-  timerfds = std::make_shared<unordered_map<int, struct itimerspec>>();
-  signalfds = std::make_shared<unordered_set<int>>();
-
   poll_retry_count = 0;
   poll_retry_maximum = LONG_MAX;
 
   return;
 }
 
-void state::setFdStatus(int fd, descriptorType dt) {
-  (*fdStatus.get())[fd] = dt;
+const FdInfo& state::fdInfo(int fd) const {
+  static const FdInfo unknown;
+  if (fd < 0 || (size_t)fd >= fds->size()) {
+    return unknown;
+  }
+  return (*fds)[fd];
 }
 
-descriptorType state::getFdStatus(int fd) { return fdStatus.get()->at(fd); }
+FdInfo& state::editFdInfo(int fd) {
+  if (fd < 0) {
+    runtimeError("Invalid file descriptor: " + to_string(fd));
+  }
+  vector<FdInfo>& table = fds.write();
+  if ((size_t)fd >= table.size()) {
+    table.resize(fd + 1);
+  }
+  return table[fd];
+}
 
-int state::countFdStatus(int fd) { return fdStatus.get()->count(fd); }
+void state::closeFd(int fd) {
+  if (fdInfo(fd).kind != fdKind::none) {
+    editFdInfo(fd) = FdInfo();
+  }
+}
+
+void state::dupFd(int fd, int newfd) {
+  if (fdInfo(fd).kind == fdKind::none) {
+    // dup2 and dup3 may have closed whatever newfd was.
+    closeFd(newfd);
+    return;
+  }
+  FdInfo info = fdInfo(fd);
+  editFdInfo(newfd) = info;
+}
 
 state state::forked(pid_t childPid) const {
   state childState(childPid, this->debugLevel, this->clock, this->clock_step);
   childState.CPUIDTrapSet = this->CPUIDTrapSet;
-  childState.currentSignalHandlers =
-      make_shared<unordered_map<int, enum sighandler_type>>(
-          *(this->currentSignalHandlers));
-  childState.dirEntries = this->dirEntries;
-
-  childState.exfsNotNull = this->exfsNotNull;
-  childState.rdfsNotNull = this->rdfsNotNull;
-  childState.wrfsNotNull = this->wrfsNotNull;
-
-  childState.fdStatus =
-      make_shared<unordered_map<int, descriptorType>>(*(this->fdStatus));
+  childState.executable = this->executable;
+  // Snapshots, only copied if and when parent or child modifies them.
+  childState.currentSignalHandlers = this->currentSignalHandlers.snapshot();
+  childState.fds = this->fds.snapshot();
+  childState.dirs = this->dirs.snapshot();
   childState.fileExisted = this->fileExisted;
   childState.firstTrySystemcall = false;
   childState.inodeToDelete = this->inodeToDelete;
@@ -56,23 +70,17 @@ state state::forked(pid_t childPid) const {
   childState.mmapMemory = this->mmapMemory;
   childState.noopSystemCall = false;
   childState.onPreExitEvent = false;
-  childState.origExfs = this->origExfs;
-  childState.origRdfs = this->origRdfs;
-  childState.origWrfs = this->origWrfs;
   childState.originalArg1 = 0;
   childState.originalArg2 = 0;
   childState.originalArg3 = 0;
   childState.originalArg4 = 0;
   childState.originalArg5 = 0;
   childState.originalArg6 = 0;
-  childState.rdfsNotNull = false;
   childState.regSaver = this->regSaver;
   childState.requestedSignalHandler = this->requestedSignalHandler;
   childState.requestedSignalToHandle = this->requestedSignalToHandle;
   childState.signalInjected = false;
-  childState.timerCreateTimers =
-      make_shared<unordered_map<timerID_t, timerInfo>>(
-          *(this->timerCreateTimers));
+  childState.timerCreateTimers = this->timerCreateTimers.snapshot();
   childState.totalBytes = this->totalBytes;
   childState.traceePid = childPid;
   childState.userDefinedTimeout = false;
@@ -81,11 +89,6 @@ state state::forked(pid_t childPid) const {
   childState.poll_retry_count = 0;
   childState.poll_retry_maximum = LONG_MAX;
 
-  childState.remote_sockfds =
-      make_shared<unordered_set<int>>(*(this->remote_sockfds));
-  childState.timerfds =
-      make_shared<unordered_map<int, struct itimerspec>>(*(this->timerfds));
-  childState.signalfds = make_shared<unordered_set<int>>(*(this->signalfds));
   childState.clock = this->clock;
   return childState;
 }
@@ -93,14 +96,11 @@ state state::forked(pid_t childPid) const {
 state state::cloned(pid_t childPid) const {
   state childState(childPid, this->debugLevel, this->clock, this->clock_step);
   childState.CPUIDTrapSet = this->CPUIDTrapSet;
+  childState.executable = this->executable;
   childState.currentSignalHandlers = this->currentSignalHandlers;
-  childState.dirEntries = this->dirEntries;
-
-  childState.exfsNotNull = this->exfsNotNull;
-  childState.rdfsNotNull = this->rdfsNotNull;
-  childState.wrfsNotNull = this->wrfsNotNull;
-
-  childState.fdStatus = this->fdStatus;
+  childState.fds = this->fds;
+  childState.dirs = this->dirs;
+  childState.pidFd = this->pidFd;
 
   childState.fileExisted = this->fileExisted;
   childState.firstTrySystemcall = false;
@@ -109,16 +109,12 @@ state state::cloned(pid_t childPid) const {
   childState.mmapMemory = this->mmapMemory;
   childState.noopSystemCall = false;
   childState.onPreExitEvent = false;
-  childState.origExfs = this->origExfs;
-  childState.origRdfs = this->origRdfs;
-  childState.origWrfs = this->origWrfs;
   childState.originalArg1 = 0;
   childState.originalArg2 = 0;
   childState.originalArg3 = 0;
   childState.originalArg4 = 0;
   childState.originalArg5 = 0;
   childState.originalArg6 = 0;
-  childState.rdfsNotNull = false;
   childState.regSaver = this->regSaver;
   childState.requestedSignalHandler = this->requestedSignalHandler;
   childState.requestedSignalToHandle = this->requestedSignalToHandle;
@@ -132,9 +128,6 @@ state state::cloned(pid_t childPid) const {
   childState.poll_retry_count = 0;
   childState.poll_retry_maximum = LONG_MAX;
 
-  childState.remote_sockfds = this->remote_sockfds;
-  childState.timerfds = this->timerfds;
-  childState.signalfds = this->signalfds;
   childState.clock = this->clock;
   return childState;
 }
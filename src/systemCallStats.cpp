@@ -0,0 +1,160 @@
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "systemCallStats.hpp"
+
+uint64_t latencyHistogram::quantile(double p) const {
+  uint64_t rank = (uint64_t)(p * count + 0.5);
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank && seen != 0) {
+      return (uint64_t)1 << (i + 1);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Histogram as a JSON array, without the trailing empty buckets.
+ */
+static void writeJsonHistogram(ostream& out, const latencyHistogram& h) {
+  int used = latencyHistogram::BUCKETS;
+  while (used > 0 && h.buckets[used - 1] == 0) {
+    used--;
+  }
+  out << "[";
+  for (int i = 0; i < used; i++) {
+    out << (i == 0 ? "" : ", ") << h.buckets[i];
+  }
+  out << "]";
+}
+
+static string jsonString(const string& s) {
+  string quoted = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    if ((unsigned char)c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+// =======================================================================================
+systemCallStats::systemCallStats() : counters(SYSTEM_CALL_COUNT + 1) {}
+
+const string& systemCallStats::name(int slot) {
+  static const string unknown = "unknown";
+  return slot < SYSTEM_CALL_COUNT ? systemCallMappings[slot] : unknown;
+}
+
+vector<int> systemCallStats::usedSlots() const {
+  vector<int> used;
+  for (int i = 0; i <= SYSTEM_CALL_COUNT; i++) {
+    if (counters[i].preStops + counters[i].postStops != 0) {
+      used.push_back(i);
+    }
+  }
+
+  auto cost = [&](int i) {
+    const systemCallCounters& c = counters[i];
+    return timing ? c.preLatency.totalNanos + c.postLatency.totalNanos
+                  : c.preStops + c.postStops;
+  };
+  stable_sort(used.begin(), used.end(), [&](int a, int b) {
+    return cost(a) > cost(b);
+  });
+  return used;
+}
+// =======================================================================================
+void systemCallStats::printText(ostream& out) const {
+  const char* prefix = "dettrace Statistic. ";
+  char line[256];
+
+  out << prefix << "Per system call:" << endl;
+  snprintf(
+      line, sizeof(line), "%-18s %10s %10s %8s %8s %8s", "system call", "pre",
+      "post", "replays", "emulated", "injected");
+  out << prefix << line;
+  if (timing) {
+    snprintf(
+        line, sizeof(line), " %12s %10s %10s", "total us", "p50 ns", "p99 ns");
+    out << line;
+  }
+  out << endl;
+
+  for (int i : usedSlots()) {
+    const systemCallCounters& c = counters[i];
+    snprintf(
+        line, sizeof(line), "%-18s %10lu %10lu %8lu %8lu %8lu",
+        name(i).c_str(), c.preStops, c.postStops, c.replays, c.emulations,
+        c.injected);
+    out << prefix << line;
+    if (timing) {
+      // Quantiles over both kinds of stops.
+      latencyHistogram all = c.preLatency;
+      for (int b = 0; b < latencyHistogram::BUCKETS; b++) {
+        all.buckets[b] += c.postLatency.buckets[b];
+      }
+      all.count += c.postLatency.count;
+      all.totalNanos += c.postLatency.totalNanos;
+
+      snprintf(
+          line, sizeof(line), " %12lu %10lu %10lu", all.totalNanos / 1000,
+          all.quantile(0.5), all.quantile(0.99));
+      out << line;
+    }
+    out << endl;
+  }
+}
+// =======================================================================================
+void systemCallStats::writeJson(
+    ostream& out,
+    const vector<statistic>& globals,
+    const string& schedulingPolicy) const {
+  out << "{" << endl;
+  out << "  \"counters\": {" << endl;
+  for (size_t i = 0; i < globals.size(); i++) {
+    out << "    " << jsonString(globals[i].key) << ": " << globals[i].value
+        << (i + 1 == globals.size() ? "" : ",") << endl;
+  }
+  out << "  }," << endl;
+  out << "  \"schedulingPolicy\": " << jsonString(schedulingPolicy) << ","
+      << endl;
+  out << "  \"timing\": " << (timing ? "true" : "false") << "," << endl;
+  out << "  \"latencyBuckets\": \"bucket i counts latencies in "
+         "[2^i, 2^(i+1)) ns\","
+      << endl;
+
+  out << "  \"systemCalls\": [";
+  bool first = true;
+  for (int i : usedSlots()) {
+    const systemCallCounters& c = counters[i];
+    out << (first ? "" : ",") << endl;
+    first = false;
+    out << "    {\"name\": " << jsonString(name(i))
+        << ", \"number\": " << (i < SYSTEM_CALL_COUNT ? i : -1)
+        << ", \"preStops\": " << c.preStops
+        << ", \"postStops\": " << c.postStops
+        << ", \"replays\": " << c.replays
+        << ", \"emulations\": " << c.emulations
+        << ", \"injected\": " << c.injected
+        << ", \"preNanos\": " << c.preLatency.totalNanos
+        << ", \"postNanos\": " << c.postLatency.totalNanos
+        << ", \"preLatency\": ";
+    writeJsonHistogram(out, c.preLatency);
+    out << ", \"postLatency\": ";
+    writeJsonHistogram(out, c.postLatency);
+    out << "}";
+  }
+  out << endl << "  ]" << endl;
+  out << "}" << endl;
+}
+// =======================================================================================
@@ -0,0 +1,163 @@
+#include <time.h>
+
+#include "systemCallList.hpp"
+#include "traceTimeline.hpp"
+#include "util.hpp"
+
+static string jsonEscape(const string& s) {
+  string escaped;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if ((unsigned char)c < 0x20) {
+      escaped += ' ';
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+// =======================================================================================
+traceTimeline::traceTimeline(const string& path) {
+  out = fopen(path.c_str(), "we");
+  if (out == nullptr) {
+    runtimeError("Unable to open timeline file " + path);
+  }
+  // Events are small and many, buffer generously.
+  setvbuf(out, nullptr, _IOFBF, 1 << 20);
+  startTime = now();
+  fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+}
+
+traceTimeline::~traceTimeline() {
+  if (stopPid != -1) {
+    handled(false);
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+}
+
+uint64_t traceTimeline::now() const {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+traceTimeline::tracee& traceTimeline::get(pid_t pid) {
+  auto it = tracees.find(pid);
+  if (it == tracees.end()) {
+    // The starting process, or one we missed the spawn of.
+    it = tracees.emplace(pid, tracee{pid}).first;
+  }
+  return it->second;
+}
+// =======================================================================================
+void traceTimeline::separator() {
+  fputs(firstEvent ? "\n" : ",\n", out);
+  firstEvent = false;
+}
+
+void traceTimeline::complete(
+    pid_t pid,
+    const char* category,
+    const string& name,
+    uint64_t start,
+    uint64_t end) {
+  separator();
+  fprintf(
+      out,
+      "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+      "\"dur\": %.3f, \"pid\": %d, \"tid\": %d}",
+      name.c_str(), category, (start - startTime) / 1e3, (end - start) / 1e3,
+      get(pid).threadGroup, pid);
+}
+
+void traceTimeline::instant(pid_t pid, const char* name, const string& args) {
+  separator();
+  fprintf(
+      out,
+      "{\"name\": \"%s\", \"cat\": \"process\", \"ph\": \"i\", \"s\": \"t\", "
+      "\"ts\": %.3f, \"pid\": %d, \"tid\": %d, \"args\": {%s}}",
+      name, (now() - startTime) / 1e3, get(pid).threadGroup, pid,
+      args.c_str());
+}
+// =======================================================================================
+void traceTimeline::resumed(pid_t pid) {
+  tracee& t = get(pid);
+  uint64_t time = now();
+  if (t.parkedAt != 0) {
+    complete(
+        pid, "wait", t.blocked ? "blocked" : "parked", t.parkedAt, time);
+    t.parkedAt = 0;
+  }
+  t.resumedAt = time;
+}
+
+void traceTimeline::stopped(pid_t pid, const char* event) {
+  tracee& t = get(pid);
+  stopAt = now();
+  if (t.resumedAt != 0) {
+    complete(pid, "run", "running", t.resumedAt, stopAt);
+    t.resumedAt = 0;
+  }
+  stopPid = pid;
+  stopName = event;
+}
+
+void traceTimeline::systemCall(int syscall, bool post) {
+  stopName = 0 <= syscall && syscall < SYSTEM_CALL_COUNT
+                 ? systemCallMappings[syscall]
+                 : "unknown system call";
+  if (post) {
+    stopName += " (post)";
+  }
+}
+
+void traceTimeline::handled(bool blocked) {
+  if (stopPid == -1) {
+    return;
+  }
+  uint64_t time = now();
+  complete(stopPid, "stop", stopName, stopAt, time);
+
+  auto it = tracees.find(stopPid);
+  if (it != tracees.end()) {
+    it->second.parkedAt = time;
+    it->second.blocked = blocked;
+  }
+  stopPid = -1;
+}
+// =======================================================================================
+void traceTimeline::spawned(pid_t parent, pid_t child, bool isThread) {
+  tracees[child] = tracee{isThread ? get(parent).threadGroup : child};
+  // The child waits for its first turn from now on.
+  tracees[child].parkedAt = now();
+  instant(
+      parent, isThread ? "clone thread" : "fork",
+      "\"child\": " + to_string(child));
+}
+
+void traceTimeline::exec(pid_t pid, const string& executable) {
+  string name = jsonEscape(executable);
+  instant(pid, "exec", "\"executable\": \"" + name + "\"");
+  if (get(pid).threadGroup == pid) {
+    separator();
+    fprintf(
+        out,
+        "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+        "\"args\": {\"name\": \"%s %d\"}}",
+        pid, name.c_str(), pid);
+  }
+}
+
+void traceTimeline::exited(pid_t pid) {
+  instant(pid, "exit", "");
+  if (stopPid == pid) {
+    // Its last stop ends here, there is nothing to park.
+    complete(pid, "stop", stopName, stopAt, now());
+    stopPid = -1;
+  }
+  tracees.erase(pid);
+}
+// =======================================================================================
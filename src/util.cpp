@@ -44,7 +44,14 @@ unordered_map<int, string> futexAdditionalFlags = {
     {FUTEX_CMP_REQUEUE_PI_PRIVATE, " FUTEX_CMP_REQUEUE_PI_PRIVATE"}};
 
 /*======================================================================================*/
+static void (*runtimeErrorHook)() = nullptr;
+
+void setRuntimeErrorHook(void (*hook)()) { runtimeErrorHook = hook; }
+
 void runtimeError(string error) {
+  if (runtimeErrorHook != nullptr) {
+    runtimeErrorHook();
+  }
   throw runtime_error("dettrace runtime exception: " + error);
 }
 
@@ -1,11 +1,48 @@
 #include "utilSystemCalls.hpp"
 
 #include <fcntl.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
 #include <sstream>
 
+#include "processTable.hpp"
+#include "systemCallList.hpp"
 #include "util.hpp"
 
+/**
+ * Replays in a row, with no process making progress, before we consider a
+ * process to be in a replay storm.
+ */
+static const uint32_t REPLAY_STORM_THRESHOLD = 256;
+
+/**
+ * Cap on the exponential backoff: at most 2^MAX_STORM_LEVEL skipped rounds.
+ */
+static const uint32_t MAX_STORM_LEVEL = 10;
+
+// Newer than some of the headers we build against, x86-64 numbers.
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_openat2
+#define SYS_openat2 437
+#endif
+#ifndef SYS_pidfd_getfd
+#define SYS_pidfd_getfd 438
+#endif
+#ifndef RESOLVE_IN_ROOT
+#define RESOLVE_IN_ROOT 0x10
+#endif
+
+/** struct open_how of openat2(2). */
+struct openHow {
+  uint64_t flags;
+  uint64_t mode;
+  uint64_t resolve;
+};
+
 // File local functions.
+static int fdArgument(int syscallNumber, ptracer& t);
 
 bool preemptIfBlocked(
     globalState& gs,
@@ -14,7 +51,7 @@ bool preemptIfBlocked(
     scheduler& sched,
     int64_t errnoValue) {
   if (-errnoValue == t.getReturnValue()) {
-    gs.log.writeToLog(Importance::info, "Syscall would have blocked!\n");
+    LOG(gs.log, Importance::info, "Syscall would have blocked!\n");
 
     sched.preemptAndScheduleNext();
     return true;
@@ -31,11 +68,41 @@ bool replaySyscallIfBlocked(
     scheduler& sched,
     int64_t errornoValue) {
   if (-errornoValue == t.getReturnValue()) {
-    gs.log.writeToLog(
-        Importance::info, "System call would have blocked! Replaying\n");
+    LOG(
+        gs.log, Importance::info,
+        "System call would have blocked! Replaying\n");
 
     gs.replayDueToBlocking++;
-    sched.preemptAndScheduleNext();
+    s.blockedReplays++;
+    s.replayingBlockedSyscall = true;
+
+    // Only count replays during which nobody else got anything done.
+    if (s.progressAtLastReplay != gs.progressEvents) {
+      s.progressAtLastReplay = gs.progressEvents;
+      s.replaysWithoutProgress = 0;
+    }
+    s.replaysWithoutProgress++;
+
+    if (s.replaysWithoutProgress >= REPLAY_STORM_THRESHOLD) {
+      int syscallNumber = t.getSystemCallNumber();
+      uint32_t rounds = 1U << s.stormLevel;
+      gs.replayStorms++;
+      LOG(
+          gs.log, Importance::inter,
+          "[Pid %d] replay storm: %s(fd %d) replayed %u times without "
+          "progress (%lu total), backing off %u rounds\n",
+          s.traceePid, systemCallMappings[syscallNumber].c_str(),
+          fdArgument(syscallNumber, t), s.replaysWithoutProgress,
+          s.blockedReplays, rounds);
+
+      if (s.stormLevel < MAX_STORM_LEVEL) {
+        s.stormLevel++;
+      }
+      s.replaysWithoutProgress = 0;
+      sched.backoffAndScheduleNext(rounds);
+    } else {
+      sched.preemptAndScheduleNext();
+    }
     replaySystemCall(gs, t, t.getSystemCallNumber());
     return true;
   } else {
@@ -47,6 +114,31 @@ bool replaySyscallIfBlocked(
   }
 }
 // =======================================================================================
+/**
+ * File descriptor argument of a (blocking) system call, or -1 if it does not
+ * take one. Only used for diagnostics.
+ */
+static int fdArgument(int syscallNumber, ptracer& t) {
+  switch (syscallNumber) {
+  case SYS_read:
+  case SYS_write:
+  case SYS_readv:
+  case SYS_writev:
+  case SYS_recvmsg:
+  case SYS_recvfrom:
+  case SYS_sendto:
+  case SYS_sendmsg:
+  case SYS_accept:
+  case SYS_accept4:
+  case SYS_connect:
+  case SYS_epoll_wait:
+  case SYS_epoll_pwait:
+    return (int)t.arg1();
+  default:
+    return -1;
+  }
+}
+// =======================================================================================
 void replaySystemCall(globalState& gs, ptracer& t, uint64_t systemCall) {
 #ifdef EXTRANEOUS_TRACEE_READS
   uint16_t minus2 = t.readFromTracee(
@@ -58,6 +150,7 @@ void replaySystemCall(globalState& gs, ptracer& t, uint64_t systemCall) {
 #endif
 
   gs.totalReplays++;
+  gs.callStats.replay();
   // Replay system call!
   t.changeSystemCall(systemCall);
   t.writeIp((uint64_t)t.getRip().ptr - 2);
@@ -91,7 +184,7 @@ void handleStatFamily(
   }
 
   if (statPtr == nullptr) {
-    gs.log.writeToLog(Importance::info, syscallName + ": statbuf null.\n");
+    LOG(gs.log, Importance::info, syscallName + ": statbuf null.\n");
     return;
   }
 
@@ -109,22 +202,19 @@ void handleStatFamily(
     myStat.st_size = theirStat.st_size;
 
     ino_t realinode = theirStat.st_ino;
-    gs.log.writeToLog(
-        Importance::extra, "(device,realinode) = (%lu,%lu)\n", theirStat.st_dev,
+    LOG(
+        gs.log, Importance::extra,
+        "(device,realinode) = (%lu,%lu)\n", theirStat.st_dev,
         realinode);
-    // Use inode to check if we created this file during our run.
-    const auto mtime = get_with_default(gs.mtimeMap, realinode, gs.epoch);
-
-    gs.log.writeToLog(
-        Importance::extra, " realinode in mtimeMap %d, resulting mtime: %d\n",
-        gs.mtimeMap.find(realinode) != gs.mtimeMap.end(), mtime);
+    // Its mtime is the epoch, unless we saw it being created during our run.
+    const inodeRecord inode = gs.inodes.findOrInsert(realinode);
 
     /* Time of last access */
     myStat.st_atim = logical_clock::to_timespec(gs.epoch);
     /* Time of last status change */
     myStat.st_ctim = logical_clock::to_timespec(gs.epoch);
     /* Time of last modification */
-    myStat.st_mtim = logical_clock::to_timespec(mtime);
+    myStat.st_mtim = logical_clock::to_timespec(inode.mtime);
 
     // TODO: I suspect there is some remaining bug related to #263.
     // Perhaps it has to do with all the conversions between time formats.
@@ -136,15 +226,13 @@ void handleStatFamily(
     // only used single device filesystems.
     myStat.st_dev = 1; /* ID of device containing file */
 
-    myStat.st_ino = gs.inodeMap.realValueExists(realinode)
-                        ? gs.inodeMap.getVirtualValue(realinode)
-                        : gs.inodeMap.addRealValue(realinode);
+    myStat.st_ino = inode.virtualInode;
 
     // st_mode holds the permissions to the file. If we zero it out libc
     // functions will think we don't have access to this file. Hence we keep our
     // permissions as part of the stat. mode_t    st_mode;        /* File type
     // and mode */
-    gs.log.writeToLog(Importance::info, "st_mode:0%o\n", myStat.st_mode);
+    LOG(gs.log, Importance::info, "st_mode:0%o\n", myStat.st_mode);
 
     myStat.st_nlink = 1; /* Number of hard links */
 
@@ -166,9 +254,10 @@ void handleStatFamily(
       // sufficient to determinize the directory st_size.
       myStat.st_size = 16384;
     }
-    gs.log.writeToLog(Importance::info, "st_size:%u\n", myStat.st_size);
-    gs.log.writeToLog(
-        Importance::info, "overwriting tracee stat struct, copying %u bytes\n",
+    LOG(gs.log, Importance::info, "st_size:%u\n", myStat.st_size);
+    LOG(
+        gs.log, Importance::info,
+        "overwriting tracee stat struct, copying %u bytes\n",
         sizeof(struct stat));
 
     myStat.st_blksize = 512; /* Block size for filesystem I/O */
@@ -184,26 +273,29 @@ void handleStatFamily(
 // =======================================================================================
 void printInfoString(
     uint64_t addr, logger& log, pid_t traceePid, ptracer& t, string postFix) {
-  if ((char*)addr != nullptr && log.getDebugLevel() > 0) {
-    string path = t.readTraceeCString(traceePtr<char>((char*)addr), traceePid);
+  string path;
+  if (log.enabled(Importance::info) &&
+      t.tryReadTraceeCString(traceePtr<char>((char*)addr), traceePid, path)) {
     string msg = postFix + log.makeTextColored(Color::green, path) + "\n";
-    log.writeToLog(Importance::info, msg);
+    LOG(log, Importance::info, msg);
   }
   return;
 }
 // =======================================================================================
 void injectPause(globalState& gs, state& s, ptracer& t) {
-  gs.log.writeToLog(Importance::info, "Injecting pause call to tracee!\n");
+  LOG(gs.log, Importance::info, "Injecting pause call to tracee!\n");
   s.syscallInjected = true;
   gs.injectedSystemCalls++;
+  gs.callStats.injection();
 
   replaySystemCall(gs, t, SYS_pause);
 }
 // =======================================================================================
 void replaceSystemCallWithNoop(globalState& gs, state& s, ptracer& t) {
   t.changeSystemCall(SYS_time);
-  gs.log.writeToLog(Importance::info, "Turning this system call into a NOOP\n");
+  LOG(gs.log, Importance::info, "Turning this system call into a NOOP\n");
   s.noopSystemCall = true;
+  gs.callStats.emulation();
   return;
 }
 // =======================================================================================
@@ -211,6 +303,7 @@ void cancelSystemCall(globalState& gs, state& s, ptracer& t) {
   struct user_regs_struct regs = {};
   long cancelled = t.getSystemCallNumber();
   pid_t pid = t.getPid();
+  gs.callStats.emulation();
   t.changeSystemCall(-1);
   ptracer::doPtrace(PTRACE_GETREGS, pid, 0, &regs);
 
@@ -219,8 +312,8 @@ void cancelSystemCall(globalState& gs, state& s, ptracer& t) {
   regs.orig_rax = -1;
   regs.rax = -1;
 
-  gs.log.writeToLog(
-      Importance::info,
+  LOG(
+      gs.log, Importance::info,
       "cancel pending syscall: " + to_string(cancelled) + "\n");
 
   ptracer::doPtrace(PTRACE_SETREGS, pid, 0, &regs);
@@ -258,83 +351,67 @@ pair<int, int> getPipeFds(globalState& gs, state& s, ptracer& t) {
   int fd1 = t.readFromTracee(fdPtr1, t.getPid());
   int fd2 = t.readFromTracee(fdPtr2, t.getPid());
 
-  gs.log.writeToLog(Importance::info, "Got pipe fd1: " + to_string(fd1) + "\n");
-  gs.log.writeToLog(Importance::info, "Got pipe fd2: " + to_string(fd2) + "\n");
+  LOG(gs.log, Importance::info, "Got pipe fd1: " + to_string(fd1) + "\n");
+  LOG(gs.log, Importance::info, "Got pipe fd2: " + to_string(fd2) + "\n");
 
   return make_pair(fd1, fd2);
 }
 
 // =======================================================================================
 bool tracee_file_exists(
-    const string& traceePath, pid_t traceePid, logger& log, int traceeDirFd) {
-  // Create full absolute path in the hostOS file system.
-  string resolvedPath =
-      resolve_tracee_path(traceePath, traceePid, log, traceeDirFd);
-
-  if (resolvedPath.empty()) return false;
-
-  struct stat statbuf = {0};
-  int res = stat(resolvedPath.c_str(), &statbuf);
-  int err = errno;
-  if (res == 0) {
+    const string& traceePath, globalState& gs, state& s, int traceeDirFd) {
+  struct stat statbuf;
+  int err = stat_tracee_path(traceePath, gs, s, traceeDirFd, true, statbuf);
+  if (err == 0) {
     return true;
   } else if (err == ENOENT /*|| err == ENOTDIR might be needed later */) {
     return false;
   } else {
-    log.writeToLog(
-        Importance::info, "Unable to check for existance of file: " +
-                              resolvedPath + ", error: " + strerror(errno));
+    LOG(
+        gs.log, Importance::info, "Unable to check for existance of file: " +
+                                      traceePath + ", error: " + strerror(err));
     return false;
   }
-
-  // Can never happen, here to avoid spurious warning.
-  return false;
 }
 // =======================================================================================
 ino_t inode_from_tracee(
-    const string& traceePath, pid_t traceePid, logger& log, int traceeDirFd) {
-  // Create full absolute path in the hostOS file system.
-  string resolvedPath =
-      resolve_tracee_path(traceePath, traceePid, log, traceeDirFd);
-
-  if (resolvedPath.empty()) {
-    log.writeToLog(
-        Importance::info, string{"inode_from_tracee, cannot resolve "} +
-                              traceePath + "for pid: " + to_string(traceePid));
-    return -1;
-  }
-
-  struct stat statbuf = {0};
+    const string& traceePath, globalState& gs, state& s, int traceeDirFd) {
+  phaseTimer timer(Phase::proc);
+  logger& log = gs.log;
+  struct stat statbuf;
   // If this is a symbolic link, we want the actual symbolic links and not the
   // file it points to! So we lstat
-  int res = lstat(resolvedPath.c_str(), &statbuf);
-  if (res < 0) {
-    log.writeToLog(
-        Importance::info, "Unable to stat file " + traceePath + " => " +
-                              resolvedPath + " tracee, error: " +
-                              strerror(errno) + " (" + to_string(errno) + ")");
+  int err = stat_tracee_path(traceePath, gs, s, traceeDirFd, false, statbuf);
+  if (err != 0) {
+    LOG(
+        log, Importance::info, "Unable to stat file " + traceePath +
+                              " for pid " + to_string(s.traceePid) +
+                              ", error: " + strerror(err) + " (" +
+                              to_string(err) + ")");
     return -1;
   }
 
   if (S_ISLNK(statbuf.st_mode)) {
-    log.writeToLog(Importance::info, "This file is a symbolic link\n");
+    LOG(log, Importance::info, "This file is a symbolic link\n");
   }
 
-  log.writeToLog(
-      Importance::info, "lstat(%s) returned inode!\n", resolvedPath.c_str());
-  log.writeToLog(
-      Importance::extra, "lstat(%s) returned inode: %d!\n",
-      resolvedPath.c_str(), statbuf.st_ino);
+  LOG(
+      log, Importance::info,
+      "lstat(%s) returned inode!\n", traceePath.c_str());
+  LOG(
+      log, Importance::extra, "lstat(%s) returned inode: %d!\n",
+      traceePath.c_str(), statbuf.st_ino);
 
   return statbuf.st_ino;
 }
 // =======================================================================================
 ino_t readInodeFor(logger& log, pid_t traceePid, int fd) {
+  phaseTimer timer(Phase::proc);
   std::ostringstream ss;
   // read from /proc/$pid/fd/$fd
   ss << "/proc/" << traceePid << "/fd/" << fd;
   string procPath = ss.str();
-  log.writeToLog(Importance::info, "procPath: %s\n", procPath.c_str());
+  LOG(log, Importance::info, "procPath: %s\n", procPath.c_str());
   struct stat statbuf = {0};
   int res = stat(procPath.c_str(), &statbuf);
   if (res < 0) {
@@ -344,10 +421,11 @@ ino_t readInodeFor(logger& log, pid_t traceePid, int fd) {
         to_string(res));
   }
 
-  log.writeToLog(
-      Importance::info, "stat(%s) returned inode!\n", procPath.c_str());
-  log.writeToLog(
-      Importance::extra, "stat(%s) returned inode: %d!\n", procPath.c_str(),
+  LOG(
+      log, Importance::info, "stat(%s) returned inode!\n", procPath.c_str());
+  LOG(
+      log, Importance::extra,
+      "stat(%s) returned inode: %d!\n", procPath.c_str(),
       statbuf.st_ino);
 
   return statbuf.st_ino;
@@ -356,14 +434,14 @@ ino_t readInodeFor(logger& log, pid_t traceePid, int fd) {
 bool sendTraceeSignalNow(
     int signum, globalState& gs, state& s, ptracer& t, scheduler& sched) {
   enum sighandler_type sh = SIGHANDLER_DEFAULT;
-  if (s.currentSignalHandlers.get()->count(signum)) {
-    sh = s.currentSignalHandlers.get()->at(signum);
+  if (s.currentSignalHandlers->count(signum)) {
+    sh = s.currentSignalHandlers->at(signum);
   }
 
   switch (sh) {
   case SIGHANDLER_CUSTOM_1SHOT: {
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "tracee has a custom 1-shot signal " + to_string(signum) +
             " handler, sending signal to pid %u\n",
         t.getPid());
@@ -371,7 +449,7 @@ bool sendTraceeSignalNow(
     // TODO: JLD is this a race? the tracee isn't technically paused yet
     t.changeSystemCall(SYS_pause);
     s.signalInjected = true;
-    (*s.currentSignalHandlers.get())[signum] =
+    s.currentSignalHandlers.write()[signum] =
         SIGHANDLER_DEFAULT; // go back to default next time
     int retVal = syscall(SYS_tgkill, t.getPid(), t.getPid(), signum);
     if (0 != retVal) {
@@ -383,8 +461,8 @@ bool sendTraceeSignalNow(
   }
 
   case SIGHANDLER_CUSTOM: {
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "tracee has a custom signal " + to_string(signum) +
             " handler, sending signal to pid %u\n",
         t.getPid());
@@ -406,8 +484,8 @@ bool sendTraceeSignalNow(
       runtimeError("can't send myself a signal " + to_string(signum));
     }
     // for SIGALRM, SIGVTALRM, SIGPROF, default handler terminates the tracee
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "tracee has default signal " + to_string(signum) +
             " handler, injecting exit() for pid %u\n",
         t.getPid());
@@ -418,8 +496,8 @@ bool sendTraceeSignalNow(
 
   case SIGHANDLER_IGNORED: // don't do anything
     replaceSystemCallWithNoop(gs, s, t);
-    gs.log.writeToLog(
-        Importance::info,
+    LOG(
+        gs.log, Importance::info,
         "tracee is ignoring signal " + to_string(signum) + ", doing nothing\n");
     return true; // run noop (getpid) post-hook
 
@@ -432,8 +510,88 @@ bool sendTraceeSignalNow(
   return false;
 }
 // =======================================================================================
-string resolve_tracee_path(
-    const string& traceePath, pid_t traceePid, logger& log, int traceeDirFd) {
+/**
+ * Fail loudly if a descriptor of ours could not be opened for lack of
+ * descriptors: answering from a failed lookup would tell the tracee that
+ * existing files are missing.
+ */
+static void checkDescriptorLimit(int fd, const string& what) {
+  if (fd == -1 && (errno == EMFILE || errno == ENFILE)) {
+    runtimeError(
+        "Out of file descriptors opening " + what +
+        ", the tracer keeps a few per tracee. Raise the hard RLIMIT_NOFILE.");
+  }
+}
+
+/**
+ * Our O_PATH descriptor of the tracee's root (root set) or cwd, from s.dirs or
+ * else opened from /proc. -1 if it cannot be opened.
+ */
+static int traceeDir(globalState& gs, state& s, bool root) {
+  const shared_ptr<hostFd>& cached = root ? s.dirs->root : s.dirs->cwd;
+  if (cached) {
+    return cached->fd;
+  }
+
+  string link =
+      "/proc/" + to_string(s.traceePid) + (root ? "/root" : "/cwd");
+  int fd = open(link.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+  checkDescriptorLimit(fd, link);
+  if (fd == -1) {
+    LOG(
+        gs.log, Importance::info,
+        "Unable to open " + link + " errno: " + to_string(errno) + "\n");
+    return -1;
+  }
+  traceeDirs& dirs = s.dirs.write();
+  (root ? dirs.root : dirs.cwd) = make_shared<hostFd>(fd);
+  return fd;
+}
+
+/**
+ * Whether a failed system call is one the kernel lacks, or a seccomp profile
+ * (as containers commonly use) denies: either way it will keep failing.
+ */
+static bool unavailable(int err) {
+  return err == ENOSYS || err == EPERM;
+}
+
+/**
+ * Our own duplicate of the tracee's file descriptor traceeFd, through the
+ * pidfd of its thread group. -1 if pidfd_getfd fails or is not available.
+ */
+static int duplicateTraceeFd(globalState& gs, state& s, int traceeFd) {
+  static bool pidfdSupported = true;
+  if (!pidfdSupported) {
+    return -1;
+  }
+
+  if (s.pidFd == nullptr) {
+    pid_t threadGroup = gs.processes->threadGroupOf(s.traceePid);
+    int pidfd = syscall(SYS_pidfd_open, threadGroup, 0);
+    checkDescriptorLimit(pidfd, "a pidfd");
+    if (pidfd == -1) {
+      pidfdSupported = !unavailable(errno);
+      return -1;
+    }
+    s.pidFd = make_shared<hostFd>(pidfd);
+  }
+  int fd = syscall(SYS_pidfd_getfd, s.pidFd->fd, traceeFd, 0);
+  checkDescriptorLimit(fd, "a tracee descriptor");
+  if (fd == -1 && unavailable(errno)) {
+    pidfdSupported = false;
+  }
+  return fd;
+}
+
+int stat_tracee_path(
+    const string& traceePath,
+    globalState& gs,
+    state& s,
+    int traceeDirFd,
+    bool follow,
+    struct stat& statbuf) {
+  phaseTimer timer(Phase::proc);
   // Some system calls take empty path and use traceeDirFd exclusively to refer
   // to a file see O_PATH option in `man 2 open`. We do not support this right
   // now...
@@ -442,57 +600,77 @@ string resolve_tracee_path(
   }
 
   if (traceeDirFd < -1 && traceeDirFd != AT_FDCWD) {
-    runtimeError("Negative dirfd given to resolve_tracee_path.");
+    runtimeError("Negative dirfd given to stat_tracee_path.");
   }
 
-  string prefixProcFd;
+  int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+  int ret;
   // is absolute path:
   if (traceePath.rfind("/", 0) == 0) {
     // Absolute path, the user might have chrooted. Use their root.
-    prefixProcFd = "/proc/" + to_string(traceePid) + "/root";
-  } else {
+    int root = traceeDir(gs, s, true);
+    if (root == -1) {
+      return errno;
+    }
+
+    static bool openat2Supported = true;
+    if (openat2Supported) {
+      // Resolves ".." and absolute symbolic links within their root too.
+      openHow how = {0};
+      how.flags = O_PATH | O_CLOEXEC | (follow ? 0 : O_NOFOLLOW);
+      how.resolve = RESOLVE_IN_ROOT;
+      int fd = syscall(SYS_openat2, root, traceePath.c_str(), &how, sizeof how);
+      checkDescriptorLimit(fd, traceePath);
+      if (fd != -1) {
+        ret = fstat(fd, &statbuf);
+        int err = errno;
+        close(fd);
+        return ret == 0 ? 0 : err;
+      }
+      if (!unavailable(errno)) {
+        return errno;
+      }
+      openat2Supported = false;
+    }
+
+    size_t relative = traceePath.find_first_not_of('/');
+    const char* path = relative == string::npos
+                           ? "."
+                           : traceePath.c_str() + relative;
+    ret = fstatat(root, path, &statbuf, flags);
+  } else if (traceeDirFd != -1 && traceeDirFd != AT_FDCWD) {
     // Only on relative paths should we use traceeDirFd if avaliable, and it's
     // not. AT_FDCWD, just uses CWD which we do anyways, in the else branch.
-    if (traceeDirFd != -1 && traceeDirFd != AT_FDCWD) {
-      log.writeToLog(
-          Importance::info, "Using user's dirfd for path resolution.\n");
-      prefixProcFd =
-          "/proc/" + to_string(traceePid) + "/fd/" + to_string(traceeDirFd);
-    } else {
-      // Use cwd to figure out path.
-      prefixProcFd = "/proc/" + to_string(traceePid) + "/cwd";
+    LOG(
+        gs.log, Importance::info, "Using user's dirfd for path resolution.\n");
+    int dir = duplicateTraceeFd(gs, s, traceeDirFd);
+    if (dir != -1) {
+      ret = fstatat(dir, traceePath.c_str(), &statbuf, flags);
+      int err = errno;
+      close(dir);
+      return ret == 0 ? 0 : err;
     }
-  }
 
-  log.writeToLog(
-      Importance::info, "prefixProcFd location: %s\n", prefixProcFd.c_str());
-  char pathbuf[PATH_MAX + 1] = {0};
-  int ret = readlink(prefixProcFd.c_str(), pathbuf, PATH_MAX);
-  if (ret == -1) {
-    log.writeToLog(
-        Importance::info,
-        "Unable to read cwd from tracee: " + to_string(traceePid) +
-            " errno: " + to_string(errno));
-    return "";
+    // No pidfd_getfd, go through the tracee's descriptor in /proc.
+    string path = "/proc/" + to_string(s.traceePid) + "/fd/" +
+                  to_string(traceeDirFd) + "/" + traceePath;
+    ret = fstatat(AT_FDCWD, path.c_str(), &statbuf, flags);
+  } else {
+    // Use cwd to figure out path.
+    int cwd = traceeDir(gs, s, false);
+    if (cwd == -1) {
+      return errno;
+    }
+    ret = fstatat(cwd, traceePath.c_str(), &statbuf, flags);
   }
 
-  auto res = string{pathbuf} + "/" + traceePath;
-  log.writeToLog(
-      Importance::info, "Resolving path %s => %s\n", traceePath.c_str(),
-      res.c_str());
-  return res;
+  return ret == 0 ? 0 : errno;
 }
 // =======================================================================================
-void handlePreOpens(
-    globalState& gs,
-    state& s,
-    ptracer& t,
-    int dirfd,
-    traceePtr<char> charpath,
-    int flags) {
-  string path = t.readTraceeCString(charpath, s.traceePid);
-  string coloredPath = gs.log.makeTextColored(Color::green, path);
-  gs.log.writeToLog(Importance::info, "Path: %s\n", coloredPath.c_str());
+/**
+ * Space separated names of the open flags set in flags, for logging.
+ */
+static string openFlagsToString(int flags) {
   string flagsStr = "";
   if ((flags & O_RDONLY) == O_RDONLY) {
     flagsStr += "O_RDONLY ";
@@ -557,7 +735,23 @@ void handlePreOpens(
   if ((flags & O_TRUNC) == O_TRUNC) {
     flagsStr += "O_TRUNC ";
   }
-  gs.log.writeToLog(Importance::info, "Flags: 0x%x " + flagsStr + "\n", flags);
+  return flagsStr;
+}
+// =======================================================================================
+void handlePreOpens(
+    globalState& gs,
+    state& s,
+    ptracer& t,
+    int dirfd,
+    traceePtr<char> charpath,
+    int flags) {
+  string path = t.readTraceeCString(charpath, s.traceePid);
+  LOG(
+      gs.log, Importance::info, "Path: %s\n",
+      gs.log.makeTextColored(Color::green, path).c_str());
+  LOG(
+      gs.log, Importance::info, "Flags: 0x%x %s\n", flags,
+      openFlagsToString(flags).c_str());
 
   /*
   The O_TMPFILE flag is a superset of other flags and includes, bizarrely,
@@ -576,7 +770,7 @@ Linux acghaswellcat16 4.15.0-43-generic #46-Ubuntu SMP Thu Dec 6 14:45:28 UTC
   if ((flags & O_TMPFILE) == O_TMPFILE) {
     // tmp file being created, no way it could already exist. Skip straight to
     // post-hook.
-    gs.log.writeToLog(Importance::info, "temporary file being created.\n");
+    LOG(gs.log, Importance::info, "temporary file being created.\n");
     return;
   }
 
@@ -595,31 +789,148 @@ Linux acghaswellcat16 4.15.0-43-generic #46-Ubuntu SMP Thu Dec 6 14:45:28 UTC
   // We only case we care about newly created files, later we might want to
   // update the mtime for other modification events like O_TRUNC or O_APPEND.
   if ((flags & O_CREAT) == O_CREAT) {
-    gs.log.writeToLog(Importance::info, "Tracee included O_CREATE.\n");
-    s.fileExisted = tracee_file_exists(path, s.traceePid, gs.log, dirfd);
-    gs.log.writeToLog(
-        Importance::info, "fileExisted? %s\n",
+    LOG(gs.log, Importance::info, "Tracee included O_CREATE.\n");
+    s.fileExisted = tracee_file_exists(path, gs, s, dirfd);
+    LOG(
+        gs.log, Importance::info, "fileExisted? %s\n",
         s.fileExisted ? "true" : "false");
   }
 }
 // =======================================================================================
 void handlePostOpens(globalState& gs, state& s, ptracer& t, int flags) {
-  gs.log.writeToLog(Importance::info, "Flags: 0x%x\n", flags);
+  LOG(gs.log, Importance::info, "Flags: 0x%x\n", flags);
   if (t.getReturnValue() >= 0 &&
       // New regular file created through O_CREAT
       ((((flags & O_CREAT) == O_CREAT) && !s.fileExisted) ||
        // Special case for O_TMPFILE, always consider the file to be
        // newly-created
        ((flags & O_TMPFILE) == O_TMPFILE))) {
-    gs.log.writeToLog(Importance::info, "A new file was created\n!");
+    LOG(gs.log, Importance::info, "A new file was created\n!");
     // Use fd to get inode.
     auto inode = readInodeFor(gs.log, s.traceePid, t.getReturnValue());
-    gs.mtimeMap[inode] = s.getLogicalTime();
-    gs.inodeMap.addRealValue(inode);
+    gs.inodes.created(inode, s.getLogicalTime());
     s.incrementTime();
   }
   s.fileExisted = false;
-  gs.log.writeToLog(
-      Importance::info, "File descriptor: %d\n", t.getReturnValue());
+  LOG(
+      gs.log, Importance::info, "File descriptor: %d\n", t.getReturnValue());
+}
+// =======================================================================================
+void handleDentsPre(globalState& gs, state& s, ptracer& t) {
+  if (s.fdInfo((int)t.arg1()).dir != nullptr) {
+    LOG(gs.log, Importance::info, "Serving getdents from our listing.\n");
+    s.originalArg3 = t.arg3();
+    t.writeArg3(0);
+  }
+}
+
+shared_ptr<directoryEntries<linux_dirent64>> readTraceeDirectory(
+    globalState& gs, state& s, int fd) {
+  phaseTimer timer(Phase::proc);
+  string path = "/proc/" + to_string(s.traceePid) + "/fd/" + to_string(fd);
+  struct stat dir;
+  bool statted = stat(path.c_str(), &dir) == 0;
+  shared_ptr<directoryEntries<linux_dirent64>> entries =
+      statted ? gs.directories.find(dir) : nullptr;
+
+  if (entries == nullptr) {
+    struct timespec readStart;
+    clock_gettime(CLOCK_REALTIME_COARSE, &readStart);
+    // Opening the link makes a new open file description, with its own
+    // offset.
+    int dirFd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd == -1) {
+      runtimeError(
+          "Unable to open directory " + path + ": " + strerror(errno));
+    }
+    entries = make_shared<directoryEntries<linux_dirent64>>(
+        s.dirEntriesBytes, gs.log);
+    bool read = entries->readAll(dirFd);
+    int err = errno;
+    struct statfs filesystem;
+    bool cacheable = statted && fstatfs(dirFd, &filesystem) == 0;
+    close(dirFd);
+    if (!read) {
+      runtimeError("Unable to read directory " + path + ": " + strerror(err));
+    }
+    if (cacheable) {
+      gs.directories.insert(dir, filesystem.f_type, readStart, entries);
+    }
+    LOG(gs.log, Importance::extra, "  (read from the directory)\n");
+  } else {
+    // Whether the listing was cached is not deterministic, log the same
+    // number of messages either way.
+    LOG(gs.log, Importance::extra, "  (cached listing)\n");
+  }
+  LOG(
+      gs.log, Importance::info, "Read %d directory entries.\n",
+      entries->size());
+  // The cache keeps its own reader, positioned at the first entry.
+  return entries->newReader();
+}
+// =======================================================================================
+/**
+ * lstat the tracee path at pathAddr, relative to traceeDirFd. False if there is
+ * no such file, or the path, its memory or the directory is invalid: the
+ * system call will fail on its own.
+ */
+static bool statTraceeName(
+    globalState& gs,
+    state& s,
+    ptracer& t,
+    uint64_t pathAddr,
+    int traceeDirFd,
+    struct stat& statbuf) {
+  string path;
+  if (!t.tryReadTraceeCString(
+          traceePtr<char>((char*)pathAddr), s.traceePid, path) ||
+      path.empty()) {
+    return false;
+  }
+  if (traceeDirFd < 0 && traceeDirFd != AT_FDCWD) {
+    // The kernel ignores the directory for absolute paths, else fails EBADF.
+    if (path[0] != '/') {
+      return false;
+    }
+    traceeDirFd = AT_FDCWD;
+  }
+  return stat_tracee_path(path, gs, s, traceeDirFd, false, statbuf) == 0;
+}
+
+void markLastLink(
+    globalState& gs,
+    state& s,
+    ptracer& t,
+    uint64_t pathAddr,
+    int traceeDirFd,
+    uint64_t renamedAddr,
+    int renamedDirFd) {
+  s.inodeToDelete = -1;
+  struct stat statbuf;
+  if (!statTraceeName(gs, s, t, pathAddr, traceeDirFd, statbuf)) {
+    return;
+  }
+  // Directories can only be removed when empty, and then the inode is gone.
+  if (!S_ISDIR(statbuf.st_mode) && statbuf.st_nlink > 1) {
+    return;
+  }
+  // Renaming a file over itself, or over another link to it, does nothing.
+  struct stat renamed;
+  if (renamedAddr != 0 &&
+      statTraceeName(gs, s, t, renamedAddr, renamedDirFd, renamed) &&
+      renamed.st_dev == statbuf.st_dev && renamed.st_ino == statbuf.st_ino) {
+    return;
+  }
+  LOG(
+      gs.log, Importance::extra, "marking inode %lu for deletion\n",
+      statbuf.st_ino);
+  s.inodeToDelete = statbuf.st_ino;
+}
+
+void eraseMarkedInode(globalState& gs, state& s, ptracer& t) {
+  if (t.getReturnValue() == 0 && s.inodeToDelete != (ino_t)-1) {
+    gs.inodes.erase(s.inodeToDelete);
+  }
+  s.inodeToDelete = -1;
 }
 // =======================================================================================
@@ -0,0 +1,60 @@
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+// Fork/exec throughput benchmark: forks N children one at a time, each of
+// which re-executes this binary with no arguments and exits immediately.
+// Run through `make bench-fork-exec`, which times the whole run under dettrace.
+//
+// With a second argument D, first opens D directories and reads one chunk of
+// each, leaving the rest of their listings buffered by dettrace, as a shell or
+// make holding directories open would. Every fork then has tables to inherit.
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    return 0;
+  }
+
+  int children = atoi(argv[1]);
+  int dirs = argc > 2 ? atoi(argv[2]) : 0;
+  for (int i = 0; i < dirs; i++) {
+    char chunk[1024];
+    int fd = open("/usr/bin", O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || syscall(SYS_getdents64, fd, chunk, sizeof(chunk)) <= 0) {
+      fprintf(stderr, "reading /usr/bin failed: %s\n", strerror(errno));
+      exit(1);
+    }
+  }
+
+  for (int i = 0; i < children; i++) {
+    pid_t pid = fork();
+
+    if (pid < 0) {
+      fprintf(stderr, "fork failed: %s\n", strerror(errno));
+      exit(1);
+    } else if (pid == 0) {
+      const char* exe = argv[0];
+      char* const args[] = { (char*)exe, NULL };
+      char* const env[]  = { "PATH=/bin:/usr/bin", NULL };
+      execve(exe, args, env);
+      fprintf(stderr, "execve failed: %s\n", strerror(errno));
+      exit(1);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "child %d failed\n", i);
+      exit(1);
+    }
+  }
+
+  printf("Forked and executed %d children.\n", children);
+  return 0;
+}
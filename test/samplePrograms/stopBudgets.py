@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+
+"""
+Usage: ./stopBudgets.py [--record] [--slack PERCENT] PROGRAM...
+
+Performance regression gate based on tracer stop counts.
+
+Each tracee stop costs context switches between the tracee and the tracer and
+is where most of dettrace's overhead comes from. Unlike wall clock time, the
+number of stops, replays and injected system calls is deterministic for a
+given program under dettrace, so it can be compared exactly on any machine.
+
+For every PROGRAM (a sample program binary, e.g. helloWorld.bin) this runs it
+under dettrace with --statistics-json and compares its counts against the
+golden file StopBudgets/PROGRAM.json. A count above its golden value (plus
+PERCENT slack) is a failure. A count below it is reported, so the golden file
+can be updated to lock in the improvement. A program without a golden file
+fails too.
+
+With --record, the golden files are (re)written instead, from two runs that
+must agree: a program whose counts vary between runs gets no golden file.
+
+The counts depend on the libc the sample programs are built against, as it
+makes its own system calls, so record them on the machine image CI uses.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+budgetDir = "StopBudgets/"
+dettrace = "../../bin/dettrace"
+timeoutSeconds = "10s"
+
+# Counters we budget. All of them must be deterministic under dettrace.
+budgetedCounters = [
+    "stops",
+    "preStops",
+    "postStops",
+    "totalReplays",
+    "injectedSystemCalls",
+    "processSpawnEvents",
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Check sample programs against their stop count budgets.")
+    parser.add_argument("--record", action="store_true",
+                        help="write the golden files from this run")
+    parser.add_argument("--slack", type=float, default=0,
+                        help="allowed increase over golden counts, in percent")
+    parser.add_argument("programs", nargs="+")
+    args = parser.parse_args()
+
+    # Make everything relative to our location.
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+
+    allWithinBudget = True
+    for program in args.programs:
+        name = program[:-len(".bin")] if program.endswith(".bin") else program
+        goldenFile = budgetDir + name + ".json"
+        if not args.record and not os.path.exists(goldenFile):
+            print("   {}: FAILED, no golden file {}, record one with "
+                  "`make update-stop-budgets`".format(name, goldenFile))
+            allWithinBudget = False
+            continue
+
+        counts = runProgram(program)
+        if counts is None:
+            print("   {}: FAILED, no statistics written".format(name))
+            allWithinBudget = False
+            continue
+
+        if args.record:
+            again = runProgram(program)
+            if again != counts:
+                print("   {}: not recorded, counts differ between runs: {} "
+                      "and {}".format(name, counts, again))
+                continue
+            os.makedirs(budgetDir, exist_ok=True)
+            with open(goldenFile, "w") as f:
+                json.dump(counts, f, indent=2, sort_keys=True)
+                f.write("\n")
+            print("   {}: recorded {} stops".format(name, counts["stops"]))
+            continue
+
+        if not checkBudget(name, goldenFile, counts, args.slack):
+            allWithinBudget = False
+
+    if not allWithinBudget:
+        exit(1)
+    exit(0)
+
+
+def runProgram(program):
+    """Run program under dettrace, return its budgeted counters or None."""
+    # Not in /tmp: dettrace mounts a fresh one for the tracee, and the tracer
+    # would write its statistics there.
+    with tempfile.NamedTemporaryFile(dir=".", prefix=".statistics",
+                                     suffix=".json") as statistics:
+        # The programs' own exit status is checked by `make test`, some of
+        # them are meant to die.
+        subprocess.call(["python3", "timeout.py", timeoutSeconds, dettrace,
+                         "--statistics-json", statistics.name,
+                         "--", "./" + program],
+                        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        try:
+            report = json.load(open(statistics.name))
+        except ValueError:
+            return None
+
+    counts = {key: report["counters"][key] for key in budgetedCounters
+              if key in report["counters"]}
+    counts["preStops"] = sum(c["preStops"] for c in report["systemCalls"])
+    counts["postStops"] = sum(c["postStops"] for c in report["systemCalls"])
+    counts["stops"] = counts["preStops"] + counts["postStops"]
+    return counts
+
+
+def checkBudget(name, goldenFile, counts, slack):
+    """Compare counts against the golden file, return whether within budget."""
+    golden = json.load(open(goldenFile))
+    withinBudget = True
+    improved = []
+    for key in budgetedCounters:
+        if key not in golden or key not in counts:
+            continue
+        budget = golden[key] * (1 + slack / 100.0)
+        if counts[key] > budget:
+            print("   {}: OVER BUDGET, {} went from {} to {}".format(
+                name, key, golden[key], counts[key]))
+            withinBudget = False
+        elif counts[key] < golden[key]:
+            improved.append("{} {} -> {}".format(key, golden[key], counts[key]))
+
+    if withinBudget:
+        print("   {}: {} stops, within budget".format(name, counts["stops"]))
+    if improved:
+        print("   {}: improved ({}), consider updating {}".format(
+            name, ", ".join(improved), goldenFile))
+    return withinBudget
+
+
+if __name__ == "__main__":
+    main()
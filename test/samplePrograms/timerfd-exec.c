@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "util/assert.h"
+
+// An armed timerfd stays open across execve: the new program must still be
+// able to block reading it.
+int main(int argc, char* argv[]) {
+  if (argc > 1) {
+    int fd = atoi(argv[1]);
+    unsigned long expired = 0;
+    ssize_t n = read(fd, &expired, sizeof(expired));
+    printf("read %zd value %lu\n", n, expired);
+    return n == sizeof(expired) ? 0 : 1;
+  }
+
+  int fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  assert(fd >= 0);
+
+  struct itimerspec it = {0};
+  it.it_value.tv_nsec = 100000000;
+  assert(timerfd_settime(fd, 0, &it, NULL) == 0);
+
+  char fdArg[16];
+  snprintf(fdArg, sizeof(fdArg), "%d", fd);
+  printf("timerfd %d armed, executing\n", fd);
+  fflush(stdout);
+
+  char* const args[] = {argv[0], fdArg, NULL};
+  execv(argv[0], args);
+  perror("execv");
+  return 1;
+}
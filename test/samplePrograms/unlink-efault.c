@@ -0,0 +1,20 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// System calls removing names fail with EFAULT on bad path pointers, as they
+// do without dettrace.
+static void report(const char* call, int ret) {
+  printf("%s: %d %s\n", call, ret, ret == -1 ? strerror(errno) : "");
+}
+
+int main(void) {
+  report("unlink", unlink((char*)1));
+  report("unlinkat", unlinkat(AT_FDCWD, (char*)8, 0));
+  report("rmdir", rmdir((char*)8));
+  report("rename", rename("file.txt", (char*)1));
+  report("renameat", renameat(AT_FDCWD, (char*)1, AT_FDCWD, "file.txt"));
+  return 0;
+}
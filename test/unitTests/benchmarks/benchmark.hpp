@@ -0,0 +1,41 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+/**
+ * Keep the compiler from optimizing away a value computed by a benchmark.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Time iterations calls of f, printing and returning nanoseconds per call.
+ */
+template <typename F>
+double runBenchmark(const string& name, uint64_t iterations, F f) {
+  auto start = chrono::steady_clock::now();
+  for (uint64_t i = 0; i < iterations; i++) {
+    f(i);
+  }
+  auto end = chrono::steady_clock::now();
+
+  double ns = chrono::duration<double, nano>(end - start).count() / iterations;
+  printf("%-50s %12lu ops %10.2f ns/op\n", name.c_str(), iterations, ns);
+  return ns;
+}
+
+void loggerBenchmarks();
+void inodeTableBenchmarks();
+void directoryEntriesBenchmarks();
+void schedulerBenchmarks();
+void stateBenchmarks();
+
+#endif
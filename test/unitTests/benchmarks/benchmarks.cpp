@@ -0,0 +1,12 @@
+#include "benchmark.hpp"
+
+// Tracer-side microbenchmarks. These run without dettrace, they time the data
+// structures and helpers on the system call path in isolation.
+int main() {
+  loggerBenchmarks();
+  inodeTableBenchmarks();
+  directoryEntriesBenchmarks();
+  schedulerBenchmarks();
+  stateBenchmarks();
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <dirent.h>
+#include <linux/magic.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "benchmark.hpp"
+#include "../../../include/directoryCache.hpp"
+#include "../../../include/directoryEntries.hpp"
+
+static const size_t ENTRIES = 100000;
+// Bytes getdents64 fills per call with glibc's readdir buffer.
+static const size_t GETDENTS_BYTES = 32768;
+
+/**
+ * A getdents64 buffer for a directory of entries files, in hash order like a
+ * real directory.
+ */
+static vector<uint8_t> makeDirectory(size_t entries) {
+  vector<uint8_t> raw;
+  char name[32];
+  for (size_t i = 0; i < entries; i++) {
+    snprintf(name, sizeof(name), "file%08lx.o", (i * 2654435761u) % entries);
+    size_t length = offsetof(linux_dirent64, d_name) + strlen(name) + 1;
+    size_t reclen = (length + 7) & ~(size_t)7;
+
+    size_t offset = raw.size();
+    raw.resize(offset + reclen);
+    linux_dirent64* entry = (linux_dirent64*)&raw[offset];
+    entry->d_ino = i + 1;
+    entry->d_off = offset + reclen;
+    entry->d_reclen = reclen;
+    entry->d_type = DT_REG;
+    strcpy(entry->d_name, name);
+  }
+  return raw;
+}
+
+void directoryEntriesBenchmarks() {
+  logger log("", 0);
+  vector<uint8_t> directory = makeDirectory(ENTRIES);
+  vector<uint8_t> buffer(GETDENTS_BYTES);
+
+  // One op is a whole directory: buffer it in getdents sized chunks, then hand
+  // it back sorted, as the getdents64 handler does.
+  double ns = runBenchmark(
+      "directoryEntries: sort 10^5 entry directory", 10, [&](uint64_t i) {
+        directoryEntries<linux_dirent64> entries(directory.size(), log);
+        for (size_t offset = 0; offset < directory.size();) {
+          size_t chunk = 0;
+          while (offset + chunk < directory.size()) {
+            auto* entry = (linux_dirent64*)&directory[offset + chunk];
+            if (chunk + entry->d_reclen > GETDENTS_BYTES) {
+              break;
+            }
+            chunk += entry->d_reclen;
+          }
+          entries.addChunk(&directory[offset], chunk);
+          offset += chunk;
+        }
+        while (entries.getSortedEntries(buffer.data(), buffer.size())) {
+        }
+      });
+  printf("directoryEntries: %.2f ns per entry\n", ns / ENTRIES);
+
+  // A process listing a directory another one listed before: find it in the
+  // directory cache, and hand it back from a new reader, without sorting.
+  directoryCache cache(1 << 30);
+  auto listing = make_shared<directoryEntries<linux_dirent64>>(0, log);
+  listing->addChunk(directory.data(), directory.size());
+  struct stat dir = {};
+  dir.st_ino = 2;
+  struct timespec readStart = {1, 0};
+  cache.insert(dir, TMPFS_MAGIC, readStart, listing);
+  ns = runBenchmark(
+      "directoryCache: serve cached 10^5 entry directory", 10,
+      [&](uint64_t i) {
+        auto entries = cache.find(dir)->newReader();
+        while (entries->getSortedEntries(buffer.data(), buffer.size())) {
+        }
+      });
+  printf("directoryCache: %.2f ns per entry\n", ns / ENTRIES);
+}
@@ -0,0 +1,35 @@
+#include "benchmark.hpp"
+#include "../../../include/inodeTable.hpp"
+
+// Order of magnitude of the inodes a large build touches.
+static const uint64_t INODES = 1000000;
+
+/**
+ * Inodes are not dense, spread them out like a real filesystem would.
+ */
+static ino_t realInode(uint64_t i) { return (ino_t)(i * 2654435761u); }
+
+void inodeTableBenchmarks() {
+  logger log("", 0);
+  inodeTable inodes(log, 1, logical_clock::time_point{});
+
+  runBenchmark(
+      "inodeTable: findOrInsert, 10^6 new inodes", INODES,
+      [&](uint64_t i) { doNotOptimize(inodes.findOrInsert(realInode(i))); });
+  runBenchmark(
+      "inodeTable: findOrInsert, seen", INODES,
+      [&](uint64_t i) { doNotOptimize(inodes.findOrInsert(realInode(i))); });
+  runBenchmark(
+      "inodeTable: created, reused inode", INODES, [&](uint64_t i) {
+        inodes.created(realInode(i), logical_clock::time_point{});
+      });
+  runBenchmark(
+      "inodeTable: findOrInsert, sequential new inodes", INODES,
+      [&](uint64_t i) { doNotOptimize(inodes.findOrInsert(i + 1)); });
+  runBenchmark(
+      "inodeTable: created then erased, temporary files", INODES,
+      [&](uint64_t i) {
+        inodes.created(realInode(i + 2 * INODES), logical_clock::time_point{});
+        inodes.erase(realInode(i + 2 * INODES));
+      });
+}
@@ -0,0 +1,74 @@
+#include <unistd.h>
+
+#include "benchmark.hpp"
+#include "../../../include/logger.hpp"
+
+static const uint64_t ITERATIONS = 1000000;
+
+/**
+ * Roughly the log messages of one intercepted system call: the pre-hook
+ * banner, an inode table lookup and a post-hook return value.
+ */
+static void logOneSyscallDirect(logger& log, uint64_t i) {
+  string systemCall = "openat";
+  string redColoredSyscall = log.makeTextColored(Color::red, systemCall);
+  log.writeToLog(
+      Importance::inter, "[Pid %d] Intercepted %s\n", 1234,
+      redColoredSyscall.c_str());
+  log.writeToLog(
+      Importance::info,
+      "inode: fetched virtual value: " + to_string(i) + "\n");
+  log.writeToLog(Importance::info, "Value after handler: %d\n", 3);
+}
+
+static void logOneSyscallMacro(logger& log, uint64_t i) {
+  LOG(
+      log, Importance::inter, "[Pid %d] Intercepted %s\n", 1234,
+      log.makeTextColored(Color::red, "openat").c_str());
+  LOG(
+      log, Importance::info,
+      "inode: fetched virtual value: " + to_string(i) + "\n");
+  LOG(log, Importance::info, "Value after handler: %d\n", 3);
+}
+
+void loggerBenchmarks() {
+  // Level 0 is the default, no message is ever printed.
+  logger log("", 0);
+
+  double direct = runBenchmark(
+      "logger: writeToLog, debug level 0", ITERATIONS,
+      [&](uint64_t i) { logOneSyscallDirect(log, i); });
+  double macro = runBenchmark(
+      "logger: LOG, debug level 0", ITERATIONS,
+      [&](uint64_t i) { logOneSyscallMacro(log, i); });
+
+  printf(
+      "logger: %.2f ns saved per system call (max compiled level %d)\n",
+      direct - macro, DETTRACE_MAX_LOG_LEVEL);
+
+  // Each level up to 5, where everything is written out.
+  char textPath[] = "/tmp/dettraceLogBenchXXXXXX";
+  char binaryPath[] = "/tmp/dettraceLogBenchXXXXXX";
+  close(mkstemp(textPath));
+  close(mkstemp(binaryPath));
+  for (int level = 1; level <= 5; level++) {
+    {
+      logger text(textPath, level, false);
+      runBenchmark(
+          "logger: text log, debug level " + to_string(level), ITERATIONS / 10,
+          [&](uint64_t i) { logOneSyscallMacro(text, i); });
+    }
+    // Free the suffix for the next level.
+    unlink((string(textPath) + ".00").c_str());
+  }
+  {
+    logger binary(binaryPath, 5, false, 1 << 16);
+    runBenchmark(
+        "logger: binary log, debug level 5", ITERATIONS / 10,
+        [&](uint64_t i) { logOneSyscallMacro(binary, i); });
+  }
+  // The logger appended a unique suffix to both paths.
+  unlink(textPath);
+  unlink(binaryPath);
+  unlink((string(binaryPath) + ".00").c_str());
+}
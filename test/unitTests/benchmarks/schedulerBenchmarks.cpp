@@ -0,0 +1,51 @@
+#include <unordered_map>
+
+#include "benchmark.hpp"
+#include "../../../include/scheduler.hpp"
+
+static const pid_t PROCESSES = 4096;
+
+using clockFunction = function<logical_clock::time_point(pid_t)>;
+
+static void benchmarkPolicy(
+    logger& log,
+    SchedulingPolicy type,
+    const string& name,
+    clockFunction logicalTimeOf = [](pid_t) {
+      return logical_clock::from_time_t(0);
+    }) {
+  unique_ptr<scheduler> sched(
+      new scheduler(1, log, makeSchedulingPolicy(type, logicalTimeOf)));
+  runBenchmark(
+      "scheduler (" + name + "): addAndScheduleNext", PROCESSES - 1,
+      [&](uint64_t i) { sched->addAndScheduleNext(i + 2); });
+
+  // Every process blocks in turn, the queues swap every PROCESSES calls.
+  runBenchmark(
+      "scheduler (" + name + "): preemptAndScheduleNext", 100 * PROCESSES,
+      [&](uint64_t i) { sched->preemptAndScheduleNext(); });
+
+  runBenchmark(
+      "scheduler (" + name + "): removeAndScheduleNext", PROCESSES,
+      [&](uint64_t i) {
+        doNotOptimize(sched->removeAndScheduleNext(sched->getNext()));
+      });
+}
+
+void schedulerBenchmarks() {
+  logger log("", 0);
+  benchmarkPolicy(log, SCHEDULE_PID_PRIORITY, "pid-priority");
+  benchmarkPolicy(log, SCHEDULE_ROUND_ROBIN, "round-robin");
+  benchmarkPolicy(log, SCHEDULE_SPAWN_ORDER, "spawn-order");
+
+  // Looked up per pid like execution does in its process table. A process's
+  // clock has moved on by some pid dependent amount each time it is queued
+  // again, as if it ran time related system calls in between.
+  unordered_map<pid_t, logical_clock::time_point> clocks;
+  benchmarkPolicy(
+      log, SCHEDULE_LOGICAL_TIME, "logical-time", [&clocks](pid_t pid) {
+        logical_clock::time_point& clock = clocks[pid];
+        clock += logical_clock::duration(pid * 7919 % 1009 + 1);
+        return clock;
+      });
+}
@@ -0,0 +1,39 @@
+#include "benchmark.hpp"
+#include "../../../include/state.hpp"
+
+static const uint64_t ITERATIONS = 100000;
+
+/**
+ * State of a process that has been running a while: some descriptors and
+ * signal handlers.
+ */
+static state makeParent() {
+  state parent(1, 0, logical_clock::from_time_t(0), logical_clock::duration(1));
+  parent.executable = "/usr/bin/make";
+  for (int fd = 0; fd < 64; fd++) {
+    parent.editFdInfo(fd).kind = fd % 2 == 0 ? fdKind::pipe : fdKind::regular;
+  }
+  for (int signal = 1; signal < 32; signal++) {
+    parent.currentSignalHandlers.write()[signal] = SIGHANDLER_CUSTOM;
+  }
+  return parent;
+}
+
+void stateBenchmarks() {
+  state parent = makeParent();
+  runBenchmark("state: forked", ITERATIONS, [&](uint64_t i) {
+    state child = parent.forked(i + 2);
+    doNotOptimize(child);
+  });
+  // Forked children usually exec, but some write their tables first.
+  runBenchmark(
+      "state: forked, child closes a descriptor", ITERATIONS, [&](uint64_t i) {
+        state child = parent.forked(i + 2);
+        child.closeFd(3);
+        doNotOptimize(child);
+      });
+  runBenchmark("state: cloned", ITERATIONS, [&](uint64_t i) {
+    state thread = parent.cloned(i + 2);
+    doNotOptimize(thread);
+  });
+}
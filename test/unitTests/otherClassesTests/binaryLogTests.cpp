@@ -0,0 +1,126 @@
+#include "../catch.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "../../../include/binaryLog.hpp"
+#include "../../../include/logger.hpp"
+
+/**
+ * Tests for the binary log: what it decodes to must be the text log, byte for
+ * byte.
+ */
+
+static void logMessages(logger& log) {
+  LOG(log, Importance::info, "plain message\n");
+  LOG(log, Importance::inter, "pid %d fd %u arg 0x%lx\n", 1234, 7u, 0xbeefUL);
+  LOG(log, Importance::extra, "path %s, mode %o\n", "/tmp/some/file", 0644);
+  LOG(log, Importance::info, "%5.2f%% done, %c\n", 99.5, 'x');
+  LOG(log, Importance::info, "null %s\n", (const char*)nullptr);
+  // Strings too long for one record spill into continuation records.
+  string longPath(300, 'p');
+  LOG(log, Importance::info, "long %s end\n", longPath.c_str());
+  // Formats built at runtime: a std::string, and a heap buffer.
+  LOG(log, Importance::info, "built " + to_string(42) + " at runtime\n");
+  char* buffer;
+  REQUIRE(asprintf(&buffer, "heap %d\n", 1) >= 0);
+  LOG(log, Importance::info, buffer);
+  free(buffer);
+  log.writeToLogNoFormat(Importance::info, "no %d format\n");
+  log.setPadding();
+  LOG(log, Importance::extra, "padded %d\n", 2);
+  log.unsetPadding();
+  for (int i = 0; i < 100; i++) {
+    LOG(log, Importance::info, "message %d of %s\n", i, "many");
+  }
+}
+
+static string readFile(const string& path) {
+  ifstream file(path);
+  stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+/** Render the binary log like dettrace-logdecode does. */
+static string decode(const string& path) {
+  string text;
+  binaryLogReader reader(path);
+  reader.forEach([&](const binaryLogRecord& r, const string& message) {
+    const char* label = r.importance == 2
+                            ? "[3]INTER "
+                            : r.importance == 4 ? "[4]INFO  " : "[5]EXTRA ";
+    char id[32];
+    snprintf(id, sizeof(id), "%lx ", r.entryId);
+    text += label;
+    text += id;
+    if ((r.flags & RECORD_PADDED) != 0) {
+      text += "  ";
+    }
+    text += message;
+  });
+  return text;
+}
+
+TEST_CASE("binary log decodes to the text log", "binaryLog") {
+  char dir[] = "/tmp/binaryLogTestsXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  string textPath = string{dir} + "/text";
+  string binaryPath = string{dir} + "/binary";
+
+  {
+    logger text(textPath, 5, false);
+    logMessages(text);
+  }
+  {
+    logger binary(binaryPath, 5, false, 1024);
+    logMessages(binary);
+  }
+
+  // The logger numbers its log files.
+  string expected = readFile(textPath + ".00");
+  REQUIRE(!expected.empty());
+  REQUIRE(decode(binaryPath + ".00") == expected);
+
+  SECTION("a full ring keeps the most recent messages") {
+    {
+      logger binary(binaryPath, 5, false, 16);
+      logMessages(binary);
+    }
+    string decoded = decode(binaryPath + ".01");
+    REQUIRE(!decoded.empty());
+    REQUIRE(
+        expected.compare(
+            expected.size() - decoded.size(), decoded.size(), decoded) == 0);
+    unlink((binaryPath + ".01").c_str());
+  }
+
+  SECTION("formats built at runtime get no template") {
+    {
+      logger binary(binaryPath, 5, false, 16);
+      LOG(binary, Importance::info, "literal %d\n", 1);
+      for (int i = 0; i < 100; i++) {
+        char* buffer;
+        REQUIRE(asprintf(&buffer, "heap %d\n", i) >= 0);
+        LOG(binary, Importance::info, buffer);
+        free(buffer);
+      }
+    }
+    binaryLogHeader header;
+    FILE* file = fopen((binaryPath + ".01").c_str(), "r");
+    REQUIRE(file != nullptr);
+    REQUIRE(fread(&header, sizeof(header), 1, file) == 1);
+    fclose(file);
+    // The text template and the literal.
+    REQUIRE(header.templateCount == 2);
+    unlink((binaryPath + ".01").c_str());
+  }
+
+  unlink((textPath + ".00").c_str());
+  unlink((binaryPath + ".00").c_str());
+  rmdir(dir);
+}
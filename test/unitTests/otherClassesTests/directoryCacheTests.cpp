@@ -0,0 +1,172 @@
+#include "../catch.hpp"
+#include <dirent.h>
+#include <linux/magic.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../../../include/directoryCache.hpp"
+#include "../../../include/directoryEntries.hpp"
+
+/**
+ * Tests for directoryCache and the sorted order of directoryEntries.
+ */
+
+static logger testLog("", 0);
+
+/** A getdents64 buffer with names, in the given order. */
+static vector<uint8_t> rawDirectory(const vector<string>& names) {
+  vector<uint8_t> raw;
+  for (size_t i = 0; i < names.size(); i++) {
+    size_t reclen = direntSize((linux_dirent64*)nullptr, names[i].size());
+    size_t offset = raw.size();
+    raw.resize(offset + reclen);
+    writeDirent(
+        (linux_dirent64*)&raw[offset], i + 1, DT_REG, names[i].c_str(),
+        names[i].size());
+  }
+  return raw;
+}
+
+static shared_ptr<directoryEntries<linux_dirent64>> listingOf(
+    const vector<string>& names) {
+  vector<uint8_t> raw = rawDirectory(names);
+  auto entries = make_shared<directoryEntries<linux_dirent64>>(0, testLog);
+  entries->addChunk(raw.data(), raw.size());
+  return entries;
+}
+
+/** Names handed back by entries, in Out format, buffer bytes at a time. */
+template <typename Out>
+static vector<string> namesOf(
+    directoryEntries<linux_dirent64>& entries, size_t bufferBytes) {
+  vector<string> names;
+  vector<uint8_t> buffer(bufferBytes);
+  size_t filled;
+  while ((filled = entries.getSortedEntries<Out>(
+              buffer.data(), buffer.size())) != 0) {
+    for (size_t offset = 0; offset < filled;) {
+      Out* entry = (Out*)&buffer[offset];
+      names.push_back(entry->d_name);
+      offset += entry->d_reclen;
+    }
+  }
+  return names;
+}
+
+/** A directory's stat, changed at ctime seconds. */
+static struct stat directory(ino_t ino, time_t ctime) {
+  struct stat dir = {};
+  dir.st_dev = 1;
+  dir.st_ino = ino;
+  dir.st_mtim.tv_sec = ctime;
+  dir.st_ctim.tv_sec = ctime;
+  return dir;
+}
+
+static const struct timespec READ_START = {1000, 0};
+
+TEST_CASE("entries are sorted by name, descending", "directoryEntries") {
+  vector<string> names = {
+      "b", "a", "ab", "0123456789abcdef", "0123456789abcdefg",
+      "0123456789abcdef0", "0123456789abcdeg", "0123456789abcde",
+      "0123456789abcdefzz", "0123456789abcdefz", "\xff", "\x80z", "A"};
+  vector<string> expected = names;
+  sort(expected.begin(), expected.end(), greater<string>());
+
+  SECTION("names sharing a 16 byte prefix") {
+    auto entries = listingOf(names);
+    REQUIRE(namesOf<linux_dirent64>(*entries, 4096) == expected);
+  }
+
+  SECTION("in getdents format, a few entries at a time") {
+    auto entries = listingOf(names);
+    REQUIRE(namesOf<linux_dirent>(*entries, 64) == expected);
+  }
+
+  SECTION("readers of a listing each start from the first entry") {
+    auto entries = listingOf(names);
+    auto first = entries->newReader();
+    auto second = entries->newReader();
+    REQUIRE(namesOf<linux_dirent64>(*first, 4096) == expected);
+    REQUIRE(first->size() == 0);
+    REQUIRE(second->size() == names.size());
+    REQUIRE(namesOf<linux_dirent64>(*second, 4096) == expected);
+  }
+}
+
+TEST_CASE("directory cache invalidation", "directoryCache") {
+  directoryCache cache(1 << 20);
+  auto entries = listingOf({"a", "b"});
+
+  SECTION("a directory unchanged since it was read hits") {
+    cache.insert(directory(2, 10), TMPFS_MAGIC, READ_START, entries);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.find(directory(2, 10)) == entries);
+    REQUIRE(cache.find(directory(3, 10)) == nullptr);
+  }
+
+  SECTION("a directory whose ctime changed misses, and is dropped") {
+    cache.insert(directory(2, 10), TMPFS_MAGIC, READ_START, entries);
+    struct stat changed = directory(2, 10);
+    changed.st_ctim.tv_nsec = 1;
+    REQUIRE(cache.find(changed) == nullptr);
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.bytes() == 0);
+  }
+
+  SECTION("a directory whose mtime changed misses") {
+    cache.insert(directory(2, 10), TMPFS_MAGIC, READ_START, entries);
+    struct stat changed = directory(2, 10);
+    changed.st_mtim.tv_sec = 11;
+    REQUIRE(cache.find(changed) == nullptr);
+  }
+
+  SECTION("a directory changed in the tick the read started is not kept") {
+    cache.insert(
+        directory(2, READ_START.tv_sec), TMPFS_MAGIC, READ_START, entries);
+    REQUIRE(cache.size() == 0);
+    cache.insert(
+        directory(2, READ_START.tv_sec + 1), TMPFS_MAGIC, READ_START, entries);
+    REQUIRE(cache.size() == 0);
+  }
+
+  SECTION("pseudo filesystems are not kept") {
+    cache.insert(directory(2, 10), PROC_SUPER_MAGIC, READ_START, entries);
+    REQUIRE(cache.size() == 0);
+  }
+}
+
+TEST_CASE("directory cache evicts least recently used", "directoryCache") {
+  auto listing = [] { return listingOf({"some", "entries"}); };
+  // Cached listings are sorted and shrunk to fit first.
+  auto shrunk = listing();
+  shrunk->sort();
+  shrunk->shrinkToFit();
+  size_t bytes = shrunk->bufferedBytes();
+  directoryCache cache(3 * bytes);
+
+  for (ino_t ino = 1; ino <= 3; ino++) {
+    cache.insert(directory(ino, 10), TMPFS_MAGIC, READ_START, listing());
+  }
+  REQUIRE(cache.size() == 3);
+  REQUIRE(cache.bytes() == 3 * bytes);
+
+  // 1 is used again, so 2 is the least recently used.
+  REQUIRE(cache.find(directory(1, 10)) != nullptr);
+  cache.insert(directory(4, 10), TMPFS_MAGIC, READ_START, listing());
+  REQUIRE(cache.size() == 3);
+  REQUIRE(cache.find(directory(2, 10)) == nullptr);
+
+  // Then 3.
+  cache.insert(directory(5, 10), TMPFS_MAGIC, READ_START, listing());
+  REQUIRE(cache.find(directory(3, 10)) == nullptr);
+  REQUIRE(cache.find(directory(1, 10)) != nullptr);
+  REQUIRE(cache.find(directory(4, 10)) != nullptr);
+  REQUIRE(cache.find(directory(5, 10)) != nullptr);
+  REQUIRE(cache.bytes() == 3 * bytes);
+}
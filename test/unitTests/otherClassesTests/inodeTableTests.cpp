@@ -0,0 +1,122 @@
+#include "../catch.hpp"
+
+#include <random>
+#include <set>
+#include <unordered_map>
+
+#include "../../../include/inodeTable.hpp"
+
+/**
+ * Tests for inodeTable, against an unordered_map of the same records.
+ */
+
+static logger testLog("", 0);
+
+static const ino_t FIRST_VIRTUAL_INODE = 1000;
+
+static logical_clock::time_point at(int64_t micros) {
+  return logical_clock::time_point(logical_clock::duration(micros));
+}
+
+TEST_CASE("inode table records", "inodeTable") {
+  const logical_clock::time_point epoch = at(1);
+  inodeTable table(testLog, FIRST_VIRTUAL_INODE, epoch);
+
+  SECTION("new inodes get fresh virtual inodes and the epoch") {
+    inodeRecord first = table.findOrInsert(42);
+    inodeRecord second = table.findOrInsert(7);
+    REQUIRE(first.virtualInode == FIRST_VIRTUAL_INODE);
+    REQUIRE(second.virtualInode == FIRST_VIRTUAL_INODE + 1);
+    REQUIRE(first.mtime == epoch);
+    REQUIRE(table.findOrInsert(42).virtualInode == first.virtualInode);
+    REQUIRE(table.size() == 2);
+  }
+
+  SECTION("a created inode gets a fresh virtual inode, even if seen") {
+    ino_t seen = table.findOrInsert(42).virtualInode;
+    table.created(42, at(5));
+    REQUIRE(table.findOrInsert(42).virtualInode == seen + 1);
+    REQUIRE(table.findOrInsert(42).mtime == at(5));
+    REQUIRE(table.size() == 1);
+  }
+
+  SECTION("an erased inode is forgotten") {
+    table.created(42, at(5));
+    table.erase(42);
+    table.erase(42);
+    REQUIRE(table.size() == 0);
+    inodeRecord reused = table.findOrInsert(42);
+    REQUIRE(reused.virtualInode == FIRST_VIRTUAL_INODE + 1);
+    REQUIRE(reused.mtime == epoch);
+  }
+}
+
+TEST_CASE("inode table matches a map under random operations", "inodeTable") {
+  const logical_clock::time_point epoch = at(1);
+  inodeTable table(testLog, FIRST_VIRTUAL_INODE, epoch);
+  unordered_map<ino_t, inodeRecord> model;
+  ino_t freshInode = FIRST_VIRTUAL_INODE;
+  mt19937_64 random(1234);
+
+  // Grow well past the initial slots, then shrink back, over a range of
+  // inodes small enough that probe runs collide and erasures shift them.
+  const ino_t inodeRange = 1 << 14;
+  const int rounds = 6;
+  const int opsPerPhase = 60000;
+  size_t largest = 0;
+  size_t smallest = SIZE_MAX;
+  for (int round = 0; round < rounds; round++) {
+    bool growing = round % 2 == 0;
+    for (int op = 0; op < opsPerPhase; op++) {
+      ino_t inode = random() % inodeRange;
+      int kind = random() % 10;
+      if (kind < (growing ? 2 : 9)) {
+        table.erase(inode);
+        model.erase(inode);
+      } else if (kind < 8 || !growing) {
+        const inodeRecord& record = table.findOrInsert(inode);
+        auto found = model.find(inode);
+        if (found == model.end()) {
+          found = model.emplace(inode, inodeRecord{freshInode++, epoch}).first;
+        }
+        REQUIRE(record.virtualInode == found->second.virtualInode);
+        REQUIRE(record.mtime == found->second.mtime);
+      } else {
+        logical_clock::time_point mtime = at(op);
+        table.created(inode, mtime);
+        model[inode] = inodeRecord{freshInode++, mtime};
+      }
+      REQUIRE(table.size() == model.size());
+      largest = max(largest, table.bytes());
+      smallest = min(smallest, table.bytes());
+    }
+
+    // Every record survived the rehashes and backward shifts, nothing else is
+    // left: looking up an absent inode would hand out a fresh one.
+    for (const auto& entry : model) {
+      const inodeRecord& record = table.findOrInsert(entry.first);
+      REQUIRE(record.virtualInode == entry.second.virtualInode);
+      REQUIRE(record.mtime == entry.second.mtime);
+    }
+    REQUIRE(table.size() == model.size());
+  }
+
+  // The table grew and shrank along the way.
+  REQUIRE(largest >= 8 * smallest);
+  REQUIRE(table.bytes() < largest);
+}
+
+TEST_CASE("inode table shrinks back once emptied", "inodeTable") {
+  inodeTable table(testLog, FIRST_VIRTUAL_INODE, at(1));
+  size_t initialBytes = table.bytes();
+  for (ino_t inode = 1; inode <= 100000; inode++) {
+    table.created(inode, at(inode));
+  }
+  REQUIRE(table.bytes() > initialBytes);
+
+  for (ino_t inode = 1; inode <= 100000; inode++) {
+    table.erase(inode);
+  }
+  REQUIRE(table.size() == 0);
+  REQUIRE(table.bytes() == initialBytes);
+}
@@ -0,0 +1,129 @@
+#include "../catch.hpp"
+
+#include <stdexcept>
+
+#include "../../../include/processTable.hpp"
+
+/**
+ * Tests for processTable: its parent, children and thread group links.
+ */
+
+static state stateOf(pid_t pid) {
+  return state(
+      pid, 0, logical_clock::from_time_t(0), logical_clock::duration(1));
+}
+
+TEST_CASE("processes and their children", "processTable") {
+  processTable table;
+  table.addProcess(1, -1, stateOf(1));
+  table.addProcess(2, 1, stateOf(2));
+  table.addProcess(3, 1, stateOf(3));
+
+  SECTION("added processes are found, with their state") {
+    REQUIRE(table.at(2).traceePid == 2);
+    REQUIRE(table.find(3) != nullptr);
+    REQUIRE(table.find(4) == nullptr);
+    REQUIRE_THROWS_AS(table.at(4), runtime_error);
+    REQUIRE_THROWS_AS(table.addProcess(2, 1, stateOf(2)), runtime_error);
+    REQUIRE(table.childCount(1) == 2);
+    REQUIRE(table.entryCount() == 3);
+    REQUIRE(table.threadCount() == 0);
+  }
+
+  SECTION("removing a process returns its parent") {
+    REQUIRE(table.remove(2) == 1);
+    REQUIRE(table.find(2) == nullptr);
+    REQUIRE(table.childCount(1) == 1);
+    REQUIRE(table.remove(3) == 1);
+    REQUIRE(table.remove(1) == -1);
+    REQUIRE(table.empty());
+    REQUIRE_THROWS_AS(table.remove(1), runtime_error);
+  }
+
+  SECTION("a state reference survives other processes coming and going") {
+    state& kept = table.at(3);
+    for (pid_t pid = 100; pid < 1100; pid++) {
+      table.addProcess(pid, 1, stateOf(pid));
+    }
+    for (pid_t pid = 100; pid < 1100; pid += 2) {
+      table.remove(pid);
+    }
+    REQUIRE(&kept == &table.at(3));
+    REQUIRE(kept.traceePid == 3);
+    REQUIRE(table.childCount(1) == 502);
+  }
+
+  SECTION("freed slots are reused") {
+    table.remove(2);
+    table.addProcess(4, 3, stateOf(4));
+    REQUIRE(table.entryCount() == 3);
+    REQUIRE(table.remove(4) == 3);
+  }
+}
+
+TEST_CASE("exited parents are kept for their children", "processTable") {
+  processTable table;
+  table.addProcess(1, -1, stateOf(1));
+  table.addProcess(2, 1, stateOf(2));
+  table.addProcess(3, 2, stateOf(3));
+
+  // 2 exits before its child: its entry stays, without a state, and is no
+  // longer a child of 1.
+  REQUIRE(table.remove(2) == 1);
+  REQUIRE(table.find(2) == nullptr);
+  REQUIRE_THROWS_AS(table.at(2), runtime_error);
+  REQUIRE(table.entryCount() == 3);
+  REQUIRE(table.childCount(2) == 1);
+  REQUIRE(table.childCount(1) == 0);
+
+  // Its last child still knows its parent, and takes the tombstone with it.
+  REQUIRE(table.remove(3) == 2);
+  REQUIRE(table.entryCount() == 1);
+
+  // The pid can be used again.
+  table.addProcess(2, 1, stateOf(2));
+  REQUIRE(table.at(2).traceePid == 2);
+}
+
+TEST_CASE("threads and their thread group", "processTable") {
+  processTable table;
+  table.addProcess(1, -1, stateOf(1));
+  table.addProcess(10, 1, stateOf(10));
+  table.addThread(11, 10, stateOf(11));
+  // Threads spawned by threads still belong to the leader.
+  table.addThread(12, 11, stateOf(12));
+
+  SECTION("threads are children and members of their leader") {
+    REQUIRE(table.threadGroupOf(10) == 10);
+    REQUIRE(table.threadGroupOf(11) == 10);
+    REQUIRE(table.threadGroupOf(12) == 10);
+    REQUIRE(table.threadGroupSize(12) == 3);
+    REQUIRE(table.childCount(10) == 2);
+    REQUIRE(table.childCount(11) == 0);
+    REQUIRE(table.threadCount() == 2);
+    pid_t any = table.anyThreadOf(10);
+    REQUIRE((any == 11 || any == 12));
+  }
+
+  SECTION("a thread's parent is its leader") {
+    REQUIRE(table.remove(12) == 10);
+    REQUIRE(table.threadGroupSize(10) == 2);
+    REQUIRE(table.anyThreadOf(10) == 11);
+    REQUIRE(table.threadCount() == 1);
+  }
+
+  SECTION("a leader exiting first leaves its group queryable") {
+    REQUIRE(table.remove(10) == 1);
+    REQUIRE(table.find(10) == nullptr);
+    REQUIRE(table.threadGroupOf(11) == 10);
+    REQUIRE(table.threadGroupSize(11) == 2);
+
+    REQUIRE(table.remove(11) == 10);
+    REQUIRE(table.anyThreadOf(10) == 12);
+    REQUIRE(table.remove(12) == 10);
+    REQUIRE(table.anyThreadOf(10) == -1);
+    REQUIRE(table.threadCount() == 0);
+    REQUIRE(table.entryCount() == 1);
+    REQUIRE(table.childCount(1) == 0);
+  }
+}
@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "liveStats.hpp"
+#include "systemCallList.hpp"
+
+using namespace std;
+
+/**
+ * dettrace-top: show what running dettrace jobs are doing, from the pages
+ * they keep with `dettrace --live-stats FILE`.
+ *
+ * For every job this prints its counters, event rate, the process it is
+ * waiting on and for how long, which is the first thing to look at for a job
+ * that seems stuck, and its most frequent system calls. With -n it refreshes
+ * every SECONDS, like top.
+ */
+
+static void usage(const char* argv0) {
+  fprintf(
+      stderr, "Usage: %s [-n SECONDS] [-s SYSCALLS] LIVE_STATS_FILE...\n",
+      argv0);
+  exit(1);
+}
+
+static uint64_t realtimeNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static string formatDuration(uint64_t nanos) {
+  char buffer[64];
+  uint64_t seconds = nanos / 1000000000;
+  if (seconds < 60) {
+    snprintf(buffer, sizeof(buffer), "%.1fs", nanos / 1e9);
+  } else {
+    snprintf(
+        buffer, sizeof(buffer), "%luh%02lum%02lus", seconds / 3600,
+        seconds / 60 % 60, seconds % 60);
+  }
+  return buffer;
+}
+
+static const char* jobState(const liveStatsPage& page) {
+  if (page.finished != 0) {
+    return "finished";
+  }
+  if (kill(page.tracerPid, 0) == -1 && errno == ESRCH) {
+    return "dead";
+  }
+  return "running";
+}
+
+/** Last sample of a job, to show rates. */
+struct sample {
+  uint64_t time = 0;
+  uint64_t events = 0;
+};
+
+static void show(
+    const string& path, const liveStatsPage& page, sample& previous,
+    int topSystemCalls) {
+  uint64_t now = realtimeNanos();
+  printf(
+      "%s: tracer %d %s for %s\n", path.c_str(), page.tracerPid,
+      jobState(page), formatDuration(page.lastUpdate - page.startTime).c_str());
+
+  printf(
+      "  events %lu  system calls %lu  replays %lu  rdtsc %lu  rdtscp %lu  "
+      "spawns %lu",
+      page.events, page.systemCallEvents, page.replays, page.rdtscEvents,
+      page.rdtscpEvents, page.processSpawnEvents);
+  if (previous.time != 0 && now > previous.time) {
+    printf(
+        "  (%.0f events/s)",
+        (page.events - previous.events) * 1e9 / (now - previous.time));
+  }
+  printf("\n");
+  previous.time = now;
+  previous.events = page.events;
+
+  printf("  runnable %lu  blocked %lu", page.runnable, page.blocked);
+  if (page.finished == 0) {
+    printf(
+        "  waiting on pid %d for %s", page.currentPid,
+        formatDuration(now > page.lastUpdate ? now - page.lastUpdate : 0)
+            .c_str());
+  }
+  printf("\n");
+
+  vector<pair<uint64_t, int>> counts;
+  for (int i = 0; i <= SYSTEM_CALL_COUNT; i++) {
+    if (page.systemCalls[i] != 0) {
+      counts.push_back({page.systemCalls[i], i});
+    }
+  }
+  sort(counts.rbegin(), counts.rend());
+  if (counts.size() > (size_t)topSystemCalls) {
+    counts.resize(topSystemCalls);
+  }
+  printf("  top system calls:");
+  for (auto& count : counts) {
+    const char* name = count.second < SYSTEM_CALL_COUNT
+                           ? systemCallMappings[count.second].c_str()
+                           : "unknown";
+    printf(" %s %lu", name, count.first);
+  }
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  double interval = 0;
+  int topSystemCalls = 8;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+    switch (opt) {
+    case 'n':
+      interval = atof(optarg);
+      break;
+    case 's':
+      topSystemCalls = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind == argc || interval < 0 || topSystemCalls < 0) {
+    usage(argv[0]);
+  }
+
+  vector<string> paths(argv + optind, argv + argc);
+  vector<sample> previous(paths.size());
+  liveStatsPage page;
+  for (;;) {
+    if (interval > 0) {
+      // Clear the screen, like top.
+      printf("\033[H\033[2J");
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+      try {
+        readLiveStats(paths[i], page);
+        show(paths[i], page, previous[i], topSystemCalls);
+      } catch (const exception& e) {
+        printf("%s: %s\n", paths[i].c_str(), e.what());
+      }
+    }
+    fflush(stdout);
+
+    if (interval == 0) {
+      return 0;
+    }
+    usleep((useconds_t)(interval * 1e6));
+  }
+}
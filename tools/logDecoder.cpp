@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "binaryLog.hpp"
+#include "systemCallList.hpp"
+
+using namespace std;
+
+/**
+ * dettrace-logdecode: render a log written with `dettrace --binary-log` in the
+ * same text format dettrace writes without it.
+ *
+ * With --context, every line is prefixed with the pid, logical time and
+ * system call (arguments and, in post hooks, return value) the message was
+ * logged for, which the text log does not carry.
+ */
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--context] BINARY_LOG\n", argv0);
+  exit(1);
+}
+
+static const char* importanceLabel(uint8_t level) {
+  switch (level) {
+  case 2:
+    return "[3]INTER ";
+  case 4:
+    return "[4]INFO  "; // Extra space for correct alignment.
+  default:
+    return "[5]EXTRA ";
+  }
+}
+
+static void printContext(const binaryLogRecord& r) {
+  printf("pid=%d t=%lu ", r.pid, r.logicalTime);
+  if (r.syscall < 0) {
+    return;
+  }
+  const char* name = r.syscall < SYSTEM_CALL_COUNT
+                         ? systemCallMappings[r.syscall].c_str()
+                         : "unknown";
+  printf(
+      "%s(0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx)", name, r.syscallArgs[0],
+      r.syscallArgs[1], r.syscallArgs[2], r.syscallArgs[3], r.syscallArgs[4],
+      r.syscallArgs[5]);
+  if ((r.flags & RECORD_HAS_RETVAL) != 0) {
+    printf(" = %ld", r.retval);
+  }
+  printf(" ");
+}
+
+int main(int argc, char** argv) {
+  bool withContext = false;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--context") == 0) {
+      withContext = true;
+    } else if (argv[i][0] == '-' || path != nullptr) {
+      usage(argv[0]);
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr) {
+    usage(argv[0]);
+  }
+
+  try {
+    binaryLogReader reader(path);
+    if (reader.written() > reader.capacity()) {
+      fprintf(
+          stderr, "%lu oldest records were overwritten.\n",
+          reader.written() - reader.capacity());
+    }
+
+    reader.forEach([&](const binaryLogRecord& r, const string& message) {
+      if (withContext) {
+        printContext(r);
+      }
+      printf("%s%lx ", importanceLabel(r.importance), r.entryId);
+      if ((r.flags & RECORD_PADDED) != 0) {
+        printf("  ");
+      }
+      fwrite(message.data(), 1, message.size(), stdout);
+    });
+  } catch (const exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}